@@ -0,0 +1,275 @@
+/*-----------------------------------------------------------------------------
+ * file:  inet_cksum.c
+ *
+ * Description:
+ *
+ * Internet checksum, see inet_cksum.h.
+ *
+ * Each variant returns the sum as a 64 bit one's complement accumulator:
+ * 2^16 == 1 (mod 2^16 - 1), so a 64 bit word is congruent to the sum of
+ * its four 16 bit lanes and the accumulator can be folded down to 16 bits
+ * at the end.  An accumulator of nonzero data never folds to 0, which
+ * keeps the 0 / 0xffff choice the same as the old loop.
+ *
+ * The vector loops widen 32 bit lanes into 64 bit lanes, which cannot
+ * overflow for any buffer below 32 GB, and hand the tail to the word loop.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "inet_cksum.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INET_CKSUM_X86
+#include <immintrin.h>
+#endif
+
+/* -- acc += w with the carry wrapped around -- */
+#define INET_CKSUM_ADD64(acc, w)                \
+    do {                                        \
+        uint64_t w_ = (w);                      \
+        (acc) += w_;                            \
+        (acc) += ((acc) < w_);                  \
+    } while(0)
+
+typedef uint64_t (*inet_cksum_fn)(const uint8_t* p, size_t len, uint64_t acc);
+
+struct inet_cksum_impl
+{
+    const char*   name;
+    inet_cksum_fn sum;
+    int         (*usable)(void);
+};
+
+/*---------------------------------------------------------------------
+ * Method: inet_cksum_word64(..)
+ * Scope: Local
+ *
+ * Portable variant, eight bytes per add.  Loads go through memcpy so p
+ * need not be aligned.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint64_t inet_cksum_word64(const uint8_t* p, size_t len, uint64_t acc)
+{
+    uint64_t w0, w1, w2, w3;
+    uint32_t w32;
+    uint16_t w16;
+    uint8_t  last[2];
+
+    while(len >= 32)
+    {
+        memcpy(&w0, p,      8);
+        memcpy(&w1, p + 8,  8);
+        memcpy(&w2, p + 16, 8);
+        memcpy(&w3, p + 24, 8);
+        INET_CKSUM_ADD64(acc, w0);
+        INET_CKSUM_ADD64(acc, w1);
+        INET_CKSUM_ADD64(acc, w2);
+        INET_CKSUM_ADD64(acc, w3);
+        p   += 32;
+        len -= 32;
+    }
+    while(len >= 8)
+    {
+        memcpy(&w0, p, 8);
+        INET_CKSUM_ADD64(acc, w0);
+        p   += 8;
+        len -= 8;
+    }
+    if(len >= 4)
+    {
+        memcpy(&w32, p, 4);
+        INET_CKSUM_ADD64(acc, w32);
+        p   += 4;
+        len -= 4;
+    }
+    if(len >= 2)
+    {
+        memcpy(&w16, p, 2);
+        INET_CKSUM_ADD64(acc, w16);
+        p   += 2;
+        len -= 2;
+    }
+    if(len)
+    {
+        /* -- odd byte is padded with a zero byte after it -- */
+        last[0] = p[0];
+        last[1] = 0;
+        memcpy(&w16, last, 2);
+        INET_CKSUM_ADD64(acc, w16);
+    }
+    return acc;
+} /* -- inet_cksum_word64 -- */
+
+static int inet_cksum_always(void)
+{ return 1; }
+
+#ifdef INET_CKSUM_X86
+
+/*---------------------------------------------------------------------
+ * Method: inet_cksum_sse2(..), inet_cksum_avx2(..)
+ * Scope: Local
+ *
+ * 32 and 64 bytes per iteration into two vector accumulators.  Lane order
+ * does not matter to the sum, so the in-lane unpacks are good enough.
+ *
+ *---------------------------------------------------------------------*/
+
+__attribute__((target("sse2")))
+static uint64_t inet_cksum_sse2(const uint8_t* p, size_t len, uint64_t acc)
+{
+    __m128i  zero = _mm_setzero_si128();
+    __m128i  a0   = zero;
+    __m128i  a1   = zero;
+    __m128i  v0, v1;
+    uint64_t lane[2];
+
+    while(len >= 32)
+    {
+        v0 = _mm_loadu_si128((const __m128i*)p);
+        v1 = _mm_loadu_si128((const __m128i*)(p + 16));
+        a0 = _mm_add_epi64(a0, _mm_unpacklo_epi32(v0, zero));
+        a1 = _mm_add_epi64(a1, _mm_unpackhi_epi32(v0, zero));
+        a0 = _mm_add_epi64(a0, _mm_unpacklo_epi32(v1, zero));
+        a1 = _mm_add_epi64(a1, _mm_unpackhi_epi32(v1, zero));
+        p   += 32;
+        len -= 32;
+    }
+    _mm_storeu_si128((__m128i*)lane, _mm_add_epi64(a0, a1));
+    INET_CKSUM_ADD64(acc, lane[0]);
+    INET_CKSUM_ADD64(acc, lane[1]);
+
+    return inet_cksum_word64(p, len, acc);
+} /* -- inet_cksum_sse2 -- */
+
+__attribute__((target("avx2")))
+static uint64_t inet_cksum_avx2(const uint8_t* p, size_t len, uint64_t acc)
+{
+    __m256i  zero = _mm256_setzero_si256();
+    __m256i  a0   = zero;
+    __m256i  a1   = zero;
+    __m256i  v0, v1;
+    uint64_t lane[4];
+
+    while(len >= 64)
+    {
+        v0 = _mm256_loadu_si256((const __m256i*)p);
+        v1 = _mm256_loadu_si256((const __m256i*)(p + 32));
+        a0 = _mm256_add_epi64(a0, _mm256_unpacklo_epi32(v0, zero));
+        a1 = _mm256_add_epi64(a1, _mm256_unpackhi_epi32(v0, zero));
+        a0 = _mm256_add_epi64(a0, _mm256_unpacklo_epi32(v1, zero));
+        a1 = _mm256_add_epi64(a1, _mm256_unpackhi_epi32(v1, zero));
+        p   += 64;
+        len -= 64;
+    }
+    _mm256_storeu_si256((__m256i*)lane, _mm256_add_epi64(a0, a1));
+    INET_CKSUM_ADD64(acc, lane[0]);
+    INET_CKSUM_ADD64(acc, lane[1]);
+    INET_CKSUM_ADD64(acc, lane[2]);
+    INET_CKSUM_ADD64(acc, lane[3]);
+
+    return inet_cksum_word64(p, len, acc);
+} /* -- inet_cksum_avx2 -- */
+
+static int inet_cksum_has_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+static int inet_cksum_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif /* INET_CKSUM_X86 */
+
+/* -- best first -- */
+static const struct inet_cksum_impl inet_cksum_impls[] =
+{
+#ifdef INET_CKSUM_X86
+    { "avx2",   inet_cksum_avx2,   inet_cksum_has_avx2 },
+    { "sse2",   inet_cksum_sse2,   inet_cksum_has_sse2 },
+#endif
+    { "word64", inet_cksum_word64, inet_cksum_always   },
+    { 0,        0,                 0                   }
+};
+
+static uint64_t inet_cksum_pick(const uint8_t* p, size_t len, uint64_t acc);
+
+/* -- variant in use, chosen on the first call -- */
+static inet_cksum_fn inet_cksum_sum = inet_cksum_pick;
+
+/*---------------------------------------------------------------------
+ * Method: inet_cksum_use(..)
+ * Scope: Global
+ *
+ * Switch variants by name, or to the best one the CPU supports when name
+ * is 0.  Threads racing through the first checksum all pick the same one.
+ *
+ *---------------------------------------------------------------------*/
+
+const char* inet_cksum_use(const char* name)
+{
+    const struct inet_cksum_impl* impl;
+
+    for(impl = inet_cksum_impls; impl->name; impl++)
+    {
+        if((name == 0 || strcmp(name, impl->name) == 0) && impl->usable())
+        {
+            __atomic_store_n(&inet_cksum_sum, impl->sum, __ATOMIC_RELAXED);
+            return impl->name;
+        }
+    }
+    return 0;
+} /* -- inet_cksum_use -- */
+
+static uint64_t inet_cksum_pick(const uint8_t* p, size_t len, uint64_t acc)
+{
+    inet_cksum_use(0);
+    return __atomic_load_n(&inet_cksum_sum, __ATOMIC_RELAXED)(p, len, acc);
+} /* -- inet_cksum_pick -- */
+
+/*---------------------------------------------------------------------
+ * Method: inet_cksum_fold(..)
+ * Scope: Local
+ *
+ * 64 bit accumulator down to 16 bits, carries wrapped around.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint16_t inet_cksum_fold(uint64_t acc)
+{
+    acc = (acc & 0xffffffff) + (acc >> 32);
+    acc = (acc & 0xffffffff) + (acc >> 32);
+    acc = (acc & 0xffff) + (acc >> 16);
+    acc = (acc & 0xffff) + (acc >> 16);
+    return (uint16_t)acc;
+} /* -- inet_cksum_fold -- */
+
+/*---------------------------------------------------------------------
+ * Method: inet_cksum_add(..), inet_cksum_finish(..), inet_cksum(..)
+ * Scope: Global
+ *
+ * Sums are kept in host order, which is what makes ~sum come out already
+ * in network order.
+ *
+ *---------------------------------------------------------------------*/
+
+uint16_t inet_cksum_add(uint16_t sum, const void* data, size_t len)
+{
+    inet_cksum_fn fn = __atomic_load_n(&inet_cksum_sum, __ATOMIC_RELAXED);
+    return inet_cksum_fold(fn((const uint8_t*)data, len, sum));
+} /* -- inet_cksum_add -- */
+
+uint16_t inet_cksum_finish(uint16_t sum)
+{
+    sum = (uint16_t)~sum;
+    return sum ? sum : 0xffff;
+} /* -- inet_cksum_finish -- */
+
+uint16_t inet_cksum(const void* data, size_t len)
+{ return inet_cksum_finish(inet_cksum_add(0, data, len)); }
@@ -0,0 +1,35 @@
+/*-----------------------------------------------------------------------------
+ * file:  inet_cksum.h
+ *
+ * Description:
+ *
+ * Internet checksum (RFC 1071) shared by the router and cTCP.
+ *
+ * The one's complement sum does not depend on byte order, so it is taken
+ * over whole host words and only the 16 bit result is complemented; no
+ * byte swapping is needed on either side.  Carries are collected in a 64
+ * bit accumulator and folded down once at the end.  On x86 an SSE2 or AVX2
+ * loop is picked at run time from what the CPU supports.  Every variant
+ * gives exactly the same result as the old 16 bit at a time loop.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef INET_CKSUM_H
+#define INET_CKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* -- checksum of len bytes as stored in a header, 0 comes out as 0xffff -- */
+uint16_t    inet_cksum(const void* data, size_t len);
+
+/* -- piecewise: add each piece to a running sum (start at 0), then finish.
+ *    Every piece but the last must be an even number of bytes -- */
+uint16_t    inet_cksum_add(uint16_t sum, const void* data, size_t len);
+uint16_t    inet_cksum_finish(uint16_t sum);
+
+/* -- force a variant ("word64", "sse2", "avx2"), 0 for the best one.
+ *    Returns the variant now in use, 0 if name is unknown or unsupported -- */
+const char* inet_cksum_use(const char* name);
+
+#endif  /* --  INET_CKSUM_H -- */
@@ -13,13 +13,21 @@
 #include "sr_protocol.h"
 #include "sr_utils.h"
 
+static void sr_arpcache_schedule(struct sr_arpcache *cache, struct sr_timer *t, uint64_t expires);
+static int sr_arpcache_expire(struct sr_arpcache *cache, struct sr_arptimer *et,
+                              uint64_t now, struct sr_arpentry *poll);
+static void sr_arpreq_unlink(struct sr_arpcache *cache, struct sr_arpreq *entry);
+static void sr_arpreq_requeue(struct sr_arpcache *cache, struct sr_arpreq *req);
+static void sr_arpneg_add(struct sr_arpcache *cache, uint32_t ip);
+static void sr_arpneg_remove(struct sr_arpcache *cache, uint32_t ip);
+
 void sr_arp_make_packet(struct sr_instance* sr,struct sr_if* interface,
 				  const unsigned char* tha,uint32_t target_ip, int mode){
           /* mode 0 is reply, 1 is request */
-  printf("preparing an arp ");
-  /*a size 8 int array of size len (header size ether+arp) allocated*/
+  /*frame built on the stack, with headroom for sr_send_packet*/
   unsigned int len = sizeof(sr_ethernet_hdr_t)+sizeof(sr_arp_hdr_t);
-  uint8_t *packet = (uint8_t*)malloc(len);
+  uint8_t frame[SR_PKT_HEADROOM+sizeof(sr_ethernet_hdr_t)+sizeof(sr_arp_hdr_t)];
+  uint8_t *packet = frame+SR_PKT_HEADROOM;
 /* setting up the ethernet header*/
   sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t*)(packet);
   memcpy(eth_hdr->ether_shost,interface->addr,6);
@@ -35,123 +43,583 @@ void sr_arp_make_packet(struct sr_instance* sr,struct sr_if* interface,
   arp_hdr->ar_tip = target_ip;
   memcpy(arp_hdr->ar_sha,interface->addr,6);
 
-  if (mode){/*request*/
+  if (mode == 1){/*request*/
     arp_hdr->ar_op = htons(arp_op_request);
     /*set target Mac to unknown*/
 	  memset(arp_hdr->ar_tha,0x00,6);
 		memset(eth_hdr->ether_dhost,0xff,6);
-		printf("request packet\n");
+		LogDebug("preparing an arp request packet\n");
+  }else if (mode == 2){/*unicast request, for refreshing*/
+    arp_hdr->ar_op = htons(arp_op_request);
+    memcpy(eth_hdr->ether_dhost,tha,6);
+    memcpy(arp_hdr->ar_tha,tha,6);
+    LogDebug("preparing an arp refresh packet\n");
   }else{/*reply*/
     arp_hdr->ar_op = htons(arp_op_reply);
     /*set target Mac to tha*/
     memcpy(eth_hdr->ether_dhost,tha,6);
     memcpy(arp_hdr->ar_tha,tha,6);
-		printf("reply packet\n");
+		LogDebug("preparing an arp reply packet\n");
   }
-  sr_send_packet(sr,packet,len,interface->name);
+  sr_send_packet_if(sr,packet,len,interface->index);
 }
 void sr_arp_request(struct sr_instance* sr,uint32_t target_ip){
   struct sr_rt *nexthop = longestprefixmatch(sr,target_ip);
+  struct sr_if* interface = nexthop ? sr_if_by_index(sr,nexthop->if_index) : NULL;
   if(!nexthop){
-    printf("Destination net unreachable\n");
+    LogInfoRL("Destination net unreachable\n");
 		/*sends icmp net unreachable*/
+  }else if(!interface){ /*route names an interface we don't have*/
+    LogInfoRL("no interface to ask for %u.%u.%u.%u on\n",SR_LOG_IP(target_ip));
   }else{
   /*sends packet broadcast on interface*/
-    struct sr_if* interface = sr_get_interface(sr,nexthop->interface);
     sr_arp_make_packet(sr, interface, NULL, target_ip, 1);
   }
 }
+void sr_arp_refresh(struct sr_instance* sr,uint32_t target_ip,
+                    const unsigned char* mac){
+  struct sr_rt *nexthop = longestprefixmatch(sr,target_ip);
+  struct sr_if* interface = nexthop ? sr_if_by_index(sr,nexthop->if_index) : NULL;
+  if(interface)
+    sr_arp_make_packet(sr, interface, mac, target_ip, 2);
+}
+
+/*
+  Sends the frames queued on req now that its next hop is at mac, oldest
+  first. Forwarded frames had their TTL and checksum done before they were
+  queued, so only the Ethernet addresses are filled in; running them
+  through sr_handlepacket_if again would take the TTL down twice. Queued
+  ARP frames (proxied requests and replies) do go back through it.
+*/
+void sr_arpreq_flush(struct sr_instance *sr, struct sr_arpreq *req, const unsigned char *mac){
+  struct sr_packet *packet;
+  for(packet = req->packets; packet; packet = packet->next){
+    struct sr_if *interface = sr_if_by_index(sr,packet->if_index);
+    if(ethertype(packet->buf) != ethertype_ip || !interface){
+      sr_handlepacket_if(sr,packet->buf,packet->len,packet->if_index);
+      continue;
+    }
+    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t*)(packet->buf);
+    memcpy(eth_hdr->ether_dhost,mac,ETHER_ADDR_LEN);
+    memcpy(eth_hdr->ether_shost,interface->addr,ETHER_ADDR_LEN);
+    sr_send_packet_if(sr,packet->buf,packet->len,packet->if_index);
+  }
+}
 
 /*
-  This function gets called every second. For each request sent out, we keep
-  checking whether we should resend an request or destroy the arp request.
-  See the comments in the header file for an idea of what it should look like.
+  This function gets called by the ARP thread whenever timers on the cache's
+  wheel are due. A request's timer fires when it is time to send it again:
+  we resend and schedule the next try, or destroy the request once it has
+  resolved or is out of tries. An entry's timer fires when it may have aged
+  out, or be due a poll to refresh it first. See the comments in the
+  header file for the per-request logic.
+
+  The wheel is only run under the cache lock. Requests that are resolved or
+  out of tries are unlinked and everything that sends packets (ARP
+  requests, ICMP, re-injected packets) runs after the lock is dropped, so
+  the data path never waits behind the sweep.
 */
 void sr_arpcache_sweepreqs(struct sr_instance *sr) {
-    /* Fill this in */
-    struct sr_arpcache *cache = &sr->cache;
-    struct sr_arpreq *req = cache->requests;
-    while (req){ /*we have a request*/
-			time_t t = time(NULL);
-			if(difftime(t,req->sent)>= 1){ /*send request if one hasn't been sent in last second*/
-			    if(req->times_sent >= 5){ /*send maximum 5 times*/
-		      printf("ARP 5 tries limit reached, unreachable\n");
-		      struct sr_packet * packets = req->packets;
-					while(packets){
-						sr_ip_hdr_t* iphdr = (sr_ip_hdr_t*)(packets->buf + sizeof(sr_ethernet_hdr_t));
-		        /*sends icmp host unreachable*/
-						sr_icmp_make_packet(sr,iphdr,3,1);
-						packets = packets->next;
-					}
-					sr_arpreq_destroy(cache,req);
-					printf("unreachable request destoried\n");
-		    }
-				else{
-					struct sr_arpentry* entry = sr_arpcache_lookup(&sr->cache,req->ip);
-					printf("look up cache\n");
-					print_addr_ip_int(req->ip);
-					if(entry){
-					    printf("found new cached ip in queue\n");
-					    struct sr_packet *packet = req->packets;
-					    struct sr_if* interface= 0;
-					    while(packet){
-					      interface = sr_get_interface(sr,packet->iface);
-								sr_handlepacket(sr,packet->buf,packet->len,interface->name);
-					      packet = packet->next;
-					    }
-					    sr_arpreq_destroy(cache,req);
-					    printf("request destoried\n");
-
-					}else{
-						printf("mac address not found, requesting via arp\n");
-			      sr_arp_request(sr,req->ip);
-			      req->times_sent++;
-						req->sent = t;
-					}
-		    }
-			}
-			 req = req->next;
-		}
+  struct sr_arpcache *cache = &sr->cache;
+  struct sr_arpreq *req, *next;
+  struct sr_arpreq *resolved = NULL, *failed = NULL;
+  struct sr_timer *t, *tnext;
+  uint32_t *resend = NULL, *grown;
+  struct sr_arpentry *polls = NULL, *grown_polls;
+  unsigned int nresend = 0, cap = 0, npolls = 0, pcap = 0, i;
+  unsigned char mac[ETHER_ADDR_LEN];
+  uint64_t now = sr_timer_now();
+
+  pthread_mutex_lock(&(cache->lock));
+  for (t = sr_wheel_expire(&(cache->wheel),now); t; t = tnext){
+    tnext = t->next;
+    if(t->kind == arp_timer_negative){ /*down long enough, try it again*/
+      sr_arpneg_remove(cache,((struct sr_arpneg*)t)->ip);
+      continue;
+    }
+    if(t->kind == arp_timer_entry){
+      if(npolls == pcap){
+        pcap = pcap ? pcap*2 : 16;
+        if(!(grown_polls = (struct sr_arpentry*)realloc(polls,
+          pcap*sizeof(struct sr_arpentry)))){
+          pcap = npolls;
+          sr_arpcache_schedule(cache,t,now+cache->retry_ms);
+          continue; /*try again next time*/
+        }
+        polls = grown_polls;
+      }
+      npolls += sr_arpcache_expire(cache,(struct sr_arptimer*)t,now,
+        &polls[npolls]);
+      continue;
+    }
+    req = (struct sr_arpreq*)t;
+    if(req->times_sent < SR_ARPREQ_TRIES && !sr_arpcache_lookup_mac(cache,req->ip,mac)){
+      /*still unresolved, remember to ask again*/
+      sr_arpcache_schedule(cache,&(req->timer),now+cache->retry_ms);
+      if(nresend == cap){
+        cap = cap ? cap*2 : 16;
+        if(!(grown = (uint32_t*)realloc(resend,cap*sizeof(uint32_t))))
+          continue; /*try again next time*/
+        resend = grown;
+      }
+      resend[nresend++] = req->ip;
+      req->times_sent++;
+      req->sent = time(NULL);
+      continue;
+    }
+    /*resolved or out of tries, take it off the queue*/
+    sr_arpreq_unlink(cache,req);
+    if(req->times_sent >= SR_ARPREQ_TRIES){ /*send maximum 5 times*/
+      cache->expired += req->queued - req->dropped;
+      req->next = failed;
+      failed = req;
+    }else{
+      cache->flushed += req->queued - req->dropped;
+      req->next = resolved;
+      resolved = req;
+    }
+  }
+  /*answer for the failed ones until they expire, only now the expired
+    list is walked: their negative timers may have been on it*/
+  for(req = failed; req; req = req->next)
+    sr_arpneg_add(cache,req->ip);
+  pthread_mutex_unlock(&(cache->lock));
+
+  for(i = 0; i < nresend; i++){
+    LogDebug("mac address not found, requesting via arp %u.%u.%u.%u\n",
+      SR_LOG_IP(resend[i]));
+    sr_arp_request(sr,resend[i]);
+  }
+  free(resend);
+
+  for(i = 0; i < npolls; i++){
+    LogDebug("refreshing %u.%u.%u.%u before it expires\n",
+      SR_LOG_IP(polls[i].ip));
+    sr_arp_refresh(sr,polls[i].ip,polls[i].mac);
+  }
+  free(polls);
+
+  /*learnt without a reply to us (sr_arpcache_put), the reply path
+    flushes its own request as soon as it arrives*/
+  for(req = resolved; req; req = next){
+    next = req->next;
+    LogDebug("found new cached ip in queue\n");
+    if(!sr_arpcache_lookup_mac(cache,req->ip,mac)){
+      sr_arpreq_requeue(cache,req); /*aged out since, wait on it again*/
+      continue;
+    }
+    sr_arpreq_flush(sr,req,mac);
+    sr_arpreq_destroy(cache,req);
+    LogDebug("request destoried\n");
+  }
+
+  for(req = failed; req; req = next){
+    next = req->next;
+    LogInfoRL("ARP %d tries limit reached, unreachable %u.%u.%u.%u\n",
+      SR_ARPREQ_TRIES,SR_LOG_IP(req->ip));
+    struct sr_packet * packets = req->packets;
+    while(packets){
+      sr_ip_hdr_t* iphdr = (sr_ip_hdr_t*)(packets->buf + sizeof(sr_ethernet_hdr_t));
+      /*sends icmp host unreachable, not for queued ARP or ICMP errors*/
+      if(icmp_error_allowed(packets->buf,packets->len))
+        sr_icmp_make_packet(sr,iphdr,3,1);
+      SR_IF_STAT_ADD(sr,packets->if_index,drops,1);
+      packets = packets->next;
+    }
+    sr_arpreq_destroy(cache,req);
+    LogDebug("unreachable request destoried\n");
+  }
 }
 
 /* You should not need to touch the rest of this code. */
 
-/* Checks if an IP->MAC mapping is in the cache. IP is in network byte order.
-   You must free the returned structure if it is not NULL. */
-struct sr_arpentry *sr_arpcache_lookup(struct sr_arpcache *cache, uint32_t ip) {
+/* Home slot of an IP in the open addressing table (multiplicative hash). */
+static unsigned int sr_arpcache_hash(struct sr_arpcache *cache, uint32_t ip) {
+    return (ip * 2654435761u) >> cache->shift;
+}
+
+/* The entry table is a seqlock: writers hold the lock and bump seq to odd
+   while they modify entries, readers never lock and retry if seq was odd or
+   changed underneath them. */
+static void sr_arpcache_write_begin(struct sr_arpcache *cache) {
+    __atomic_store_n(&(cache->seq), cache->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void sr_arpcache_write_end(struct sr_arpcache *cache) {
+    __atomic_store_n(&(cache->seq), cache->seq + 1, __ATOMIC_RELEASE);
+}
+
+static unsigned int sr_arpcache_read_begin(struct sr_arpcache *cache) {
+    unsigned int seq;
+
+    while ((seq = __atomic_load_n(&(cache->seq), __ATOMIC_ACQUIRE)) & 1)
+        sched_yield();
+    return seq;
+}
+
+static int sr_arpcache_read_retry(struct sr_arpcache *cache, unsigned int seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&(cache->seq), __ATOMIC_RELAXED) != seq;
+}
+
+/* Slot holding the valid entry for ip, or -1. Caller holds the lock. */
+static int sr_arpcache_find(struct sr_arpcache *cache, uint32_t ip) {
+    unsigned int i = sr_arpcache_hash(cache, ip);
+
+    while (cache->entries[i].valid) {
+        if (cache->entries[i].ip == ip)
+            return i;
+        i = (i + 1) & cache->mask;
+    }
+    return -1;
+}
+
+/* Removes the entry in slot i by shifting later members of its probe run
+   back, so no tombstones are needed. Caller holds the lock. */
+static void sr_arpcache_remove(struct sr_arpcache *cache, unsigned int i) {
+    unsigned int j = i, home;
+
+    __atomic_add_fetch(&(cache->gen), 1, __ATOMIC_RELEASE);
+    while (1) {
+        cache->entries[i].valid = 0;
+        do {
+            j = (j + 1) & cache->mask;
+            if (!cache->entries[j].valid) {
+                cache->count--;
+                return;
+            }
+            home = sr_arpcache_hash(cache, cache->entries[j].ip);
+            /* entry j may move to i only if its home is not in (i, j] */
+        } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+        cache->entries[i] = cache->entries[j];
+        i = j;
+    }
+}
+
+/* Puts t on the wheel for expires and wakes the ARP thread if it sleeps
+   past then. Caller holds the lock. */
+static void sr_arpcache_schedule(struct sr_arpcache *cache, struct sr_timer *t, uint64_t expires) {
+    sr_wheel_add(&(cache->wheel), t, expires);
+    if (cache->wake && expires < cache->wake)
+        pthread_cond_signal(&(cache->wake_cond));
+}
+
+/* Runs an entry's timer. An entry used since it was added is polled with
+   a unicast request SR_ARPCACHE_REFRESH seconds before it expires, and
+   every retry_ms after that until it answers or SR_ARPREQ_TRIES polls
+   went unanswered. It stays in service while polls are outstanding, even
+   past SR_ARPCACHE_TO, so a neighbour that answers never drops out of the
+   cache. Otherwise it is removed once older than SR_ARPCACHE_TO. The
+   timer is thrown away if the entry is gone or has a newer one.
+
+   Returns 1 with the entry copied to poll if a poll is due, the caller
+   sends it after dropping the lock, which it holds. */
+static int sr_arpcache_expire(struct sr_arpcache *cache, struct sr_arptimer *et,
+                              uint64_t now, struct sr_arpentry *poll) {
+    int i = sr_arpcache_find(cache, et->ip);
+    struct sr_arpentry *e;
+    double age;
+
+    if (i < 0 || cache->entries[i].timer != et->id) {
+        sr_pool_put(&(cache->timer_pool), et);
+        return 0;
+    }
+    e = &(cache->entries[i]);
+    age = difftime(time(NULL), e->added);
+
+    /* refreshed since, not due a poll yet */
+    if (!e->refresh && age < SR_ARPCACHE_TO - SR_ARPCACHE_REFRESH) {
+        sr_arpcache_schedule(cache, &(et->timer), now +
+            (uint64_t)((SR_ARPCACHE_TO - SR_ARPCACHE_REFRESH - age) * 1000));
+        return 0;
+    }
+    if ((e->refresh || __atomic_load_n(&(e->used), __ATOMIC_RELAXED)) &&
+        e->refresh < SR_ARPREQ_TRIES) {
+        __atomic_store_n(&(e->used), 0, __ATOMIC_RELAXED);
+        e->refresh++;
+        cache->refreshes++;
+        memcpy(poll, e, sizeof(struct sr_arpentry));
+        sr_arpcache_schedule(cache, &(et->timer), now + cache->retry_ms);
+        return 1;
+    }
+    if (age <= SR_ARPCACHE_TO) {
+        sr_arpcache_schedule(cache, &(et->timer),
+                             now + (uint64_t)((SR_ARPCACHE_TO - age + 1) * 1000));
+        return 0;
+    }
+    if (e->refresh)
+        cache->refresh_failed++;
+    sr_arpcache_write_begin(cache);
+    sr_arpcache_remove(cache, i);
+    sr_arpcache_write_end(cache);
+    sr_pool_put(&(cache->timer_pool), et);
+    return 0;
+}
+
+/* Kicks out a random entry to make room. Caller holds the lock. */
+static void sr_arpcache_evict(struct sr_arpcache *cache) {
+    unsigned int i = rand() & cache->mask;
+
+    while (!cache->entries[i].valid)
+        i = (i + 1) & cache->mask;
+    sr_arpcache_remove(cache, i);
+    cache->evictions++;
+}
+
+/* Inserts or refreshes an IP->MAC mapping. A new entry gets a timer to
+   expire it, a refreshed one keeps its own. Caller holds the lock and has
+   opened a write section. */
+static void sr_arpcache_put_locked(struct sr_arpcache *cache, unsigned char *mac, uint32_t ip) {
+    int i = sr_arpcache_find(cache, ip);
+    struct sr_arptimer *et;
+
+    /* heard from, so not down any more */
+    if (cache->neg_count)
+        sr_arpneg_remove(cache, ip);
+
+    if (i < 0) {
+        if (cache->count >= cache->capacity)
+            sr_arpcache_evict(cache);
+        i = sr_arpcache_hash(cache, ip);
+        while (cache->entries[i].valid)
+            i = (i + 1) & cache->mask;
+        cache->entries[i].ip = ip;
+        cache->entries[i].valid = 1;
+        cache->entries[i].timer = 0;    /* never expires if out of memory */
+        cache->entries[i].used = 0;
+        cache->entries[i].refresh = 0;
+        cache->count++;
+
+        if ((et = (struct sr_arptimer *) sr_pool_get(&(cache->timer_pool)))) {
+            if (++cache->timer_id == 0)
+                cache->timer_id = 1;
+            et->timer.kind = arp_timer_entry;
+            et->timer.pprev = NULL;
+            et->ip = ip;
+            et->id = cache->timer_id;
+            cache->entries[i].timer = et->id;
+            sr_arpcache_schedule(cache, &(et->timer), sr_timer_now() +
+                (uint64_t)((SR_ARPCACHE_TO - SR_ARPCACHE_REFRESH) * 1000));
+        }
+    }
+    else {
+        if (memcmp(cache->entries[i].mac, mac, ETHER_ADDR_LEN) != 0)
+            __atomic_add_fetch(&(cache->gen), 1, __ATOMIC_RELEASE);
+        if (cache->entries[i].refresh) {
+            /* a poll was answered */
+            cache->entries[i].refresh = 0;
+            cache->refreshed++;
+        }
+    }
+    memcpy(cache->entries[i].mac, mac, ETHER_ADDR_LEN);
+    cache->entries[i].added = time(NULL);
+}
+
+/* Inserts or refreshes an IP->MAC mapping without touching the request
+   queue. If the cache is at capacity a random entry is evicted. */
+void sr_arpcache_put(struct sr_arpcache *cache, unsigned char *mac, uint32_t ip) {
     pthread_mutex_lock(&(cache->lock));
+    sr_arpcache_write_begin(cache);
+    sr_arpcache_put_locked(cache, mac, ip);
+    sr_arpcache_write_end(cache);
+    pthread_mutex_unlock(&(cache->lock));
+}
+
+/* Lock-free read of the entry for ip into *out. Returns its slot, or -1 if
+   not found. The probe is bounded so a reader racing a writer cannot spin
+   forever; the seqlock retry discards whatever it saw in that case. */
+static int sr_arpcache_read(struct sr_arpcache *cache, uint32_t ip, struct sr_arpentry *out) {
+    unsigned int seq, i, n;
+    int found;
+
+    do {
+        seq = sr_arpcache_read_begin(cache);
+        found = -1;
+        i = sr_arpcache_hash(cache, ip);
+        for (n = 0; n <= cache->mask && cache->entries[i].valid; n++) {
+            if (cache->entries[i].ip == ip) {
+                memcpy(out, &(cache->entries[i]), sizeof(struct sr_arpentry));
+                found = i;
+                break;
+            }
+            i = (i + 1) & cache->mask;
+        }
+    } while (sr_arpcache_read_retry(cache, seq));
 
-    struct sr_arpentry *entry = NULL, *copy = NULL;
+    return found;
+}
 
-    int i;
-		printf("inside lookup\n");
-    for (i = 0; i < SR_ARPCACHE_SZ; i++) {
-			if (cache->entries[i].ip){
-      	print_addr_ip_int(cache->entries[i].ip);
-			}
-      if ((cache->entries[i].valid) && (cache->entries[i].ip == ip)) {
-					printf("yeah\n");
+/* Checks if an IP->MAC mapping is in the cache. IP is in network byte order.
+   On a hit the MAC is copied to mac (ETHER_ADDR_LEN bytes) and 1 is
+   returned, otherwise 0. Nothing is allocated. */
+int sr_arpcache_lookup_mac(struct sr_arpcache *cache, uint32_t ip, unsigned char *mac) {
+    struct sr_arpentry entry;
+
+    if (sr_arpcache_read(cache, ip, &entry) < 0)
+        return 0;
+    memcpy(mac, entry.mac, ETHER_ADDR_LEN);
+    return 1;
+}
 
-            entry = &(cache->entries[i]);
+/* The forwarding path's lookup, see sr_arpcache.h. */
+int sr_arpcache_resolve(struct sr_arpcache *cache, uint32_t ip, unsigned char *mac) {
+    struct sr_arpentry entry;
+    int i = sr_arpcache_read(cache, ip, &entry);
 
-			}
+    if (i < 0) {
+        __atomic_fetch_add(&(cache->misses), 1, __ATOMIC_RELAXED);
+        return -1;
     }
+    __atomic_fetch_add(&(cache->hits), 1, __ATOMIC_RELAXED);
+    memcpy(mac, entry.mac, ETHER_ADDR_LEN);
+    sr_arpcache_touch(cache, i);
+    return i;
+}
 
-    /* Must return a copy b/c another thread could jump in and modify
-       table after we return. */
-    if (entry) {
+/* Marks slot used, a store only the first time since the last poll so
+   steady traffic does not keep writing the entry's cache line. */
+void sr_arpcache_touch(struct sr_arpcache *cache, unsigned int slot) {
+    unsigned char *used = &(cache->entries[slot].used);
+
+    if (!__atomic_load_n(used, __ATOMIC_RELAXED))
+        __atomic_store_n(used, 1, __ATOMIC_RELAXED);
+}
+
+/* Checks if an IP->MAC mapping is in the cache. IP is in network byte order.
+   You must free the returned structure if it is not NULL. Prefer
+   sr_arpcache_lookup_mac, which does not allocate. */
+struct sr_arpentry *sr_arpcache_lookup(struct sr_arpcache *cache, uint32_t ip) {
+    struct sr_arpentry entry, *copy = NULL;
+
+    if (sr_arpcache_read(cache, ip, &entry) >= 0) {
         copy = (struct sr_arpentry *) malloc(sizeof(struct sr_arpentry));
-        memcpy(copy, entry, sizeof(struct sr_arpentry));
+        memcpy(copy, &entry, sizeof(struct sr_arpentry));
     }
 
+    return copy;
+}
+
+/* Link to ip's negative entry in its bucket, the bucket's last link if it
+   has none. Caller holds the lock. */
+static struct sr_arpneg **sr_arpneg_find(struct sr_arpcache *cache, uint32_t ip) {
+    struct sr_arpneg **pp = &(cache->neg[sr_arpcache_hash(cache, ip) & cache->neg_mask]);
+
+    while (*pp && (*pp)->ip != ip)
+        pp = &((*pp)->next);
+    return pp;
+}
+
+/* Marks ip down for neg_ms, again from now if it already was. Nothing if
+   capacity next hops are down or out of memory: frames for ip then queue
+   as before. Caller holds the lock. */
+static void sr_arpneg_add(struct sr_arpcache *cache, uint32_t ip) {
+    struct sr_arpneg **pp = sr_arpneg_find(cache, ip);
+    struct sr_arpneg *n = *pp;
+
+    if (n)
+        sr_wheel_del(&(cache->wheel), &(n->timer));
+    else {
+        if (cache->neg_count >= cache->capacity ||
+            !(n = (struct sr_arpneg *) sr_pool_get(&(cache->neg_pool))))
+            return;
+        memset(n, 0, sizeof(struct sr_arpneg));
+        n->ip = ip;
+        n->timer.kind = arp_timer_negative;
+        *pp = n;
+        __atomic_store_n(&(cache->neg_count), cache->neg_count + 1, __ATOMIC_RELEASE);
+    }
+    cache->neg_added++;
+    sr_arpcache_schedule(cache, &(n->timer), sr_timer_now() + cache->neg_ms);
+}
+
+/* Takes ip's negative entry, if any, off its bucket and the wheel. Caller
+   holds the lock. */
+static void sr_arpneg_remove(struct sr_arpcache *cache, uint32_t ip) {
+    struct sr_arpneg **pp = sr_arpneg_find(cache, ip);
+    struct sr_arpneg *n = *pp;
+
+    if (!n)
+        return;
+    *pp = n->next;
+    sr_wheel_del(&(cache->wheel), &(n->timer));
+    sr_pool_put(&(cache->neg_pool), n);
+    __atomic_store_n(&(cache->neg_count), cache->neg_count - 1, __ATOMIC_RELAXED);
+}
+
+/* Whether ip is down, see sr_arpcache.h. Host unreachables are counted
+   per whole second, enough to keep a flow's sender from flooding back. */
+enum sr_arpneg_verdict sr_arpcache_dead(struct sr_arpcache *cache, uint32_t ip) {
+    enum sr_arpneg_verdict verdict = arpneg_none;
+    struct sr_arpneg *n;
+    time_t now;
+
+    if (!__atomic_load_n(&(cache->neg_count), __ATOMIC_ACQUIRE))
+        return arpneg_none;
+
+    pthread_mutex_lock(&(cache->lock));
+    if ((n = *sr_arpneg_find(cache, ip))) {
+        cache->neg_hits++;
+        now = time(NULL);
+        if (n->icmp_sec != now) {
+            n->icmp_sec = now;
+            n->icmp_sent = 0;
+        }
+        verdict = n->icmp_sent < SR_ARPNEG_ICMP ? arpneg_icmp : arpneg_quiet;
+        if (verdict == arpneg_icmp)
+            n->icmp_sent++;
+    }
     pthread_mutex_unlock(&(cache->lock));
 
-    return copy;
+    return verdict;
+}
+
+/* Sets how long next hops stay down, see sr_arpcache.h. */
+void sr_arpcache_set_negative(struct sr_arpcache *cache, unsigned int neg_ms) {
+    pthread_mutex_lock(&(cache->lock));
+    cache->neg_ms = neg_ms ? neg_ms : SR_ARPNEG_TO;
+    pthread_mutex_unlock(&(cache->lock));
+}
+
+/* Drops the oldest packet queued on req. Caller holds the cache lock. */
+static void sr_arpreq_drop_oldest(struct sr_arpcache *cache, struct sr_arpreq *req) {
+    struct sr_packet *pkt = req->packets;
+
+    req->packets = pkt->next;
+    if (!req->packets)
+        req->last = NULL;
+    req->qbytes -= pkt->len;
+    cache->qbytes -= pkt->len;
+    req->dropped++;
+    cache->dropped++;
+    sr_arpcache_frame_put(cache, pkt->buf, pkt->len);
+    sr_pool_put(&(cache->pkt_pool), pkt);
+}
+
+/* Sets the time between ARP requests, see sr_arpcache.h. */
+void sr_arpcache_set_retry(struct sr_arpcache *cache, unsigned int retry_ms) {
+    pthread_mutex_lock(&(cache->lock));
+    cache->retry_ms = retry_ms ? retry_ms : SR_ARPREQ_RETRY;
+    pthread_mutex_unlock(&(cache->lock));
+}
+
+/* Sets the request queue caps, see sr_arpcache.h. */
+void sr_arpcache_set_queue_limits(struct sr_arpcache *cache,
+                                  unsigned int req_bytes,
+                                  unsigned int total_bytes,
+                                  enum sr_arpq_policy policy)
+{
+    pthread_mutex_lock(&(cache->lock));
+    cache->req_limit = req_bytes ? req_bytes : SR_ARPQ_REQ_BYTES;
+    cache->total_limit = total_bytes ? total_bytes : SR_ARPQ_TOTAL_BYTES;
+    cache->policy = policy;
+    pthread_mutex_unlock(&(cache->lock));
 }
 
 /* Adds an ARP request to the ARP request queue. If the request is already on
    the queue, adds the packet to the linked list of packets for this sr_arpreq
    that corresponds to this ARP request. You should free the passed *packet.
+   Packets over the queue caps are dropped, see sr_arpcache.h.
 
    A pointer to the ARP request is returned; it should not be freed. The caller
    can remove the ARP request from the queue by calling sr_arpreq_destroy. */
@@ -159,7 +627,7 @@ struct sr_arpreq *sr_arpcache_queuereq(struct sr_arpcache *cache,
                                        uint32_t ip,
                                        uint8_t *packet,           /* borrowed */
                                        unsigned int packet_len,
-                                       char *iface)
+                                       unsigned int if_index)
 {
     pthread_mutex_lock(&(cache->lock));
 
@@ -172,23 +640,63 @@ struct sr_arpreq *sr_arpcache_queuereq(struct sr_arpcache *cache,
 
     /* If the IP wasn't found, add it */
     if (!req) {
-        req = (struct sr_arpreq *) calloc(1, sizeof(struct sr_arpreq));
+        req = (struct sr_arpreq *) sr_pool_get(&(cache->req_pool));
+        if (!req) {
+            pthread_mutex_unlock(&(cache->lock));
+            return NULL;
+        }
+        memset(req, 0, sizeof(struct sr_arpreq));
         req->ip = ip;
         req->next = cache->requests;
         cache->requests = req;
+        /* first request goes out as soon as the ARP thread runs */
+        req->timer.kind = arp_timer_request;
+        sr_arpcache_schedule(cache, &(req->timer), sr_timer_now());
     }
 
     /* Add the packet to the list of packets for this request */
-    if (packet && packet_len && iface) {
-        struct sr_packet *new_pkt = (struct sr_packet *)malloc(sizeof(struct sr_packet));
+    if (packet && packet_len && if_index != SR_IF_NONE) {
+        struct sr_packet *new_pkt = NULL;
+        uint8_t *buf = NULL;
+
+        req->queued++;
+        cache->queued++;
+
+        /* Make room under the caps, or drop the packet */
+        while (req->qbytes + packet_len > cache->req_limit ||
+               cache->qbytes + packet_len > cache->total_limit) {
+            if (cache->policy != arpq_drop_oldest || !req->packets)
+                break;
+            sr_arpreq_drop_oldest(cache, req);
+        }
+
+        if (req->qbytes + packet_len <= cache->req_limit &&
+            cache->qbytes + packet_len <= cache->total_limit) {
+            new_pkt = (struct sr_packet *)sr_pool_get(&(cache->pkt_pool));
+            buf = sr_arpcache_frame_get(cache, packet_len);
+        }
 
-        new_pkt->buf = (uint8_t *)malloc(packet_len);
-        memcpy(new_pkt->buf, packet, packet_len);
-        new_pkt->len = packet_len;
-		new_pkt->iface = (char *)malloc(sr_IFACE_NAMELEN);
-        strncpy(new_pkt->iface, iface, sr_IFACE_NAMELEN);
-        new_pkt->next = req->packets;
-        req->packets = new_pkt;
+        if (new_pkt && buf) {
+            memcpy(buf, packet, packet_len);
+            new_pkt->buf = buf;
+            new_pkt->len = packet_len;
+            new_pkt->if_index = if_index;
+            new_pkt->next = NULL;
+            if (req->last)
+                req->last->next = new_pkt;
+            else
+                req->packets = new_pkt;
+            req->last = new_pkt;
+            req->qbytes += packet_len;
+            cache->qbytes += packet_len;
+        }
+        else {
+            sr_pool_put(&(cache->pkt_pool), new_pkt);
+            if (buf)
+                sr_arpcache_frame_put(cache, buf, packet_len);
+            req->dropped++;
+            cache->dropped++;
+        }
     }
 
     pthread_mutex_unlock(&(cache->lock));
@@ -222,60 +730,87 @@ struct sr_arpreq *sr_arpcache_insert(struct sr_arpcache *cache,
         }
         prev = req;
     }
-
-    int i;
-    for (i = 0; i < SR_ARPCACHE_SZ; i++) {
-        if (!(cache->entries[i].valid))
-            break;
+    if (req) {
+        sr_wheel_del(&(cache->wheel), &(req->timer));
+        cache->flushed += req->queued - req->dropped;
     }
 
-    if (i != SR_ARPCACHE_SZ) {
-        memcpy(cache->entries[i].mac, mac, 6);
-        cache->entries[i].ip = ip;
-        cache->entries[i].added = time(NULL);
-        cache->entries[i].valid = 1;
-    }
+    sr_arpcache_write_begin(cache);
+    sr_arpcache_put_locked(cache, mac, ip);
+    sr_arpcache_write_end(cache);
 
     pthread_mutex_unlock(&(cache->lock));
 
     return req;
 }
 
+/* Removes entry from the request queue if it is on it. Caller holds the
+   lock. */
+static void sr_arpreq_unlink(struct sr_arpcache *cache, struct sr_arpreq *entry) {
+    struct sr_arpreq **pp;
+
+    for (pp = &(cache->requests); *pp; pp = &((*pp)->next)) {
+        if (*pp == entry) {
+            *pp = entry->next;
+            break;
+        }
+    }
+}
+
+/* Puts req, taken off the queue as resolved, back on it: its entry aged
+   out before the frames went. The frames keep their bytes under the caps
+   and are not counted as flushed, or as queued again. If a request for the
+   ip was queued since, they go in front of its frames, being older. */
+static void sr_arpreq_requeue(struct sr_arpcache *cache, struct sr_arpreq *req) {
+    struct sr_arpreq *cur;
+
+    pthread_mutex_lock(&(cache->lock));
+    cache->flushed -= req->queued - req->dropped;
+    for (cur = cache->requests; cur; cur = cur->next)
+        if (cur->ip == req->ip)
+            break;
+
+    if (cur) {
+        if (req->packets) {
+            req->last->next = cur->packets;
+            if (!cur->packets)
+                cur->last = req->last;
+            cur->packets = req->packets;
+        }
+        cur->qbytes += req->qbytes;
+        cur->queued += req->queued;
+        cur->dropped += req->dropped;
+        sr_pool_put(&(cache->req_pool), req);
+    }
+    else {
+        req->times_sent = 0;
+        req->sent = 0;
+        req->next = cache->requests;
+        cache->requests = req;
+        sr_arpcache_schedule(cache, &(req->timer), sr_timer_now());
+    }
+    pthread_mutex_unlock(&(cache->lock));
+}
+
 /* Frees all memory associated with this arp request entry. If this arp request
    entry is on the arp request queue, it is removed from the queue. */
 void sr_arpreq_destroy(struct sr_arpcache *cache, struct sr_arpreq *entry) {
     pthread_mutex_lock(&(cache->lock));
 
     if (entry) {
-        struct sr_arpreq *req, *prev = NULL, *next = NULL;
-        for (req = cache->requests; req != NULL; req = req->next) {
-            if (req == entry) {
-                if (prev) {
-                    next = req->next;
-                    prev->next = next;
-                }
-                else {
-                    next = req->next;
-                    cache->requests = next;
-                }
-
-                break;
-            }
-            prev = req;
-        }
+        sr_arpreq_unlink(cache, entry);
+        sr_wheel_del(&(cache->wheel), &(entry->timer));
 
         struct sr_packet *pkt, *nxt;
 
         for (pkt = entry->packets; pkt; pkt = nxt) {
             nxt = pkt->next;
-            if (pkt->buf)
-                free(pkt->buf);
-            if (pkt->iface)
-                free(pkt->iface);
-            free(pkt);
+            cache->qbytes -= pkt->len;
+            sr_arpcache_frame_put(cache, pkt->buf, pkt->len);
+            sr_pool_put(&(cache->pkt_pool), pkt);
         }
 
-        free(entry);
+        sr_pool_put(&(cache->req_pool), entry);
     }
 
     pthread_mutex_unlock(&(cache->lock));
@@ -283,64 +818,202 @@ void sr_arpreq_destroy(struct sr_arpcache *cache, struct sr_arpreq *entry) {
 
 /* Prints out the ARP table. */
 void sr_arpcache_dump(struct sr_arpcache *cache) {
+    pthread_mutex_lock(&(cache->lock));
+
+    fprintf(stderr, "\nARP cache: %u/%u entries, %u slots, %lu evictions\n",
+            cache->count, cache->capacity, cache->mask + 1, cache->evictions);
     fprintf(stderr, "\nMAC            IP         ADDED                      VALID\n");
     fprintf(stderr, "-----------------------------------------------------------\n");
 
-    int i;
-    for (i = 0; i < SR_ARPCACHE_SZ; i++) {
+    unsigned int i;
+    for (i = 0; i <= cache->mask; i++) {
         struct sr_arpentry *cur = &(cache->entries[i]);
         unsigned char *mac = cur->mac;
+        if (!cur->valid)
+            continue;
         fprintf(stderr, "%.1x%.1x%.1x%.1x%.1x%.1x   %.8x   %.24s   %d\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], ntohl(cur->ip), ctime(&(cur->added)), cur->valid);
     }
 
+    fprintf(stderr, "\nARP requests: %u/%u bytes queued, %u per next hop, drop %s\n",
+            cache->qbytes, cache->total_limit, cache->req_limit,
+            cache->policy == arpq_drop_oldest ? "oldest" : "tail");
+    fprintf(stderr, "queued %lu, dropped %lu, flushed %lu, expired %lu\n",
+            cache->queued, cache->dropped, cache->flushed, cache->expired);
+    fprintf(stderr, "retry every %u ms, %lu timers pending\n",
+            cache->retry_ms, cache->wheel.count);
+    fprintf(stderr, "lookups %lu hit, %lu missed; polls %lu sent, %lu entries "
+            "kept, %lu removed unanswered\n", cache->hits, cache->misses,
+            cache->refreshes, cache->refreshed, cache->refresh_failed);
+    fprintf(stderr, "down for %u ms: %u next hops now, %lu ever, %lu frames "
+            "not queued\n", cache->neg_ms, cache->neg_count, cache->neg_added,
+            cache->neg_hits);
+    fprintf(stderr, "\nNEXT HOP   SENT  PENDING   BYTES     QUEUED    DROPPED\n");
+    fprintf(stderr, "-----------------------------------------------------\n");
+
+    struct sr_arpreq *req;
+    for (req = cache->requests; req; req = req->next) {
+        fprintf(stderr, "%.8x   %4u  %7lu  %6u  %9lu  %9lu\n", ntohl(req->ip),
+                req->times_sent, req->queued - req->dropped, req->qbytes,
+                req->queued, req->dropped);
+    }
+
     fprintf(stderr, "\n");
+    sr_arpcache_dump_pools(cache, stderr);
+
+    pthread_mutex_unlock(&(cache->lock));
 }
 
-/* Initialize table + table lock. Returns 0 on success. */
-int sr_arpcache_init(struct sr_arpcache *cache) {
+/* Prints allocation statistics for the request queue pools. */
+void sr_arpcache_dump_pools(struct sr_arpcache *cache, FILE *fp) {
+    sr_pool_dump(&(cache->req_pool), fp);
+    sr_pool_dump(&(cache->pkt_pool), fp);
+    sr_pool_dump(&(cache->frame_pool), fp);
+    sr_pool_dump(&(cache->timer_pool), fp);
+    sr_pool_dump(&(cache->neg_pool), fp);
+    fprintf(fp, "%-10s %lu frames over %d bytes malloc'd\n", "oversize",
+            cache->frame_mallocs, SR_FRAME_MAX);
+}
+
+/* Frame buffers for queued packets, with SR_PKT_HEADROOM in front so the
+   frame can be sent in place once the next hop resolves. */
+uint8_t *sr_arpcache_frame_get(struct sr_arpcache *cache, unsigned int len) {
+    uint8_t *buf;
+
+    if (len <= SR_FRAME_MAX)
+        buf = (uint8_t *) sr_pool_get(&(cache->frame_pool));
+    else {
+        buf = (uint8_t *) malloc(SR_PKT_HEADROOM + len);
+        __atomic_fetch_add(&(cache->frame_mallocs), 1, __ATOMIC_RELAXED);
+    }
+    return buf ? buf + SR_PKT_HEADROOM : NULL;
+}
+
+void sr_arpcache_frame_put(struct sr_arpcache *cache, uint8_t *frame, unsigned int len) {
+    if (!frame)
+        return;
+    if (len <= SR_FRAME_MAX)
+        sr_pool_put(&(cache->frame_pool), frame - SR_PKT_HEADROOM);
+    else
+        free(frame - SR_PKT_HEADROOM);
+}
+
+/* Initialize table + table lock. The table holds up to capacity entries
+   (SR_ARPCACHE_SZ if 0) in a power of two number of slots at most half
+   full. Returns 0 on success. */
+int sr_arpcache_init(struct sr_arpcache *cache, unsigned int capacity) {
+    unsigned int slots = 2, bits = 1;
+
     /* Seed RNG to kick out a random entry if all entries full. */
     srand(time(NULL));
 
+    if (capacity == 0)
+        capacity = SR_ARPCACHE_SZ;
+    while (slots < 2 * capacity) {
+        slots <<= 1;
+        bits++;
+    }
+
     /* Invalidate all entries */
-    memset(cache->entries, 0, sizeof(cache->entries));
+    cache->entries = (struct sr_arpentry *) calloc(slots, sizeof(struct sr_arpentry));
+    cache->neg = (struct sr_arpneg **) calloc(slots / 2, sizeof(struct sr_arpneg *));
+    if (!cache->entries || !cache->neg)
+        return -1;
+    cache->capacity = capacity;
+    cache->mask = slots - 1;
+    cache->shift = 32 - bits;
+    cache->count = 0;
+    cache->evictions = 0;
+    cache->seq = 0;
     cache->requests = NULL;
+    cache->frame_mallocs = 0;
+    cache->req_limit = SR_ARPQ_REQ_BYTES;
+    cache->total_limit = SR_ARPQ_TOTAL_BYTES;
+    cache->policy = arpq_drop_tail;
+    cache->qbytes = 0;
+    cache->queued = cache->dropped = cache->flushed = cache->expired = 0;
+    cache->timer_id = 0;
+    cache->hits = cache->misses = 0;
+    cache->refreshes = cache->refreshed = cache->refresh_failed = 0;
+    cache->retry_ms = SR_ARPREQ_RETRY;
+    cache->wake = 0;
+    cache->neg_mask = slots / 2 - 1;
+    cache->neg_count = 0;
+    cache->neg_ms = SR_ARPNEG_TO;
+    cache->neg_added = cache->neg_hits = 0;
+
+    if (sr_pool_init(&(cache->req_pool), "arpreq", sizeof(struct sr_arpreq), 64) ||
+        sr_pool_init(&(cache->pkt_pool), "packet", sizeof(struct sr_packet), 256) ||
+        sr_pool_init(&(cache->frame_pool), "frame", SR_PKT_HEADROOM + SR_FRAME_MAX, 64) ||
+        sr_pool_init(&(cache->timer_pool), "arptimer", sizeof(struct sr_arptimer), 256) ||
+        sr_pool_init(&(cache->neg_pool), "arpneg", sizeof(struct sr_arpneg), 64) ||
+        sr_wheel_init(&(cache->wheel)))
+        return -1;
 
     /* Acquire mutex lock */
     pthread_mutexattr_init(&(cache->attr));
     pthread_mutexattr_settype(&(cache->attr), PTHREAD_MUTEX_RECURSIVE);
     int success = pthread_mutex_init(&(cache->lock), &(cache->attr));
 
+    /* the ARP thread sleeps on the wheel's clock */
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    success = success || pthread_cond_init(&(cache->wake_cond), &cattr);
+    pthread_condattr_destroy(&cattr);
+
     return success;
 }
 
 /* Destroys table + table lock. Returns 0 on success. */
 int sr_arpcache_destroy(struct sr_arpcache *cache) {
+    free(cache->entries);
+    cache->entries = NULL;
+    free(cache->neg);
+    cache->neg = NULL;
+    sr_pool_destroy(&(cache->req_pool));
+    sr_pool_destroy(&(cache->pkt_pool));
+    sr_pool_destroy(&(cache->frame_pool));
+    sr_pool_destroy(&(cache->timer_pool));
+    sr_pool_destroy(&(cache->neg_pool));
+    sr_wheel_destroy(&(cache->wheel));
+    pthread_cond_destroy(&(cache->wake_cond));
     return pthread_mutex_destroy(&(cache->lock)) && pthread_mutexattr_destroy(&(cache->attr));
 }
 
-/* Thread which sweeps through the cache and invalidates entries that were added
-   more than SR_ARPCACHE_TO seconds ago. */
+/* Thread which runs the cache's timers: entries are invalidated once they
+   were added more than SR_ARPCACHE_TO seconds ago and requests are resent
+   every retry_ms. It sleeps until the wheel's next busy slot, at most
+   SR_ARP_IDLE ms, or until something is scheduled sooner. */
 void *sr_arpcache_timeout(void *sr_ptr) {
     struct sr_instance *sr = sr_ptr;
     struct sr_arpcache *cache = &(sr->cache);
+    struct timespec ts;
+    uint64_t now, next;
 
-    while (1) {
-        sleep(1.0);
-
-        pthread_mutex_lock(&(cache->lock));
-
-        time_t curtime = time(NULL);
+    /* reads routes while running timers, only online then (see sr_qsbr.h) */
+    sr_qsbr_register(&(sr->qsbr));
+    sr_qsbr_offline();
 
-        int i;
-        for (i = 0; i < SR_ARPCACHE_SZ; i++) {
-            if ((cache->entries[i].valid) && (difftime(curtime,cache->entries[i].added) > SR_ARPCACHE_TO)) {
-                cache->entries[i].valid = 0;
-            }
+    pthread_mutex_lock(&(cache->lock));
+    while (1) {
+        now = sr_timer_now();
+        next = sr_wheel_next(&(cache->wheel), now + SR_ARP_IDLE);
+        if (next > now) {
+            cache->wake = next;
+            ts.tv_sec = next / 1000;
+            ts.tv_nsec = (next % 1000) * 1000000;
+            pthread_cond_timedwait(&(cache->wake_cond), &(cache->lock), &ts);
+            cache->wake = 0;
+            continue;
         }
+        pthread_mutex_unlock(&(cache->lock));
 
+        /* takes the lock itself, and only while running the wheel */
+        sr_qsbr_online();
         sr_arpcache_sweepreqs(sr);
+        sr_qsbr_offline();
 
-        pthread_mutex_unlock(&(cache->lock));
+        pthread_mutex_lock(&(cache->lock));
     }
 
     return NULL;
@@ -53,6 +53,11 @@
    all packets waiting on this ARP request), you must fill out the following
    function that is called every second and is defined in sr_arpcache.c:
 
+   (This router runs the requests and entries off a timing wheel instead,
+   see sr_arpcache_sweepreqs: each request and entry is looked at only when
+   its own retry or expiry comes due, and the retry interval is set with
+   sr_arpcache_set_retry.)
+
    void sr_arpcache_sweepreqs(struct sr_instance *sr) {
        for each request on sr->cache.requests:
            handle_arpreq(request)
@@ -70,58 +75,207 @@
 #include <time.h>
 #include <pthread.h>
 #include "sr_if.h"
+#include "sr_pool.h"
+#include "sr_timer.h"
 
-#define SR_ARPCACHE_SZ    100
+#define SR_ARPCACHE_SZ    100   /* default capacity, see sr_arpcache_init */
 #define SR_ARPCACHE_TO    15.0
+#define SR_ARPCACHE_REFRESH 3.0 /* seconds before SR_ARPCACHE_TO a used entry
+                                   is polled */
+#define SR_ARPREQ_RETRY   1000  /* default ms between ARP requests */
+#define SR_ARPREQ_TRIES   5     /* requests sent before giving up */
+#define SR_ARP_IDLE       1000  /* ms the ARP thread sleeps at most */
+#define SR_ARPNEG_TO      5000  /* default ms a next hop that never answered
+                                   is treated as down */
+#define SR_ARPNEG_ICMP    10    /* host unreachables a second per down next
+                                   hop, the rest are dropped quietly */
+#define SR_FRAME_MAX      1514  /* largest frame kept in the frame pool */
+
+/* default caps on frames queued behind outstanding ARP requests */
+#define SR_ARPQ_REQ_BYTES   (64 * 1024)   /* per next hop */
+#define SR_ARPQ_TOTAL_BYTES (1024 * 1024) /* all next hops */
+
+/* what to do with a frame that would go over a cap */
+enum sr_arpq_policy {
+    arpq_drop_tail = 0,         /* drop the new frame */
+    arpq_drop_oldest,           /* drop the next hop's oldest frames first */
+};
 
 struct sr_packet {
     uint8_t *buf;               /* A raw Ethernet frame, presumably with the dest MAC empty */
     unsigned int len;           /* Length of raw Ethernet frame */
-    char *iface;                /* The outgoing interface */
+    unsigned int if_index;      /* The outgoing interface, see sr_if_by_index */
     struct sr_packet *next;
 };
 
 struct sr_arpentry {
     unsigned char mac[6];
+    unsigned char used;         /* looked up since the last poll, set by
+                                   readers without the lock */
+    unsigned char refresh;      /* unanswered polls, see sr_arpcache_expire */
     uint32_t ip;                /* IP addr in network byte order */
     time_t added;
     int valid;
+    unsigned int timer;         /* id of the timer that expires it, 0 if none */
+};
+
+/* timer kinds on the cache's wheel */
+enum sr_arp_timer_kind {
+    arp_timer_request = 0,      /* the sr_arpreq it is the start of */
+    arp_timer_entry,            /* a struct sr_arptimer */
+    arp_timer_negative,         /* a struct sr_arpneg */
+};
+
+/* Expiry of an entry. Entries move between slots, so the timer is found
+   by ip and only counts while the entry still carries its id. It may fire
+   early for an entry refreshed since: it is then added again. */
+struct sr_arptimer {
+    struct sr_timer timer;
+    uint32_t ip;
+    unsigned int id;
+};
+
+/* A next hop whose ARP request ran out of tries. Until it expires,
+   frames for it are answered with host unreachable straight away instead
+   of starting another round of requests with the frames queued behind
+   it. An ARP packet from it removes it. */
+struct sr_arpneg {
+    struct sr_timer timer;      /* expiry, first so the wheel hands back the
+                                   entry */
+    uint32_t ip;
+    unsigned int icmp_sent;     /* host unreachables sent in icmp_sec */
+    time_t icmp_sec;
+    struct sr_arpneg *next;     /* in its bucket */
+};
+
+/* what sr_arpcache_dead says to do with a frame */
+enum sr_arpneg_verdict {
+    arpneg_none = 0,            /* next hop not known to be down, queue it */
+    arpneg_icmp,                /* down, drop it and send host unreachable */
+    arpneg_quiet,               /* down, drop it, over SR_ARPNEG_ICMP */
 };
 
 struct sr_arpreq {
+    struct sr_timer timer;      /* next retry, first so the wheel hands
+                                   back the request */
     uint32_t ip;
     time_t sent;                /* Last time this ARP request was sent. You
                                    should update this. If the ARP request was
                                    never sent, will be 0. */
     uint32_t times_sent;        /* Number of times this request was sent. You
                                    should update this. */
-    struct sr_packet *packets;  /* List of pkts waiting on this req to finish */
+    struct sr_packet *packets;  /* List of pkts waiting on this req to finish,
+                                   oldest first */
+    struct sr_packet *last;     /* Newest packet, where new ones are added */
+    unsigned int qbytes;        /* Bytes of frames in packets */
+    unsigned long queued;       /* Frames ever queued on this request */
+    unsigned long dropped;      /* Frames dropped by the queue caps */
     struct sr_arpreq *next;
 };
 
+/* entries is an open addressing (linear probing) hash table keyed by IP with
+   mask + 1 slots, kept at most half full. Lookups are lock-free: writers
+   serialise on lock and publish through the seq seqlock, readers retry if a
+   write overlapped them. lock also protects the request queue and the
+   wheel, which holds a timer for every entry and request. */
 struct sr_arpcache {
-    struct sr_arpentry entries[SR_ARPCACHE_SZ];
+    struct sr_arpentry *entries;
+    unsigned int seq;           /* odd while a write is in progress */
+    unsigned int gen;           /* bumped when a mapping is removed or its
+                                   MAC changes, see sr_dst.h */
+    unsigned int mask;          /* slots - 1, slots is a power of two */
+    unsigned int shift;         /* 32 - log2(slots), for the hash */
+    unsigned int capacity;      /* max valid entries before eviction */
+    unsigned int count;         /* valid entries */
+    unsigned long evictions;
     struct sr_arpreq *requests;
     pthread_mutex_t lock;
     pthread_mutexattr_t attr;
+
+    /* retries and expiries, run by the ARP thread, see sr_arpcache_timeout */
+    struct sr_wheel wheel;
+    struct sr_pool timer_pool;  /* struct sr_arptimer */
+    unsigned int timer_id;      /* last entry timer id handed out */
+    unsigned int retry_ms;      /* between ARP requests */
+    uint64_t wake;              /* when the sleeping ARP thread wakes, 0 while
+                                   it is awake */
+    pthread_cond_t wake_cond;   /* sooner timers wake it, with lock */
+
+    /* queued requests, packets and frames come from these instead of malloc */
+    struct sr_pool req_pool;
+    struct sr_pool pkt_pool;
+    struct sr_pool frame_pool;  /* SR_FRAME_MAX bytes plus headroom */
+    unsigned long frame_mallocs; /* frames too big for frame_pool */
+
+    /* bounds on the request queue, see sr_arpcache_set_queue_limits */
+    unsigned int req_limit;     /* bytes queued per request */
+    unsigned int total_limit;   /* bytes queued over all requests */
+    enum sr_arpq_policy policy;
+    unsigned int qbytes;        /* bytes queued over all requests */
+    unsigned long queued;       /* totals over all requests, past and present */
+    unsigned long dropped;
+    unsigned long flushed;      /* sent on once the next hop resolved */
+    unsigned long expired;      /* given up on after SR_ARPREQ_TRIES */
+
+    /* the data path's lookups (sr_arpcache_resolve), a miss is a frame
+       queued behind ARP, and refreshing ahead of expiry to avoid misses */
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long refreshes;    /* unicast polls sent */
+    unsigned long refreshed;    /* entries a poll kept in service */
+    unsigned long refresh_failed; /* polled entries removed unanswered */
+
+    /* next hops that are down, see sr_arpcache_dead; neg has neg_mask + 1
+       buckets and holds at most capacity entries */
+    struct sr_arpneg **neg;
+    unsigned int neg_mask;
+    unsigned int neg_count;     /* read without the lock */
+    unsigned int neg_ms;        /* how long an entry lasts */
+    struct sr_pool neg_pool;
+    unsigned long neg_added;
+    unsigned long neg_hits;     /* frames dropped without queueing */
 };
 
 /* Checks if an IP->MAC mapping is in the cache. IP is in network byte order.
-   You must free the returned structure if it is not NULL. */
+   On a hit the MAC is copied to mac (ETHER_ADDR_LEN bytes) and 1 is
+   returned, otherwise 0. Nothing is allocated. */
+int sr_arpcache_lookup_mac(struct sr_arpcache *cache, uint32_t ip, unsigned char *mac);
+
+/* The forwarding path's lookup: sr_arpcache_lookup_mac that also counts
+   hits and misses and marks the entry used, so it is refreshed before it
+   expires. Returns the entry's slot, which stays put until the cache's gen
+   changes, or -1. */
+int sr_arpcache_resolve(struct sr_arpcache *cache, uint32_t ip, unsigned char *mac);
+
+/* Marks the entry in slot (from sr_arpcache_resolve, gen unchanged since)
+   used, for lookups answered from elsewhere, e.g. sr_dst. */
+void sr_arpcache_touch(struct sr_arpcache *cache, unsigned int slot);
+
+/* Checks if an IP->MAC mapping is in the cache. IP is in network byte order.
+   You must free the returned structure if it is not NULL. Prefer
+   sr_arpcache_lookup_mac, which does not allocate. */
 struct sr_arpentry *sr_arpcache_lookup(struct sr_arpcache *cache, uint32_t ip);
 
+/* Inserts or refreshes an IP->MAC mapping without touching the request
+   queue. If the cache is at capacity a random entry is evicted. */
+void sr_arpcache_put(struct sr_arpcache *cache, unsigned char *mac, uint32_t ip);
+
 /* Adds an ARP request to the ARP request queue. If the request is already on
    the queue, adds the packet to the linked list of packets for this sr_arpreq
    that corresponds to this ARP request. The packet argument should not be
    freed by the caller.
 
+   The packet is copied, unless that would take the request or the whole
+   queue over its byte cap: then either the packet or (with
+   arpq_drop_oldest) this request's oldest packets are dropped.
+
    A pointer to the ARP request is returned; it should not be freed. The caller
    can remove the ARP request from the queue by calling sr_arpreq_destroy. */
 struct sr_arpreq *sr_arpcache_queuereq(struct sr_arpcache *cache,
                          uint32_t ip,
                          uint8_t *packet,               /* borrowed */
                          unsigned int packet_len,
-                         char *iface);
+                         unsigned int if_index);
 
 /* This method performs two functions:
    1) Looks up this IP in the request queue. If it is found, returns a pointer
@@ -131,22 +285,59 @@ struct sr_arpreq *sr_arpcache_insert(struct sr_arpcache *cache,
                                      unsigned char *mac,
                                      uint32_t ip);
 
+/* Sends the packets queued on a request taken off the queue (see
+   sr_arpcache_insert) to its next hop's mac. The request is left for the
+   caller to destroy. */
+void sr_arpreq_flush(struct sr_instance *sr, struct sr_arpreq *req,
+                     const unsigned char *mac);
+
 /* Frees all memory associated with this arp request entry. If this arp request
    entry is on the arp request queue, it is removed from the queue. */
 void sr_arpreq_destroy(struct sr_arpcache *cache, struct sr_arpreq *entry);
 
-/* Prints out the ARP table. */
+/* Caps the bytes of frames queued per request and over all requests (0 for
+   the defaults) and sets what gets dropped when a cap is hit. */
+void sr_arpcache_set_queue_limits(struct sr_arpcache *cache,
+                                  unsigned int req_bytes,
+                                  unsigned int total_bytes,
+                                  enum sr_arpq_policy policy);
+
+/* Sets the time between ARP requests for a next hop, in ms (0 for the
+   default); under a second is fine. Requests already waiting keep the
+   interval they were scheduled with until their next retry. */
+void sr_arpcache_set_retry(struct sr_arpcache *cache, unsigned int retry_ms);
+
+/* Sets how long a next hop stays down after its ARP request ran out of
+   tries, in ms (0 for the default). Entries already down keep theirs. */
+void sr_arpcache_set_negative(struct sr_arpcache *cache, unsigned int neg_ms);
+
+/* Checks whether a next hop is down, for a frame about to be queued on
+   it. A caller told anything but arpneg_none drops the frame. Costs one
+   load while no next hop is down. */
+enum sr_arpneg_verdict sr_arpcache_dead(struct sr_arpcache *cache, uint32_t ip);
+
+/* Prints out the ARP table and the request queue. */
 void sr_arpcache_dump(struct sr_arpcache *cache);
 
+/* Prints allocation statistics for the request queue pools. */
+void sr_arpcache_dump_pools(struct sr_arpcache *cache, FILE *fp);
+
+/* Gets a buffer for a len byte frame with SR_PKT_HEADROOM in front of it, from
+   the frame pool unless len is over SR_FRAME_MAX. Returns the frame, which
+   must be given back with sr_arpcache_frame_put and the same len. */
+uint8_t *sr_arpcache_frame_get(struct sr_arpcache *cache, unsigned int len);
+void sr_arpcache_frame_put(struct sr_arpcache *cache, uint8_t *frame, unsigned int len);
+
 /* You shouldn't have to call these methods--they're already called in the
    starter code for you. The init call is a constructor, the destroy call is
-   a destructor, and a cleanup thread times out cache entries every 15
-   seconds. */
+   a destructor, and a cleanup thread times out cache entries after 15
+   seconds and retries requests, whenever their timers come due. */
 /* =====================================================
   sr_arp_make_packet
   Allows us to make an ARP packet, we can determine if the
   packet is a reply or request by setting the mode to 0
-  or 1, respectively.
+  or 1, respectively. Mode 2 is a request sent straight
+  to tha, to refresh a mapping we already have.
    ===================================================== */
 void sr_arp_make_packet(struct sr_instance* sr,struct sr_if* interface,
    				  const unsigned char* tha,uint32_t target_ip, int mode);
@@ -156,7 +347,13 @@ void sr_arp_make_packet(struct sr_instance* sr,struct sr_if* interface,
   given the instance and target IP.
    ===================================================== */
 void sr_arp_request(struct sr_instance* sr,uint32_t target_ip);
-int   sr_arpcache_init(struct sr_arpcache *cache);
+/* =====================================================
+  sr_arp_refresh
+  Polls target IP at the MAC we have for it, unicast.
+   ===================================================== */
+void sr_arp_refresh(struct sr_instance* sr,uint32_t target_ip,
+                    const unsigned char* mac);
+int   sr_arpcache_init(struct sr_arpcache *cache, unsigned int capacity);
 int   sr_arpcache_destroy(struct sr_arpcache *cache);
 void *sr_arpcache_timeout(void *cache_ptr);
 
@@ -0,0 +1,1910 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_bench.c
+ *
+ * Description:
+ *
+ * Micro benchmarks for the router data path.  Built with 'make bench',
+ * which links against the router objects (everything but sr_main.o).
+ *
+ *   ./sr_bench lpm       FIB vs linear routing list walk
+ *   ./sr_bench arp       ARP cache lookups, N readers against one writer
+ *   ./sr_bench queue     queueing packets behind unresolved next hops
+ *   ./sr_bench cksum     TTL rewrite: full checksum vs RFC 1624 update
+ *   ./sr_bench sum       checksum kernels over 20, 576 and 1500 byte buffers
+ *   ./sr_bench pipeline  whole-router forwarding rate with 0/1/2/4/8 workers
+ *   ./sr_bench log       forwarding rate with per packet logging on and off
+ *   ./sr_bench pcap      forwarding rate while capturing packets
+ *   ./sr_bench reload    forwarding rate while reloading 100k routes
+ *   ./sr_bench rtload    loading 1k/100k/1M route tables, text and binary
+ *   ./sr_bench timers    ARP retries under a second, cost of ARP timers
+ *   ./sr_bench arpwait   first packet delay to a next hop not yet in ARP
+ *   ./sr_bench refresh   steady flows across ARP entry expiry (~20 s)
+ *   ./sr_bench deadhop   traffic to a next hop that never answers ARP
+ *   ./sr_bench burst     forwarding rate in bursts of 1/8/32/64 frames
+ *
+ * Numbers are only meaningful with optimisation on, e.g.
+ *   make bench CFLAGS="-O2 -Wall -ansi -D_GNU_SOURCE -D_LINUX_"
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_router.h"
+#include "sr_rt.h"
+#include "sr_fib.h"
+#include "sr_dst.h"
+#include "sr_arpcache.h"
+#include "sr_if.h"
+#include "sr_protocol.h"
+#include "sr_utils.h"
+#include "sr_pipeline.h"
+#include "sr_burst.h"
+#include "sr_pcap.h"
+#include "vnscommand.h"
+#include "inet_cksum.h"
+
+/*---------------------------------------------------------------------
+ * Method: bench_now(), bench_rand()
+ * Scope: Local
+ *
+ * Monotonic time in nanoseconds and a small deterministic PRNG so runs
+ * are comparable.
+ *
+ *---------------------------------------------------------------------*/
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t bench_seed = 12345;
+
+/* results are folded in here so lookups are not optimised away */
+static volatile uintptr_t bench_sink;
+
+static uint32_t bench_rand(void)
+{
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= bench_seed << 5;
+    return bench_seed;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_make_routes(..)
+ * Scope: Local
+ *
+ * Build a routing list of n random prefixes, mostly /16-/24 like a real
+ * table, with a default route at the end.  Entries are allocated as one
+ * array and chained.
+ *
+ *---------------------------------------------------------------------*/
+
+static struct sr_rt* bench_make_routes(unsigned int n)
+{
+    static const uint32_t lens[] = { 8, 12, 16, 19, 20, 22, 24, 24, 24, 24,
+                                     24, 24, 25, 28, 30, 32 };
+    struct sr_rt* rt = calloc(n, sizeof(struct sr_rt));
+    unsigned int  i;
+    uint32_t      len;
+
+    for(i = 0; i < n; i++)
+    {
+        len = (i == n - 1) ? 0 : lens[bench_rand() % 16];
+        rt[i].mask.s_addr = htonl(len ? 0xffffffffu << (32 - len) : 0);
+        rt[i].dest.s_addr = htonl(bench_rand()) & rt[i].mask.s_addr;
+        rt[i].gw.s_addr   = htonl(i);
+        snprintf(rt[i].interface, sr_IFACE_NAMELEN, "eth%u", i % 4);
+        rt[i].next = (i == n - 1) ? 0 : &rt[i + 1];
+    }
+    return rt;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_lpm(..)
+ * Scope: Local
+ *
+ * Compare sr_fib_lookup against the list walk at 10, 1k, 100k and 1M
+ * prefixes.  Addresses are drawn from the loaded prefixes so most
+ * lookups hit something longer than the default route; the two
+ * implementations are cross checked on the first 1000 addresses.
+ *
+ *---------------------------------------------------------------------*/
+
+static int bench_lpm(void)
+{
+    static const unsigned int sizes[] = { 10, 1000, 100000, 1000000 };
+    const unsigned int nfib = 4000000;
+    unsigned int  s, i, n, nlin, bad;
+    struct sr_rt* rt;
+    struct sr_fib* fib;
+    uint32_t*     addrs;
+    double        t0, t_build, t_fib, t_lin;
+    uintptr_t     sink = 0;
+
+    printf("%10s %12s %14s %14s %10s\n",
+           "prefixes", "build ms", "fib ns/lkup", "list ns/lkup", "speedup");
+
+    addrs = malloc(nfib * sizeof(uint32_t));
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        n  = sizes[s];
+        rt = bench_make_routes(n);
+
+        for(i = 0; i < nfib; i++)
+        {
+            struct sr_rt* r = &rt[bench_rand() % n];
+            addrs[i] = r->dest.s_addr |
+                       (htonl(bench_rand()) & ~r->mask.s_addr);
+        }
+
+        t0 = bench_now();
+        fib = sr_fib_build(rt);
+        t_build = bench_now() - t0;
+
+        t0 = bench_now();
+        for(i = 0; i < nfib; i++)
+        { sink += (uintptr_t)sr_fib_lookup(fib, addrs[i]); }
+        t_fib = (bench_now() - t0) / nfib;
+
+        /* keep the list walk to roughly 2e8 route visits */
+        nlin = 200000000u / n;
+        if(nlin > nfib) { nlin = nfib; }
+        if(nlin < 20)   { nlin = 20; }
+
+        t0 = bench_now();
+        for(i = 0; i < nlin; i++)
+        { sink += (uintptr_t)sr_rt_lookup_linear(rt, addrs[i]); }
+        t_lin = (bench_now() - t0) / nlin;
+
+        bad = 0;
+        for(i = 0; i < nlin && i < 1000; i++)
+        {
+            if(sr_rt_lookup_linear(rt, addrs[i]) != sr_fib_lookup(fib, addrs[i]))
+            { bad++; }
+        }
+
+        printf("%10u %12.2f %14.2f %14.2f %9.0fx\n", n, t_build / 1e6,
+               t_fib, t_lin, t_lin / t_fib);
+        if(bad)
+        {
+            fprintf(stderr, "lpm: %u lookups disagree with the list walk\n",
+                    bad);
+            return 1;
+        }
+
+        sr_fib_destroy(fib);
+        free(rt);
+    }
+    free(addrs);
+
+    bench_sink = sink;
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_arp(..)
+ * Scope: Local
+ *
+ * N reader threads look up random neighbours while one writer keeps
+ * refreshing entries, as the ARP reply path and sweeper do.  "mutex"
+ * wraps each lookup in the cache lock the way every lookup used to be;
+ * "seqlock" is the lock-free read path.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_ARP_NEIGH 64
+
+struct bench_arp_arg
+{
+    struct sr_arpcache* cache;
+    int                 locked;
+    volatile int*       stop;
+    unsigned long       ops;
+    uint32_t            seed;
+};
+
+static void* bench_arp_reader(void* p)
+{
+    struct bench_arp_arg* a = p;
+    unsigned char mac[ETHER_ADDR_LEN];
+    unsigned long ops = 0, hits = 0;
+    uint32_t      x = a->seed;
+
+    while(!*a->stop)
+    {
+        x = x * 1103515245u + 12345u;
+        if(a->locked)
+        { pthread_mutex_lock(&(a->cache->lock)); }
+        hits += sr_arpcache_lookup_mac(a->cache, (x >> 8) % BENCH_ARP_NEIGH + 1, mac);
+        if(a->locked)
+        { pthread_mutex_unlock(&(a->cache->lock)); }
+        ops++;
+    }
+    a->ops = ops;
+    bench_sink += hits;
+    return 0;
+}
+
+static void* bench_arp_writer(void* p)
+{
+    struct bench_arp_arg* a = p;
+    unsigned char mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0, 0 };
+    unsigned long ops = 0;
+
+    while(!*a->stop)
+    {
+        mac[5] = ops & 0xff;
+        sr_arpcache_put(a->cache, mac, ops % BENCH_ARP_NEIGH + 1);
+        ops++;
+    }
+    a->ops = ops;
+    return 0;
+}
+
+static int bench_arp(void)
+{
+    static const int readers[] = { 1, 2, 4, 8 };
+    struct sr_arpcache   cache;
+    struct bench_arp_arg r[8], w;
+    pthread_t            rt[8], wt;
+    volatile int         stop;
+    unsigned char        mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0, 0 };
+    unsigned long        total;
+    int                  locked, n, i;
+    uint32_t             ip;
+
+    sr_arpcache_init(&cache, 0);
+    for(ip = 1; ip <= BENCH_ARP_NEIGH; ip++)
+    { sr_arpcache_put(&cache, mac, ip); }
+
+    printf("%8s %8s %16s %16s\n", "mode", "readers", "Mlookups/s", "writer Mputs/s");
+    for(locked = 1; locked >= 0; locked--)
+    {
+        for(n = 0; n < (int)(sizeof(readers) / sizeof(readers[0])); n++)
+        {
+            stop = 0;
+            w.cache = &cache;
+            w.stop  = &stop;
+            pthread_create(&wt, 0, bench_arp_writer, &w);
+            for(i = 0; i < readers[n]; i++)
+            {
+                r[i].cache  = &cache;
+                r[i].locked = locked;
+                r[i].stop   = &stop;
+                r[i].seed   = i + 1;
+                pthread_create(&rt[i], 0, bench_arp_reader, &r[i]);
+            }
+            usleep(500000);
+            stop = 1;
+            total = 0;
+            for(i = 0; i < readers[n]; i++)
+            {
+                pthread_join(rt[i], 0);
+                total += r[i].ops;
+            }
+            pthread_join(wt, 0);
+            printf("%8s %8d %16.2f %16.2f\n", locked ? "mutex" : "seqlock",
+                   readers[n], total / 0.5 / 1e6, w.ops / 0.5 / 1e6);
+        }
+    }
+
+    sr_arpcache_destroy(&cache);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_queue(..)
+ * Scope: Local
+ *
+ * An ARP storm: frames queued behind 16 unresolved next hops, then the
+ * requests are torn down as the sweeper does when they resolve or give
+ * up.  Reports the cost per queued and released frame, with the queue
+ * caps out of the way.  Then a blackholed next hop is fed a million
+ * frames under the default caps with either drop policy.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_QUEUE_HOPS   16
+#define BENCH_QUEUE_DEPTH  64
+#define BENCH_QUEUE_ROUNDS 20000
+
+static int bench_queue(void)
+{
+    static const unsigned int sizes[] = { 98, 1514 };
+    struct sr_arpcache cache;
+    struct sr_arpreq*  req;
+    uint8_t            frame[1514];
+    unsigned int       s, r, i;
+    double             t0, t;
+
+    memset(frame, 0xab, sizeof(frame));
+    sr_arpcache_init(&cache, 0);
+    sr_arpcache_set_queue_limits(&cache, ~0u, ~0u, arpq_drop_tail);
+
+    printf("%8s %14s\n", "bytes", "ns/frame");
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        t0 = bench_now();
+        for(r = 0; r < BENCH_QUEUE_ROUNDS; r++)
+        {
+            for(i = 0; i < BENCH_QUEUE_HOPS * BENCH_QUEUE_DEPTH; i++)
+            {
+                sr_arpcache_queuereq(&cache, i % BENCH_QUEUE_HOPS + 1,
+                                     frame, sizes[s], 0);
+            }
+            while((req = cache.requests) != 0)
+            { sr_arpreq_destroy(&cache, req); }
+        }
+        t = bench_now() - t0;
+        printf("%8u %14.1f\n", sizes[s],
+               t / ((double)BENCH_QUEUE_ROUNDS * BENCH_QUEUE_HOPS * BENCH_QUEUE_DEPTH));
+    }
+
+    printf("\n%8s %10s %10s %12s %10s\n", "policy", "queued", "dropped",
+           "held bytes", "ns/frame");
+    for(s = 0; s < 2; s++)
+    {
+        sr_arpcache_set_queue_limits(&cache, 0, 0,
+                                     s ? arpq_drop_oldest : arpq_drop_tail);
+        cache.queued = cache.dropped = 0;
+        t0 = bench_now();
+        for(i = 0; i < 1000000; i++)
+        { sr_arpcache_queuereq(&cache, 1, frame, sizeof(frame), 0); }
+        t = bench_now() - t0;
+        printf("%8s %10lu %10lu %12u %10.1f\n", s ? "oldest" : "tail",
+               cache.queued, cache.dropped, cache.requests->qbytes, t / 1e6);
+        sr_arpreq_destroy(&cache, cache.requests);
+    }
+
+    printf("\n");
+    sr_arpcache_dump_pools(&cache, stdout);
+    sr_arpcache_destroy(&cache);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_cksum(..)
+ * Scope: Local
+ *
+ * What forwarding does to each IP header: verify it, decrement the TTL
+ * and fix the checksum.  "full" is the old way, zeroing the checksum to
+ * verify and recomputing it after the TTL change; "incr" verifies in
+ * place and patches the checksum with cksum_update16().  Both must leave
+ * identical headers.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_CKSUM_HDRS 4096
+#define BENCH_CKSUM_OPS  20000000
+
+static int bench_cksum(void)
+{
+    sr_ip_hdr_t* hdrs = malloc(BENCH_CKSUM_HDRS * sizeof(sr_ip_hdr_t));
+    sr_ip_hdr_t  a, b;
+    uint16_t     old, sum;
+    unsigned int i, bad = 0;
+    uintptr_t    sink = 0;
+    double       t0, t_full, t_incr, u_full, u_incr;
+
+    for(i = 0; i < BENCH_CKSUM_HDRS; i++)
+    {
+        uint32_t* w = (uint32_t*)&hdrs[i];
+        w[0] = bench_rand(); w[1] = bench_rand(); w[2] = bench_rand();
+        w[3] = bench_rand(); w[4] = bench_rand();
+        hdrs[i].ip_v   = 4;
+        hdrs[i].ip_hl  = 5;
+        hdrs[i].ip_ttl |= 2;
+        hdrs[i].ip_sum = 0;
+        hdrs[i].ip_sum = cksum(&hdrs[i], sizeof(sr_ip_hdr_t));
+    }
+
+    /* cross check on every header and every TTL */
+    for(i = 0; i < BENCH_CKSUM_HDRS * 256; i++)
+    {
+        a = hdrs[i % BENCH_CKSUM_HDRS];
+        a.ip_ttl = i / BENCH_CKSUM_HDRS;
+        a.ip_sum = 0;
+        a.ip_sum = cksum(&a, sizeof(a));
+        b = a;
+
+        a.ip_ttl -= 2;
+        a.ip_sum = 0;
+        a.ip_sum = cksum(&a, sizeof(a));
+
+        old = htons(b.ip_ttl << 8 | b.ip_p);
+        b.ip_ttl -= 2;
+        b.ip_sum = cksum_update16(b.ip_sum, old, htons(b.ip_ttl << 8 | b.ip_p));
+        if(memcmp(&a, &b, sizeof(a)) != 0 || !cksum_ok(&b, sizeof(b)))
+        { bad++; }
+    }
+
+    t0 = bench_now();
+    for(i = 0; i < BENCH_CKSUM_OPS; i++)
+    {
+        sr_ip_hdr_t* h = &hdrs[i % BENCH_CKSUM_HDRS];
+        sum = h->ip_sum;
+        h->ip_sum = 0;
+        if(cksum(h, sizeof(sr_ip_hdr_t)) != sum)
+        { bad++; }
+        h->ip_ttl--;
+        h->ip_sum = 0;
+        h->ip_sum = cksum(h, h->ip_hl * 4);
+        sink += h->ip_sum;
+    }
+    t_full = (bench_now() - t0) / BENCH_CKSUM_OPS;
+
+    t0 = bench_now();
+    for(i = 0; i < BENCH_CKSUM_OPS; i++)
+    {
+        sr_ip_hdr_t* h = &hdrs[i % BENCH_CKSUM_HDRS];
+        if(!cksum_ok(h, h->ip_hl * 4))
+        { bad++; }
+        old = htons(h->ip_ttl << 8 | h->ip_p);
+        h->ip_ttl--;
+        h->ip_sum = cksum_update16(h->ip_sum, old, htons(h->ip_ttl << 8 | h->ip_p));
+        sink += h->ip_sum;
+    }
+    t_incr = (bench_now() - t0) / BENCH_CKSUM_OPS;
+
+    /* the TTL rewrite alone */
+    t0 = bench_now();
+    for(i = 0; i < BENCH_CKSUM_OPS; i++)
+    {
+        sr_ip_hdr_t* h = &hdrs[i % BENCH_CKSUM_HDRS];
+        h->ip_ttl--;
+        h->ip_sum = 0;
+        h->ip_sum = cksum(h, h->ip_hl * 4);
+        sink += h->ip_sum;
+    }
+    u_full = (bench_now() - t0) / BENCH_CKSUM_OPS;
+
+    t0 = bench_now();
+    for(i = 0; i < BENCH_CKSUM_OPS; i++)
+    {
+        sr_ip_hdr_t* h = &hdrs[i % BENCH_CKSUM_HDRS];
+        old = htons(h->ip_ttl << 8 | h->ip_p);
+        h->ip_ttl--;
+        h->ip_sum = cksum_update16(h->ip_sum, old, htons(h->ip_ttl << 8 | h->ip_p));
+        sink += h->ip_sum;
+    }
+    u_incr = (bench_now() - t0) / BENCH_CKSUM_OPS;
+
+    printf("%8s %16s %16s\n", "", "verify+update ns", "update ns");
+    printf("%8s %16.2f %16.2f\n", "full", t_full, u_full);
+    printf("%8s %16.2f %16.2f\n", "incr", t_incr, u_incr);
+
+    free(hdrs);
+    bench_sink = sink;
+    if(bad)
+    {
+        fprintf(stderr, "cksum: %u headers differ from a full recompute\n", bad);
+        return 1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_sum(..)
+ * Scope: Local
+ *
+ * The checksum kernels against the old 16 bit at a time loop, which is
+ * kept here as the reference.  Every variant is first checked against it
+ * for all lengths up to 1600 bytes at every alignment, summed whole and
+ * in two pieces, then timed over an IP header, a minimum reassembly
+ * buffer and a full Ethernet payload.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_SUM_BUF   (64 * 1024)
+#define BENCH_SUM_BYTES 2000000000.0 /* per size and variant */
+
+static uint16_t bench_sum_ref(const void* _data, int len)
+{
+    const uint8_t* data = _data;
+    uint32_t       sum;
+
+    for(sum = 0; len >= 2; data += 2, len -= 2)
+    { sum += data[0] << 8 | data[1]; }
+    if(len > 0)
+    { sum += data[0] << 8; }
+    while(sum > 0xffff)
+    { sum = (sum >> 16) + (sum & 0xffff); }
+    sum = htons(~sum);
+    return sum ? sum : 0xffff;
+}
+
+static int bench_sum(void)
+{
+    static const char* impls[] = { "ref", "word64", "sse2", "avx2" };
+    static const int   sizes[] = { 20, 576, 1500 };
+    static const int   bases[] = { 0, 4096 - 800, 4096, 8192 };
+    char         label[32];
+    uint8_t*     buf = malloc(BENCH_SUM_BUF);
+    unsigned int i, j, n, off, len, bad = 0;
+    unsigned int nimpl = sizeof(impls) / sizeof(impls[0]);
+    unsigned int nsize = sizeof(sizes) / sizeof(sizes[0]);
+    uint16_t     half;
+    uintptr_t    sink = 0;
+    double       t0, ns;
+
+    for(i = 0; i < BENCH_SUM_BUF; i += 4)
+    {
+        uint32_t r = bench_rand();
+        memcpy(buf + i, &r, 4);
+    }
+    /* -- runs of 0x00 and 0xff to shake out carry and 0 / 0xffff cases -- */
+    memset(buf + 4096, 0xff, 2048);
+    memset(buf + 8192, 0x00, 2048);
+
+    for(j = 1; j < nimpl; j++)
+    {
+        if(!inet_cksum_use(impls[j]))
+        { continue; }
+        for(off = 0; off < 8; off++)
+        {
+            for(len = 0; len <= 1600; len++)
+            {
+                unsigned int split = len / 2 & ~1u;
+                for(i = 0; i < sizeof(bases) / sizeof(bases[0]); i++)
+                {
+                    uint8_t* p = buf + bases[i] + off;
+                    if(cksum(p, len) != bench_sum_ref(p, len))
+                    { bad++; }
+                    half = inet_cksum_add(0, p, split);
+                    half = inet_cksum_add(half, p + split, len - split);
+                    if(inet_cksum_finish(half) != bench_sum_ref(p, len))
+                    { bad++; }
+                }
+            }
+        }
+    }
+
+    printf("%8s", "");
+    for(i = 0; i < nsize; i++)
+    {
+        sprintf(label, "%d B: ns  GB/s", sizes[i]);
+        printf(" %18s", label);
+    }
+    printf("\n");
+
+    for(j = 0; j < nimpl; j++)
+    {
+        if(j > 0 && !inet_cksum_use(impls[j]))
+        {
+            printf("%8s %s\n", impls[j], "not supported");
+            continue;
+        }
+        printf("%8s", impls[j]);
+        for(i = 0; i < nsize; i++)
+        {
+            /* -- walk the buffer so sizes that fit in L1 stay there -- */
+            n  = (unsigned int)(BENCH_SUM_BYTES / sizes[i]);
+            t0 = bench_now();
+            for(len = 0, off = 0; len < n; len++)
+            {
+                if(j == 0)
+                { sink += bench_sum_ref(buf + off, sizes[i]); }
+                else
+                { sink += cksum(buf + off, sizes[i]); }
+                off = (off + sizes[i] + 64) & 16383;
+            }
+            ns = (bench_now() - t0) / n;
+            printf(" %10.1f %7.2f", ns, sizes[i] / ns);
+        }
+        printf("\n");
+    }
+    printf("(default: %s)\n", inet_cksum_use(0));
+
+    free(buf);
+    bench_sink = sink;
+    if(bad)
+    {
+        fprintf(stderr, "sum: %u checksums differ from the reference loop\n", bad);
+        return 1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_router_setup(..)
+ * Scope: Local
+ *
+ * A three interface router with resolved next hops:
+ *
+ *   eth1 10.0.1.1  10.0.1.0/24 via 10.0.1.100
+ *   eth2 10.0.2.1  10.0.2.0/24 via 10.0.2.100
+ *   eth3 10.0.3.1  default     via 10.0.3.100
+ *
+ *---------------------------------------------------------------------*/
+
+static const char* bench_ifname[] = { "eth1", "eth2", "eth3" };
+
+static void bench_router_arp(struct sr_instance* sr)
+{
+    unsigned char mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0xaa, 0 };
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        mac[5] = i + 1;
+        sr_arpcache_put(&sr->cache, mac, htonl(0x0a000064 | ((i + 1) << 8)));
+    }
+}
+
+static void bench_router_setup(struct sr_instance* sr)
+{
+    unsigned char  mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0, 0 };
+    struct in_addr dest, gw, mask;
+    int i;
+
+    memset(sr, 0, sizeof(struct sr_instance));
+    sr->sockfd = -1;
+
+    for(i = 0; i < 3; i++)
+    {
+        sr_add_interface(sr, bench_ifname[i]);
+        mac[5] = i + 1;
+        sr_set_ether_addr(sr, mac);
+        sr_set_ether_ip(sr, htonl(0x0a000001 | ((i + 1) << 8)));
+
+        dest.s_addr = (i == 2) ? 0 : htonl(0x0a000000 | ((i + 1) << 8));
+        mask.s_addr = (i == 2) ? 0 : htonl(0xffffff00);
+        gw.s_addr   = htonl(0x0a000064 | ((i + 1) << 8));
+        sr_add_rt_entry(sr, dest, gw, mask, (char*)bench_ifname[i]);
+    }
+    sr_rt_build_fib(sr);
+
+    sr_init(sr);
+    bench_router_arp(sr);
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_make_udp(..)
+ * Scope: Local
+ *
+ * Write a UDP datagram addressed to eth1's MAC into frame, returns the
+ * frame length.  Addresses are host order.
+ *
+ *---------------------------------------------------------------------*/
+
+static unsigned int bench_make_udp(uint8_t* frame, uint32_t src, uint32_t dst,
+                                   unsigned int payload)
+{
+    sr_ethernet_hdr_t* eth = (sr_ethernet_hdr_t*)frame;
+    sr_ip_hdr_t*       ip  = (sr_ip_hdr_t*)(frame + sizeof(sr_ethernet_hdr_t));
+    unsigned int       len = sizeof(sr_ip_hdr_t) + 8 + payload;
+
+    memset(frame, 0, sizeof(sr_ethernet_hdr_t) + len);
+    eth->ether_dhost[0] = 2;
+    eth->ether_dhost[5] = 1;
+    eth->ether_shost[0] = 2;
+    eth->ether_shost[4] = 0xbb;
+    eth->ether_type = htons(ethertype_ip);
+
+    ip->ip_v   = 4;
+    ip->ip_hl  = 5;
+    ip->ip_len = htons(len);
+    ip->ip_ttl = 64;
+    ip->ip_p   = ip_protocol_udp;
+    ip->ip_src = htonl(src);
+    ip->ip_dst = htonl(dst);
+    ip->ip_sum = cksum(ip, sizeof(sr_ip_hdr_t));
+
+    return sizeof(sr_ethernet_hdr_t) + len;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_pipeline(..)
+ * Scope: Local
+ *
+ * Drive the real read loop over a socketpair standing in for the VNS
+ * server: one thread writes VNSPACKET commands for 256 flows from eth1
+ * towards 10.2.0.0/16 (default route), another reads back what the router
+ * sends, and the main thread runs sr_read_from_server() with 0 (inline)
+ * to 8 workers.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_PIPE_FLOWS   256
+#define BENCH_PIPE_PACKETS 200000
+
+struct bench_pipe_io
+{
+    int           fd;
+    uint8_t*      chunk;
+    unsigned int  chunk_len;
+    unsigned long count;
+};
+
+static void* bench_pipe_writer(void* arg)
+{
+    struct bench_pipe_io* io = arg;
+    c_close       bye;
+    unsigned long i;
+
+    for(i = 0; i < BENCH_PIPE_PACKETS / BENCH_PIPE_FLOWS; i++)
+    {
+        if(write(io->fd, io->chunk, io->chunk_len) != io->chunk_len)
+        { break; }
+    }
+
+    memset(&bye, 0, sizeof(bye));
+    bye.mLen  = htonl(sizeof(bye));
+    bye.mType = htonl(VNSCLOSE);
+    if(write(io->fd, &bye, sizeof(bye)) != sizeof(bye))
+    { perror("write"); }
+    return 0;
+}
+
+static void* bench_pipe_reader(void* arg)
+{
+    struct bench_pipe_io* io = arg;
+    static uint8_t buf[1 << 16];
+    unsigned int have = 0, off, clen;
+    ssize_t      n;
+
+    while(io->count < (BENCH_PIPE_PACKETS / BENCH_PIPE_FLOWS) * BENCH_PIPE_FLOWS)
+    {
+        if((n = read(io->fd, buf + have, sizeof(buf) - have)) <= 0)
+        { break; }
+        have += n;
+        for(off = 0; have - off >= 4; off += clen, io->count++)
+        {
+            clen = ntohl(*(uint32_t*)(buf + off));
+            if(have - off < clen)
+            { break; }
+        }
+        memmove(buf, buf + off, have - off);
+        have -= off;
+    }
+    return 0;
+}
+
+/* -- one command per flow, repeated by the writer -- */
+static void bench_pipe_chunk(struct bench_pipe_io* in)
+{
+    uint8_t*     p;
+    unsigned int flen;
+    int          i;
+
+    in->chunk = malloc(BENCH_PIPE_FLOWS * (sizeof(c_packet_header) + 1514));
+    for(p = in->chunk, i = 0; i < BENCH_PIPE_FLOWS; i++)
+    {
+        c_packet_header* hdr = (c_packet_header*)p;
+        flen = bench_make_udp(p + sizeof(c_packet_header),
+                              0x0a000100 | (i % 200 + 2), 0x0a020000 | i, 64);
+        hdr->mLen  = htonl(sizeof(c_packet_header) + flen);
+        hdr->mType = htonl(VNSPACKET);
+        memset(hdr->mInterfaceName, 0, sizeof(hdr->mInterfaceName));
+        strcpy(hdr->mInterfaceName, "eth1");
+        p += sizeof(c_packet_header) + flen;
+    }
+    in->chunk_len = p - in->chunk;
+}
+
+/* -- push the whole run through the router, nanoseconds taken or < 0 -- */
+static double bench_pipe_run(struct sr_instance* sr, struct bench_pipe_io* in,
+                             struct bench_pipe_io* out, int workers)
+{
+    pthread_t wt, rt;
+    int       sv[2];
+    double    t0, t;
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+    {
+        perror("socketpair");
+        return -1;
+    }
+    sr->sockfd = sv[0];
+    in->fd     = sv[1];
+    out->fd    = sv[1];
+    out->count = 0;
+    bench_router_arp(sr);
+
+    if(workers && sr_pipeline_start(sr, workers) != 0)
+    { return -1; }
+
+    t0 = bench_now();
+    pthread_create(&rt, 0, bench_pipe_reader, out);
+    pthread_create(&wt, 0, bench_pipe_writer, in);
+    sr_qsbr_register(&sr->qsbr);
+    while(sr_read_from_server(sr) == 1)
+    { sr_qsbr_quiescent(); }
+    sr_qsbr_unregister();
+    sr_pipeline_stop(sr);
+    pthread_join(wt, 0);
+    pthread_join(rt, 0);
+    t = bench_now() - t0;
+
+    close(sv[0]);
+    close(sv[1]);
+    return t;
+}
+
+static int bench_pipeline(void)
+{
+    static const int workers[] = { 0, 1, 2, 4, 8 };
+    struct sr_instance   sr;
+    struct bench_pipe_io in, out;
+    int                  n;
+    double               t;
+    unsigned long        allocs;
+
+    bench_router_setup(&sr);
+    if(!freopen("/dev/null", "w", stdout))
+    { return 1; }
+    bench_pipe_chunk(&in);
+
+    fprintf(stderr, "%8s %12s %12s %12s %12s\n", "workers", "kpkts/s",
+            "allocs/pkt", "copies/pkt", "syscalls/pkt");
+    for(n = 0; n < (int)(sizeof(workers) / sizeof(workers[0])); n++)
+    {
+        memset(&sr.stats, 0, sizeof(sr.stats));
+        allocs = sr_pkt_heap_allocs(&sr);
+
+        if((t = bench_pipe_run(&sr, &in, &out, workers[n])) < 0)
+        { return 1; }
+
+        fprintf(stderr, "%8d %12.1f %12.4f %12.4f %12.4f   (%lu forwarded)\n",
+                workers[n], out.count / t * 1e6,
+                (double)(sr_pkt_heap_allocs(&sr) - allocs) / sr.stats.rx,
+                (double)sr.stats.copies / sr.stats.rx,
+                (double)(sr.stats.rx_calls + sr.stats.tx_calls) / sr.stats.rx,
+                out.count);
+    }
+
+    free(in.chunk);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_log(..)
+ * Scope: Local
+ *
+ * The pipeline run (inline, no workers) at each run time log level.
+ * stdout goes to /dev/null but is line buffered, as it is on a terminal,
+ * so "debug" costs what the old unconditional printf()s did.  Levels
+ * above SR_LOG_BUILD are not compiled in; rebuild with e.g.
+ * -DSR_LOG_BUILD=1 to see the sites disappear altogether.
+ *
+ *---------------------------------------------------------------------*/
+
+static int bench_log(void)
+{
+    static const int   levels[] = { SR_LOG_DEBUG, SR_LOG_INFO, SR_LOG_ERR };
+    static const char* names[]  = { "debug", "info", "err" };
+    struct sr_instance   sr;
+    struct bench_pipe_io in, out;
+    int                  n;
+    double               t;
+
+    bench_router_setup(&sr);
+    if(!freopen("/dev/null", "w", stdout))
+    { return 1; }
+    setvbuf(stdout, 0, _IOLBF, 0);
+    bench_pipe_chunk(&in);
+
+    fprintf(stderr, "SR_LOG_BUILD %d\n", SR_LOG_BUILD);
+    fprintf(stderr, "%8s %12s\n", "level", "kpkts/s");
+    for(n = 0; n < (int)(sizeof(levels) / sizeof(levels[0])); n++)
+    {
+        sr_log_level = levels[n];
+        if((t = bench_pipe_run(&sr, &in, &out, 0)) < 0)
+        { return 1; }
+        fprintf(stderr, "%8s %12.1f%s\n", names[n], out.count / t * 1e6,
+                levels[n] > SR_LOG_BUILD ? "   (not compiled in)" : "");
+    }
+
+    free(in.chunk);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_pcap(..)
+ * Scope: Local
+ *
+ * The pipeline run (inline, no workers) without capture, then capturing
+ * every frame in both directions to a file, as -l does.  Frames the
+ * writer could not keep up with show as overflows.
+ *
+ *---------------------------------------------------------------------*/
+
+static int bench_pcap(void)
+{
+    static const unsigned int     snaplens[] = { 0, 64, 1024, 64, 1024 };
+    static const enum sr_pcap_fmt fmts[]     = { sr_pcap_classic, sr_pcap_classic,
+                                                 sr_pcap_classic, sr_pcap_ng,
+                                                 sr_pcap_ng };
+    struct sr_instance   sr;
+    struct bench_pipe_io in, out;
+    char                 path[64];
+    unsigned long        captured, overflows;
+    int                  n;
+    double               t;
+
+    bench_router_setup(&sr);
+    if(!freopen("/dev/null", "w", stdout))
+    { return 1; }
+    bench_pipe_chunk(&in);
+    sprintf(path, "/tmp/sr_bench.%d.pcap", (int)getpid());
+
+    fprintf(stderr, "%8s %8s %12s %12s %12s\n", "format", "snaplen",
+            "kpkts/s", "captured", "overflowed");
+    for(n = 0; n < (int)(sizeof(snaplens) / sizeof(snaplens[0])); n++)
+    {
+        sr.pcap = snaplens[n] ? sr_pcap_open(path, fmts[n], snaplens[n], 0) : 0;
+        if(snaplens[n] && !sr.pcap)
+        { return 1; }
+
+        if((t = bench_pipe_run(&sr, &in, &out, 0)) < 0)
+        { return 1; }
+
+        captured = overflows = 0;
+        if(sr.pcap)
+        {
+            captured  = sr.pcap->captured;
+            overflows = sr.pcap->overflows;
+            sr_pcap_close(sr.pcap);
+            sr.pcap = 0;
+        }
+        fprintf(stderr, "%8s %8u %12.1f %12lu %12lu\n",
+                fmts[n] == sr_pcap_ng ? "pcapng" : "pcap", snaplens[n],
+                out.count / t * 1e6, captured, overflows);
+    }
+
+    unlink(path);
+    free(in.chunk);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_reload(..)
+ * Scope: Local
+ *
+ * The pipeline run, inline and with 2 workers, first on its own and then
+ * while another thread reloads a 100k route table from a file over and
+ * over with sr_load_rt(), as the rtable watcher does.  Every frame has to
+ * come out either way: all the extra routes point where the default
+ * route does.  Last, a table with a route through an interface the
+ * router does not have must be refused, keeping the current one.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_RELOAD_ROUTES 100000
+#define BENCH_RELOAD_ROUNDS 10
+
+struct bench_reloader
+{
+    struct sr_instance* sr;
+    char                path[64];
+    int                 stop;
+    unsigned long       reloads;
+    unsigned long       failed;
+    double              ns;
+};
+
+static void* bench_reloader_main(void* arg)
+{
+    struct bench_reloader* r = arg;
+    double                 t0;
+
+    while(!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE))
+    {
+        t0 = bench_now();
+        if(sr_load_rt(r->sr, r->path) != 0)
+        { r->failed++; }
+        r->ns += bench_now() - t0;
+        r->reloads++;
+    }
+    return 0;
+}
+
+/* -- bench_router_setup()'s routes plus n random prefixes via eth3 -- */
+static int bench_write_rtable(const char* path, unsigned int n)
+{
+    FILE*          fp;
+    struct in_addr a;
+    unsigned int   i;
+    uint32_t       len, mask;
+
+    if((fp = fopen(path, "w")) == 0)
+    {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "10.0.1.0 10.0.1.100 255.255.255.0 eth1\n");
+    fprintf(fp, "10.0.2.0 10.0.2.100 255.255.255.0 eth2\n");
+    for(i = 0; i < n; i++)
+    {
+        len  = 8 + bench_rand() % 25;
+        mask = 0xffffffffu << (32 - len);
+        a.s_addr = htonl(bench_rand() & mask);
+        fprintf(fp, "%s 10.0.3.100 ", inet_ntoa(a));
+        a.s_addr = htonl(mask);
+        fprintf(fp, "%s eth3\n", inet_ntoa(a));
+    }
+    fprintf(fp, "0.0.0.0 10.0.3.100 0.0.0.0 eth3\n");
+    fclose(fp);
+    return 0;
+}
+
+static int bench_reload(void)
+{
+    static const int      workers[] = { 0, 2 };
+    struct sr_instance    sr;
+    struct bench_pipe_io  in, out;
+    struct bench_reloader r;
+    pthread_t             thread;
+    unsigned long         forwarded, expected, lost = 0;
+    struct sr_rt*         rt;
+    FILE*                 fp;
+    int                   n, reloading, i, bad;
+    double                t, dt;
+
+    bench_router_setup(&sr);
+    if(!freopen("/dev/null", "w", stdout))
+    { return 1; }
+    bench_pipe_chunk(&in);
+
+    memset(&r, 0, sizeof(r));
+    r.sr = &sr;
+    sprintf(r.path, "/tmp/sr_bench.%d.rtable", (int)getpid());
+    if(bench_write_rtable(r.path, BENCH_RELOAD_ROUTES) != 0)
+    { return 1; }
+
+    expected = (unsigned long)BENCH_RELOAD_ROUNDS *
+               (BENCH_PIPE_PACKETS / BENCH_PIPE_FLOWS) * BENCH_PIPE_FLOWS;
+    fprintf(stderr, "%8s %10s %12s %12s %10s %12s\n", "workers", "reloading",
+            "kpkts/s", "forwarded", "reloads", "ms/reload");
+    for(n = 0; n < (int)(sizeof(workers) / sizeof(workers[0])); n++)
+    {
+        for(reloading = 0; reloading < 2; reloading++)
+        {
+            r.stop    = 0;
+            r.reloads = r.failed = 0;
+            r.ns      = 0;
+            if(reloading)
+            { pthread_create(&thread, 0, bench_reloader_main, &r); }
+
+            for(i = 0, t = 0, forwarded = 0; i < BENCH_RELOAD_ROUNDS; i++)
+            {
+                if((dt = bench_pipe_run(&sr, &in, &out, workers[n])) < 0)
+                { return 1; }
+                t += dt;
+                forwarded += out.count;
+            }
+
+            if(reloading)
+            {
+                __atomic_store_n(&r.stop, 1, __ATOMIC_RELEASE);
+                pthread_join(thread, 0);
+            }
+            lost += expected - forwarded + r.failed;
+
+            fprintf(stderr, "%8d %10s %12.1f %12lu %10lu %12.1f\n", workers[n],
+                    reloading ? "yes" : "no", forwarded / t * 1e6, forwarded,
+                    r.reloads, r.reloads ? r.ns / r.reloads / 1e6 : 0.0);
+        }
+    }
+
+    /* -- eth9 does not exist -- */
+    rt = sr.routing_table;
+    if((fp = fopen(r.path, "a")) == 0)
+    { return 1; }
+    fprintf(fp, "10.9.0.0 10.0.3.100 255.255.0.0 eth9\n");
+    fclose(fp);
+    bad = sr_load_rt(&sr, r.path) == 0 || sr.routing_table != rt;
+    fprintf(stderr, "\ntable routing through a missing interface: %s\n",
+            bad ? "LOADED" : "refused, current table kept");
+
+    unlink(r.path);
+    free(in.chunk);
+    if(lost)
+    { fprintf(stderr, "%lu frames lost or reloads failed\n", lost); }
+    return lost || bad ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_rtload(..)
+ * Scope: Local
+ *
+ * Time sr_load_rt() on 1k, 100k and 1M route tables written as text and
+ * as a binary table, against the load it replaced: fgets, sscanf,
+ * inet_aton and a malloc per route (here with a tail pointer rather than
+ * walking the list for every route), then the FIB.  Every load includes
+ * building the FIB, whose time is also shown on its own.  The loaded
+ * tables are cross checked against what was written.
+ *
+ *---------------------------------------------------------------------*/
+
+/* -- the old loader's parse, for comparison -- */
+static struct sr_rt* bench_rtload_stdio(const char* path)
+{
+    FILE*         fp;
+    char          line[BUFSIZ], dest[32], gw[32], mask[32], iface[32];
+    struct sr_rt* head = 0;
+    struct sr_rt* last = 0;
+    struct sr_rt* rt;
+
+    if((fp = fopen(path, "r")) == 0)
+    { return 0; }
+    while(fgets(line, BUFSIZ, fp) != 0)
+    {
+        if(sscanf(line, "%31s %31s %31s %31s", dest, gw, mask, iface) != 4)
+        { continue; }
+        rt = calloc(1, sizeof(struct sr_rt));
+        inet_aton(dest, &rt->dest);
+        inet_aton(gw, &rt->gw);
+        inet_aton(mask, &rt->mask);
+        strncpy(rt->interface, iface, sr_IFACE_NAMELEN);
+        if(last)
+        { last = last->next = rt; }
+        else
+        { head = last = rt; }
+    }
+    fclose(fp);
+    return head;
+}
+
+/* -- routes as the text file sr_load_rt() reads -- */
+static int bench_rtload_text(const char* path, struct sr_rt* routes)
+{
+    FILE* fp;
+
+    if((fp = fopen(path, "w")) == 0)
+    {
+        perror(path);
+        return -1;
+    }
+    for(; routes; routes = routes->next)
+    {
+        fprintf(fp, "%s ", inet_ntoa(routes->dest));
+        fprintf(fp, "%s ", inet_ntoa(routes->gw));
+        fprintf(fp, "%s %s\n", inet_ntoa(routes->mask), routes->interface);
+    }
+    return fclose(fp);
+}
+
+/* -- number of entries in a and b that differ, or that one lacks -- */
+static unsigned int bench_rtload_diff(struct sr_rt* a, struct sr_rt* b)
+{
+    unsigned int bad = 0;
+
+    for(; a && b; a = a->next, b = b->next)
+    {
+        if(a->dest.s_addr != b->dest.s_addr || a->gw.s_addr != b->gw.s_addr ||
+           a->mask.s_addr != b->mask.s_addr ||
+           strncmp(a->interface, b->interface, sr_IFACE_NAMELEN) != 0)
+        { bad++; }
+    }
+    return bad + (a != 0) + (b != 0);
+}
+
+static int bench_rtload(void)
+{
+    static const unsigned int sizes[] = { 1000, 100000, 1000000 };
+    struct sr_instance sr;
+    struct sr_rt*      rt;
+    struct sr_rt*      old;
+    struct sr_rt*      next;
+    struct sr_fib*     fib;
+    struct stat        st_text, st_bin;
+    char               text[64], bin[64];
+    unsigned int       s, bad = 0;
+    double             t0, t_stdio, t_text, t_bin, t_fib;
+
+    bench_router_setup(&sr);
+    if(!freopen("/dev/null", "w", stdout))
+    { return 1; }
+    sprintf(text, "/tmp/sr_bench.%d.rtable", (int)getpid());
+    sprintf(bin, "/tmp/sr_bench.%d.rtable.bin", (int)getpid());
+
+    fprintf(stderr, "%10s %10s %10s %10s %10s %10s %10s\n", "routes",
+            "stdio ms", "text ms", "binary ms", "of it fib", "text MB", "binary MB");
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        rt = bench_make_routes(sizes[s]);
+        if(bench_rtload_text(text, rt) != 0 || sr_rt_save_bin(rt, bin) != 0 ||
+           stat(text, &st_text) != 0 || stat(bin, &st_bin) != 0)
+        { return 1; }
+
+        t0 = bench_now();
+        old = bench_rtload_stdio(text);
+        fib = sr_fib_build(old);
+        t_stdio = bench_now() - t0;
+        sr_fib_destroy(fib);
+        for(; old; old = next)
+        {
+            next = old->next;
+            free(old);
+        }
+
+        t0 = bench_now();
+        if(sr_load_rt(&sr, text) != 0)
+        { return 1; }
+        t_text = bench_now() - t0;
+        bad += bench_rtload_diff(rt, sr.routing_table);
+
+        t0 = bench_now();
+        if(sr_load_rt(&sr, bin) != 0)
+        { return 1; }
+        t_bin = bench_now() - t0;
+        bad += bench_rtload_diff(rt, sr.routing_table);
+
+        t0 = bench_now();
+        fib = sr_fib_build(rt);
+        t_fib = bench_now() - t0;
+        sr_fib_destroy(fib);
+
+        fprintf(stderr, "%10u %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                sizes[s], t_stdio / 1e6, t_text / 1e6, t_bin / 1e6,
+                t_fib / 1e6, st_text.st_size / 1e6, st_bin.st_size / 1e6);
+        free(rt);
+    }
+
+    unlink(text);
+    unlink(bin);
+    if(bad)
+    { fprintf(stderr, "rtload: %u routes differ from what was written\n", bad); }
+    return bad ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_timers(..)
+ * Scope: Local
+ *
+ * ARP timers.  First frames are queued behind next hops that never
+ * answer, with requests 1 to 100 ms apart, and the time until the ARP
+ * thread has given up on all of them is compared with the 5 intervals it
+ * should take.  Then the ARP cache is filled and one second's worth of
+ * timer work, running the wheel through a second with nothing due, is
+ * timed against the full table scan the ARP thread used to make every
+ * second.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_TIMER_HOPS 64
+
+static int bench_timers(void)
+{
+    static const unsigned int retries[] = { 1, 10, 100 };
+    static const unsigned int sizes[]   = { 1000, 100000, 1000000 };
+    struct sr_instance sr;
+    struct sr_arpcache cache;
+    uint8_t            frame[SR_PKT_HEADROOM + 128];
+    unsigned char      mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0, 0 };
+    unsigned int       len, r, s, i, n, bad = 0;
+    unsigned long      expired;
+    uint64_t           now;
+    double             t0, t, t_scan, t_wheel;
+
+    bench_router_setup(&sr);
+    if((sr.sockfd = open("/dev/null", O_WRONLY)) < 0)
+    { return 1; }
+    sr_log_level = SR_LOG_WARN;
+    len = bench_make_udp(frame + SR_PKT_HEADROOM, 0x0a000105, 0x0a000205, 64);
+
+    printf("%10s %10s %12s %10s\n", "retry ms", "next hops", "given up ms",
+           "expected");
+    for(r = 0; r < sizeof(retries) / sizeof(retries[0]); r++)
+    {
+        sr_arpcache_set_retry(&sr.cache, retries[r]);
+        expired = sr.cache.expired;
+        t0 = bench_now();
+        for(i = 0; i < BENCH_TIMER_HOPS; i++)
+        {
+            sr_arpcache_queuereq(&sr.cache, htonl(0x0a000200 + i), frame +
+                                 SR_PKT_HEADROOM, len, 0);
+        }
+        while(__atomic_load_n(&sr.cache.expired, __ATOMIC_RELAXED) <
+              expired + BENCH_TIMER_HOPS && bench_now() - t0 < 5e9)
+        { usleep(100); }
+        t = bench_now() - t0;
+        if(sr.cache.expired < expired + BENCH_TIMER_HOPS)
+        { bad++; }
+        printf("%10u %10u %12.1f %10u\n", retries[r], BENCH_TIMER_HOPS,
+               t / 1e6, SR_ARPREQ_TRIES * retries[r]);
+    }
+
+    printf("\n%10s %14s %14s\n", "entries", "scan us/s", "wheel us/s");
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        sr_arpcache_init(&cache, sizes[s]);
+        for(i = 0; i < sizes[s]; i++)
+        {
+            memcpy(mac + 2, &i, sizeof(i));
+            sr_arpcache_put(&cache, mac, htonl(0x0b000000 + i));
+        }
+
+        /* what every entry cost each second before the wheel */
+        t0 = bench_now();
+        for(i = 0, n = 0; i <= cache.mask; i++)
+        {
+            if(cache.entries[i].valid &&
+               difftime(time(NULL), cache.entries[i].added) > SR_ARPCACHE_TO)
+            { n++; }
+        }
+        t_scan = bench_now() - t0;
+
+        /* no entry is due for SR_ARPCACHE_TO, run the wheel one second */
+        pthread_mutex_lock(&cache.lock);
+        now = sr_timer_now();
+        if(sr_wheel_expire(&cache.wheel, now))
+        { n++; }
+        t0 = bench_now();
+        if(sr_wheel_expire(&cache.wheel, now + 1000))
+        { n++; }
+        t_wheel = bench_now() - t0;
+        pthread_mutex_unlock(&cache.lock);
+
+        bad += n;
+        printf("%10u %14.1f %14.1f\n", sizes[s], t_scan / 1e3, t_wheel / 1e3);
+        sr_arpcache_destroy(&cache);
+    }
+
+    if(bad)
+    { fprintf(stderr, "timers: %u runs wrong\n", bad); }
+    return bad ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_arpwait(..)
+ * Scope: Local
+ *
+ * First packet delay to a new neighbour.  A datagram is routed to a
+ * gateway the ARP cache does not know; a thread standing in for the VNS
+ * server answers the router's ARP request as soon as it reads it and
+ * times how long the datagram takes to come out.  The reply is either
+ * handled as received, which sends the queued frame straight away, or
+ * only put in the cache, as replies used to be, leaving the frame to the
+ * request's next retry.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_ARPWAIT_TRIES 4
+
+struct bench_arpwait
+{
+    struct sr_instance* sr;
+    int                 fd;
+    int                 handled;  /* reply goes through sr_handlepacket_if */
+    volatile int        seen;     /* the datagram came out */
+    unsigned long       out;      /* datagrams that came out */
+    uint32_t            deaf;     /* ignores unicast requests, 0 for none */
+    int                 dead;     /* deaf ignores broadcasts too */
+    unsigned long       bcast[2]; /* broadcast requests, for deaf at [1] */
+    unsigned long       polls[2]; /* unicast requests */
+    pthread_t           server;
+};
+
+/* -- answer ARP requests as a neighbour would, note forwarded datagrams -- */
+static void bench_arpwait_frame(struct bench_arpwait* aw, c_packet_header* hdr,
+                                uint8_t* frame)
+{
+    uint8_t          reply[SR_PKT_HEADROOM + sizeof(sr_ethernet_hdr_t) +
+                           sizeof(sr_arp_hdr_t)];
+    sr_ethernet_hdr_t* eth = (sr_ethernet_hdr_t*)(reply + SR_PKT_HEADROOM);
+    sr_arp_hdr_t*      req = (sr_arp_hdr_t*)(frame + sizeof(sr_ethernet_hdr_t));
+    sr_arp_hdr_t*      arp = (sr_arp_hdr_t*)(eth + 1);
+    struct sr_if*      iface = sr_get_interface(aw->sr, hdr->mInterfaceName);
+
+    if(ethertype(frame) == ethertype_ip)
+    {
+        aw->seen = 1;
+        aw->out++;
+        return;
+    }
+    if(ethertype(frame) != ethertype_arp || ntohs(req->ar_op) != arp_op_request)
+    { return; }
+    if(frame[0] & 1)
+    {
+        aw->bcast[req->ar_tip == aw->deaf]++;
+        if(req->ar_tip == aw->deaf && aw->dead)
+        { return; }
+    }
+    else
+    {
+        aw->polls[req->ar_tip == aw->deaf]++;
+        if(req->ar_tip == aw->deaf)
+        { return; }
+    }
+
+    memcpy(eth->ether_dhost, iface->addr, ETHER_ADDR_LEN);
+    memcpy(eth->ether_shost, iface->addr, ETHER_ADDR_LEN);
+    eth->ether_shost[4] = 0xcc;
+    eth->ether_type = htons(ethertype_arp);
+    arp->ar_hrd = htons(arp_hrd_ethernet);
+    arp->ar_pro = htons(ethertype_ip);
+    arp->ar_hln = ETHER_ADDR_LEN;
+    arp->ar_pln = 4;
+    arp->ar_op  = htons(arp_op_reply);
+    memcpy(arp->ar_sha, eth->ether_shost, ETHER_ADDR_LEN);
+    arp->ar_sip = req->ar_tip;
+    memcpy(arp->ar_tha, iface->addr, ETHER_ADDR_LEN);
+    arp->ar_tip = iface->ip;
+
+    if(aw->handled)
+    {
+        sr_handlepacket_if(aw->sr, reply + SR_PKT_HEADROOM,
+                           sizeof(reply) - SR_PKT_HEADROOM, iface->index);
+    }
+    else
+    { sr_arpcache_put(&aw->sr->cache, arp->ar_sha, arp->ar_sip); }
+}
+
+static void* bench_arpwait_server(void* arg)
+{
+    struct bench_arpwait* aw = arg;
+    static uint8_t buf[1 << 16];
+    unsigned int   have = 0, off, clen;
+    ssize_t        n;
+
+    while((n = read(aw->fd, buf + have, sizeof(buf) - have)) > 0)
+    {
+        have += n;
+        for(off = 0; have - off >= 4; off += clen)
+        {
+            clen = ntohl(*(uint32_t*)(buf + off));
+            if(have - off < clen)
+            { break; }
+            bench_arpwait_frame(aw, (c_packet_header*)(buf + off),
+                                buf + off + sizeof(c_packet_header));
+        }
+        memmove(buf, buf + off, have - off);
+        have -= off;
+    }
+    return 0;
+}
+
+/* -- bench_router_setup() plus routes 10.5.i.0/24 via 10.0.2.10+i for i
+ *    below nroutes, with the router's frames going to aw's server -- */
+static int bench_arpwait_start(struct sr_instance* sr, struct bench_arpwait* aw,
+                               unsigned int nroutes)
+{
+    struct in_addr dest, gw, mask;
+    unsigned int   i;
+    int            sv[2];
+
+    bench_router_setup(sr);
+    sr_log_level = SR_LOG_WARN;
+
+    mask.s_addr = htonl(0xffffff00);
+    for(i = 0; i < nroutes; i++)
+    {
+        dest.s_addr = htonl(0x0a050000 | (i << 8));
+        gw.s_addr   = htonl(0x0a00020a + i);
+        sr_add_rt_entry(sr, dest, gw, mask, (char*)bench_ifname[1]);
+    }
+    sr_rt_build_fib(sr);
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+    {
+        perror("socketpair");
+        return -1;
+    }
+    memset(aw, 0, sizeof(struct bench_arpwait));
+    sr->sockfd = sv[0];
+    aw->sr     = sr;
+    aw->fd     = sv[1];
+    pthread_create(&aw->server, 0, bench_arpwait_server, aw);
+    return 0;
+}
+
+static void bench_arpwait_stop(struct bench_arpwait* aw)
+{
+    shutdown(aw->sr->sockfd, SHUT_RDWR);
+    pthread_join(aw->server, 0);
+    close(aw->sr->sockfd);
+    close(aw->fd);
+}
+
+static int bench_arpwait(void)
+{
+    struct sr_instance   sr;
+    struct bench_arpwait aw;
+    uint8_t              frame[SR_PKT_HEADROOM + 128];
+    unsigned int         len, i;
+    int                  mode, bad = 0;
+    double               t0, t, sum, max;
+
+    /* -- a fresh gateway for every datagram -- */
+    if(bench_arpwait_start(&sr, &aw, 2 * BENCH_ARPWAIT_TRIES) != 0)
+    { return 1; }
+
+    printf("%10s %10s %10s %10s\n", "reply", "retry ms", "mean ms", "max ms");
+    for(mode = 0; mode < 2; mode++)
+    {
+        aw.handled = mode;
+        sum = max = 0;
+        for(i = mode * BENCH_ARPWAIT_TRIES; i < (mode + 1) * BENCH_ARPWAIT_TRIES;
+            i++)
+        {
+            len = bench_make_udp(frame + SR_PKT_HEADROOM, 0x0a000105,
+                                 0x0a050005 | (i << 8), 64);
+            aw.seen = 0;
+            t0 = bench_now();
+            sr_handlepacket_if(&sr, frame + SR_PKT_HEADROOM, len, 0);
+            while(!aw.seen && bench_now() - t0 < 5e9)
+            { usleep(10); }
+            t = bench_now() - t0;
+            if(!aw.seen)
+            { bad++; }
+            sum += t;
+            if(t > max)
+            { max = t; }
+        }
+        printf("%10s %10u %10.3f %10.3f\n", mode ? "handled" : "put only",
+               sr.cache.retry_ms, sum / BENCH_ARPWAIT_TRIES / 1e6, max / 1e6);
+    }
+
+    bench_arpwait_stop(&aw);
+    if(bad)
+    { fprintf(stderr, "arpwait: %d datagrams never came out\n", bad); }
+    return bad ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_refresh(..)
+ * Scope: Local
+ *
+ * Two flows, a datagram each every 5 ms for longer than an ARP entry
+ * lives, to gateways that answer ARP as bench_arpwait's server does.  One
+ * gateway answers the router's unicast polls, so its entry should be
+ * refreshed and its flow never wait on ARP again; the other ignores them,
+ * so its entry stays in service while polled and is then removed.
+ * Reports the broadcast requests (each a flow stalled behind ARP) and
+ * polls per gateway.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_REFRESH_GAP_US 5000
+
+static int bench_refresh(void)
+{
+    struct sr_instance   sr;
+    struct bench_arpwait aw;
+    uint8_t              frame[SR_PKT_HEADROOM + 128];
+    unsigned int         len, i;
+    unsigned long        sent = 0;
+    double               t0;
+
+    /* -- the second gateway is deaf -- */
+    if(bench_arpwait_start(&sr, &aw, 2) != 0)
+    { return 1; }
+    aw.handled = 1;
+    aw.deaf    = htonl(0x0a00020b);
+
+    t0 = bench_now();
+    while(bench_now() - t0 < (SR_ARPCACHE_TO + SR_ARPREQ_TRIES + 1) * 1e9)
+    {
+        for(i = 0; i < 2; i++, sent++)
+        {
+            len = bench_make_udp(frame + SR_PKT_HEADROOM, 0x0a000105,
+                                 0x0a050005 | (i << 8), 64);
+            sr_handlepacket_if(&sr, frame + SR_PKT_HEADROOM, len, 0);
+        }
+        usleep(BENCH_REFRESH_GAP_US);
+    }
+    usleep(100000);
+
+    printf("%10s %12s %12s\n", "gateway", "broadcasts", "polls");
+    printf("%10s %12lu %12lu\n", "answers", aw.bcast[0], aw.polls[0]);
+    printf("%10s %12lu %12lu\n", "deaf", aw.bcast[1], aw.polls[1]);
+    printf("\n%lu datagrams sent, %lu out, %lu queued behind ARP\n", sent,
+           aw.out, sr.cache.queued);
+    printf("ARP lookups %lu hit, %lu missed; %lu polls, %lu entries kept, "
+           "%lu removed unanswered\n", sr.cache.hits, sr.cache.misses,
+           sr.cache.refreshes, sr.cache.refreshed, sr.cache.refresh_failed);
+
+    bench_arpwait_stop(&aw);
+    if(aw.bcast[0] != 1 || aw.out != sent)
+    {
+        fprintf(stderr, "refresh: answering gateway resolved %lu times, "
+                "%lu datagrams lost\n", aw.bcast[0], sent - aw.out);
+        return 1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_deadhop(..)
+ * Scope: Local
+ *
+ * A datagram every millisecond for 3 s to a gateway that never answers
+ * ARP, with requests retried every 100 ms so a round of them takes half
+ * a second.  Without a negative entry (it lasts 1 ms) every round queues
+ * the datagrams that arrive during it; with one (1 s) only the first
+ * round does, later datagrams get a rate limited host unreachable until
+ * the entry expires and the next round starts.
+ *
+ * Then a second round of requests to a dead gateway gives up while its
+ * negative entry from the first round is also due, with the ARP thread
+ * held off so both come off the wheel in one batch.  The gateway must
+ * be down afterwards, from the second round.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_DEADHOP_GAP_US 1000
+#define BENCH_DEADHOP_SECS   3
+#define BENCH_DEADHOP_RETRY  100   /* ms, for the batch case */
+
+static int bench_deadhop(void)
+{
+    struct sr_instance   sr;
+    struct bench_arpwait aw;
+    uint8_t              frame[SR_PKT_HEADROOM + 128];
+    unsigned int         len, peak;
+    unsigned long        sent, queued, out, hits;
+    int                  mode;
+    double               t0;
+
+    /* -- a dead gateway for each run -- */
+    if(bench_arpwait_start(&sr, &aw, 2) != 0)
+    { return 1; }
+    sr_arpcache_set_retry(&sr.cache, 100);
+    aw.handled = 1;
+    aw.dead    = 1;
+
+    printf("%10s %8s %8s %10s %10s %10s %9s\n", "negative", "sent", "queued",
+           "peak bytes", "broadcasts", "unreach", "unqueued");
+    for(mode = 0; mode < 2; mode++)
+    {
+        sr_arpcache_set_negative(&sr.cache, mode ? 1000 : 1);
+        aw.deaf = htonl(0x0a00020a + mode);
+        aw.bcast[1] = 0;
+        aw.out = 0;
+        sent = peak = 0;
+        queued = sr.cache.queued;
+        hits = sr.cache.neg_hits;
+
+        t0 = bench_now();
+        while(bench_now() - t0 < BENCH_DEADHOP_SECS * 1e9)
+        {
+            len = bench_make_udp(frame + SR_PKT_HEADROOM, 0x0a000105,
+                                 0x0a050005 | (mode << 8), 64);
+            sr_handlepacket_if(&sr, frame + SR_PKT_HEADROOM, len, 0);
+            sent++;
+            if(sr.cache.qbytes > peak)
+            { peak = sr.cache.qbytes; }
+            usleep(BENCH_DEADHOP_GAP_US);
+        }
+        usleep(600000);    /* -- the last round gives up -- */
+        out = aw.out;
+
+        printf("%10s %8lu %8lu %10u %10lu %10lu %9lu\n",
+               mode ? "1000 ms" : "1 ms", sent, sr.cache.queued - queued,
+               peak, aw.bcast[1], out, sr.cache.neg_hits - hits);
+    }
+
+    /* -- the round gives up at 5 retries, the entry half a retry later -- */
+    aw.deaf = htonl(0x0a00020c);
+    sr_arpcache_set_retry(&sr.cache, BENCH_DEADHOP_RETRY);
+    sr_arpcache_set_negative(&sr.cache,
+                             SR_ARPREQ_TRIES * BENCH_DEADHOP_RETRY +
+                             BENCH_DEADHOP_RETRY / 2);
+    hits = sr.cache.neg_added;
+    sr_arpcache_queuereq(&sr.cache, aw.deaf, 0, 0, SR_IF_NONE);
+    t0 = bench_now();
+    while(__atomic_load_n(&sr.cache.neg_added, __ATOMIC_RELAXED) == hits &&
+          bench_now() - t0 < 5e9)
+    { usleep(100); }
+    sr_arpcache_queuereq(&sr.cache, aw.deaf, 0, 0, SR_IF_NONE);
+    usleep(SR_ARPREQ_TRIES * BENCH_DEADHOP_RETRY * 1000 -
+           BENCH_DEADHOP_RETRY * 500);
+    pthread_mutex_lock(&sr.cache.lock);
+    usleep(BENCH_DEADHOP_RETRY * 2500);
+    pthread_mutex_unlock(&sr.cache.lock);
+    usleep(BENCH_DEADHOP_RETRY * 1000);
+
+    mode = sr_arpcache_dead(&sr.cache, aw.deaf) != arpneg_none;
+    printf("\nround and negative entry expiring together: gateway %s, "
+           "%lu timers on the wheel\n", mode ? "down" : "NOT down",
+           sr.cache.wheel.count);
+
+    bench_arpwait_stop(&aw);
+    return mode ? 0 : 1;
+}
+
+/*---------------------------------------------------------------------
+ * Method: bench_burst(..)
+ * Scope: Local
+ *
+ * Forward the same frames one at a time through sr_handlepacket_if()
+ * and through sr_handlepacket_burst() 8, 32 and 64 at a time, the way
+ * sr_replay does, sending to /dev/null.  "flows" is 256 destinations
+ * that stay in the destination cache; "spread" draws destinations from
+ * 100k routes, so nearly every frame misses it and takes the FIB and the
+ * ARP cache.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_BURST_ROUTES  100000
+#define BENCH_BURST_FRAMES  4096     /* distinct frames, sent round robin */
+#define BENCH_BURST_PACKETS 2000000
+
+static int bench_burst(void)
+{
+    static const unsigned int sizes[] = { 1, 8, 32, 64 };
+    static const char*        names[] = { "flows", "spread" };
+    struct sr_instance    sr;
+    struct sr_burst_frame frames[SR_BURST_MAX];
+    struct sr_rt*         rt;
+    struct sr_rt*         tail;
+    uint8_t*              tmpl;
+    uint8_t*              work;
+    unsigned int          tlen[BENCH_BURST_FRAMES];
+    unsigned int          w, s, i, n, slot, stride = SR_PKT_HEADROOM + 128;
+    unsigned long         k, tx;
+    uint32_t              dst;
+    double                t0, t, base = 0;
+    int                   bad = 0;
+
+    bench_router_setup(&sr);
+    sr_log_level = SR_LOG_WARN;
+    if((sr.sockfd = open("/dev/null", O_WRONLY)) == -1)
+    {
+        perror("/dev/null");
+        return 1;
+    }
+
+    /* -- extra routes through the three ARP'd gateways -- */
+    rt = bench_make_routes(BENCH_BURST_ROUTES);
+    for(i = 0; i < BENCH_BURST_ROUTES; i++)
+    {
+        rt[i].gw.s_addr = htonl(0x0a000064 | ((i % 3 + 1) << 8));
+        rt[i].if_index  = i % 3;
+        strcpy(rt[i].interface, bench_ifname[i % 3]);
+    }
+    for(tail = sr.routing_table; tail->next; tail = tail->next)
+    { ; }
+    tail->next = rt;
+    sr_rt_build_fib(&sr);
+
+    tmpl = malloc(BENCH_BURST_FRAMES * 128);
+    work = malloc(SR_TXBATCH_IOV * stride);
+    sr_txbatch_use(&sr.vns_rx.tx);
+
+    printf("%8s %6s %12s %10s %10s\n", "dests", "burst", "kpkts/s",
+           "ns/pkt", "speedup");
+    for(w = 0; w < 2; w++)
+    {
+        for(i = 0; i < BENCH_BURST_FRAMES; i++)
+        {
+            if(w == 0)
+            { dst = 0x0a020000 | (i % 256); }
+            else
+            {
+                struct sr_rt* r = &rt[bench_rand() % BENCH_BURST_ROUTES];
+                dst = ntohl(r->dest.s_addr | (htonl(bench_rand()) &
+                                              ~r->mask.s_addr));
+            }
+            tlen[i] = bench_make_udp(tmpl + i * 128, 0x0a000105, dst, 32);
+        }
+
+        for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            tx = sr.stats.tx;
+            slot = 0;
+            t0 = bench_now();
+            for(k = 0; k < BENCH_BURST_PACKETS; k += n)
+            {
+                if(slot + sizes[s] > SR_TXBATCH_IOV)
+                {
+                    sr_txbatch_flush(&sr, &sr.vns_rx.tx);
+                    slot = 0;
+                }
+                for(n = 0; n < sizes[s]; n++)
+                {
+                    i = (k + n) % BENCH_BURST_FRAMES;
+                    frames[n].packet   = work + slot++ * stride + SR_PKT_HEADROOM;
+                    frames[n].len      = tlen[i];
+                    frames[n].if_index = 0;
+                    memcpy(frames[n].packet, tmpl + i * 128, tlen[i]);
+                }
+                if(sizes[s] == 1)
+                {
+                    sr.vns_rx.tx.frame = frames[0].packet;
+                    sr_handlepacket_if(&sr, frames[0].packet, frames[0].len, 0);
+                }
+                else
+                { sr_handlepacket_burst(&sr, frames, n); }
+            }
+            sr_txbatch_flush(&sr, &sr.vns_rx.tx);
+            t = (bench_now() - t0) / BENCH_BURST_PACKETS;
+            if(s == 0)
+            { base = t; }
+
+            printf("%8s %6u %12.1f %10.1f %9.2fx\n", names[w], sizes[s],
+                   1e6 / t, t, base / t);
+            if(sr.stats.tx - tx != BENCH_BURST_PACKETS)
+            {
+                fprintf(stderr, "burst: %lu of %d frames forwarded\n",
+                        sr.stats.tx - tx, BENCH_BURST_PACKETS);
+                bad = 1;
+            }
+        }
+    }
+    printf("dst cache %lu hits, %lu misses\n", sr.dst->hits, sr.dst->misses);
+
+    sr_txbatch_use(0);
+    free(work);
+    free(tmpl);
+    return bad;
+}
+
+static void usage(char* argv0)
+{
+    printf("Format: %s <benchmark>\n", argv0);
+    printf("   lpm       FIB vs routing list longest prefix match\n");
+    printf("   arp       ARP cache lookup under reader/writer contention\n");
+    printf("   queue     queueing packets behind unresolved next hops\n");
+    printf("   cksum     TTL rewrite, full checksum vs incremental update\n");
+    printf("   sum       checksum kernels over 20/576/1500 byte buffers\n");
+    printf("   pipeline  forwarding rate through the VNS read loop vs workers\n");
+    printf("   log       forwarding rate at each log level\n");
+    printf("   pcap      forwarding rate while capturing (-l)\n");
+    printf("   reload    forwarding rate while reloading the routing table\n");
+    printf("   rtload    loading large routing tables, text and binary\n");
+    printf("   timers    ARP retries under a second, ARP timer cost\n");
+    printf("   arpwait   first packet delay to a new neighbour\n");
+    printf("   refresh   steady flows across ARP entry expiry\n");
+    printf("   deadhop   traffic to a next hop that never answers ARP\n");
+    printf("   burst     forwarding rate in bursts of 1/8/32/64 frames\n");
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(strcmp(argv[1], "lpm") == 0)
+    { return bench_lpm(); }
+    if(strcmp(argv[1], "arp") == 0)
+    { return bench_arp(); }
+    if(strcmp(argv[1], "cksum") == 0)
+    { return bench_cksum(); }
+    if(strcmp(argv[1], "sum") == 0)
+    { return bench_sum(); }
+    if(strcmp(argv[1], "queue") == 0)
+    { return bench_queue(); }
+    if(strcmp(argv[1], "pipeline") == 0)
+    { return bench_pipeline(); }
+    if(strcmp(argv[1], "log") == 0)
+    { return bench_log(); }
+    if(strcmp(argv[1], "pcap") == 0)
+    { return bench_pcap(); }
+    if(strcmp(argv[1], "reload") == 0)
+    { return bench_reload(); }
+    if(strcmp(argv[1], "rtload") == 0)
+    { return bench_rtload(); }
+    if(strcmp(argv[1], "timers") == 0)
+    { return bench_timers(); }
+    if(strcmp(argv[1], "arpwait") == 0)
+    { return bench_arpwait(); }
+    if(strcmp(argv[1], "refresh") == 0)
+    { return bench_refresh(); }
+    if(strcmp(argv[1], "deadhop") == 0)
+    { return bench_deadhop(); }
+    if(strcmp(argv[1], "burst") == 0)
+    { return bench_burst(); }
+
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,266 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_burst.c
+ *
+ * Description:
+ *
+ * Burst entry point to the router, see sr_burst.h.
+ *
+ * Each stage is a loop over the frames still in the burst, so the code
+ * and data of a stage stay hot across the burst, and the table reads of
+ * different frames (destination cache, FIB, ARP entries) are independent
+ * and can be in flight together.  Frames are not modified until emit, so
+ * one that drops out of the burst reaches sr_handlepacket_if() as it
+ * arrived.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sr_burst.h"
+#include "sr_router.h"
+#include "sr_if.h"
+#include "sr_rt.h"
+#include "sr_fib.h"
+#include "sr_dst.h"
+#include "sr_arpcache.h"
+#include "sr_protocol.h"
+#include "sr_utils.h"
+
+/* -- where a frame is on its way through the burst -- */
+enum sr_burst_state
+{
+    burst_slow = 0,     /* sr_handlepacket_if() */
+    burst_cksum,        /* transit IP, checksum to verify */
+    burst_route,        /* missed the destination cache */
+    burst_arp,          /* routed, next hop MAC to find */
+    burst_send,         /* eth filled in, ready to go */
+    burst_unreachable,  /* no route, net unreachable */
+    burst_queue         /* next hop not in the ARP cache, sr_ForwardPacket() */
+};
+
+struct sr_burst_meta
+{
+    sr_ip_hdr_t*  ip;
+    struct sr_if* iface;        /* egress */
+    uint32_t      nexthop;
+    unsigned int  state;
+    unsigned int  rt_gen;       /* for filling the destination cache */
+    unsigned int  arp_gen;
+    uint8_t       eth[2 * ETHER_ADDR_LEN];
+};
+
+/*---------------------------------------------------------------------
+ * Method: sr_burst_parse(..)
+ * Scope: Local
+ *
+ * Pick out the transit IP datagrams, prefetching each next frame's
+ * headers while looking at this one's.
+ *
+ *---------------------------------------------------------------------*/
+
+static void sr_burst_parse(struct sr_instance* sr, struct sr_burst_frame* f,
+                           struct sr_burst_meta* m, unsigned int n)
+{
+    unsigned int i;
+
+    for(i = 0; i < n; i++)
+    {
+        if(i + 1 < n)
+        { __builtin_prefetch(f[i + 1].packet); }
+
+        m[i].state = burst_slow;
+        if(f[i].len < sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) ||
+           ethertype(f[i].packet) != ethertype_ip)
+        { continue; }
+
+        m[i].ip = (sr_ip_hdr_t*)(f[i].packet + sizeof(sr_ethernet_hdr_t));
+        if(m[i].ip->ip_ttl <= 1 || sr_if_local_lookup(sr, m[i].ip->ip_dst))
+        { continue; }
+        m[i].state = burst_cksum;
+    }
+} /* -- sr_burst_parse -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_burst_route(..)
+ * Scope: Local
+ *
+ * Longest prefix match for every frame in burst_route, all through the
+ * FIB at once when there is one.
+ *
+ *---------------------------------------------------------------------*/
+
+static void sr_burst_route(struct sr_instance* sr, struct sr_burst_meta* m,
+                           unsigned int n)
+{
+    uint32_t       ips[SR_BURST_MAX];
+    struct sr_rt*  rts[SR_BURST_MAX];
+    unsigned int   idx[SR_BURST_MAX];
+    struct sr_fib* fib;
+    unsigned int   i, k = 0;
+
+    for(i = 0; i < n; i++)
+    {
+        if(m[i].state != burst_route)
+        { continue; }
+        idx[k]   = i;
+        ips[k++] = m[i].ip->ip_dst;
+    }
+    if(k == 0)
+    { return; }
+
+    /* -- swapped by reloads, held until the caller is quiescent -- */
+    if((fib = __atomic_load_n(&sr->fib, __ATOMIC_ACQUIRE)) != 0)
+    { sr_fib_lookup_burst(fib, ips, rts, k); }
+    else
+    {
+        for(i = 0; i < k; i++)
+        { rts[i] = longestprefixmatch(sr, ips[i]); }
+    }
+
+    for(i = 0; i < k; i++)
+    {
+        struct sr_burst_meta* mi = &m[idx[i]];
+
+        if(!rts[i])
+        {
+            mi->state = burst_unreachable;
+            continue;
+        }
+        mi->iface   = sr_if_by_index(sr, rts[i]->if_index);
+        mi->nexthop = rts[i]->gw.s_addr;
+        mi->state   = burst_arp;
+    }
+} /* -- sr_burst_route -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_burst_emit(..)
+ * Scope: Local
+ *
+ * Send or hand on every frame, in the order they came in.
+ *
+ *---------------------------------------------------------------------*/
+
+static void sr_burst_emit(struct sr_instance* sr, struct sr_burst_frame* f,
+                          struct sr_burst_meta* m, unsigned int n)
+{
+    unsigned int i;
+
+    for(i = 0; i < n; i++)
+    {
+        sr_txbatch_frame(f[i].packet);
+        switch(m[i].state)
+        {
+            case burst_send:
+                ip_decrement_ttl(m[i].ip);
+                memcpy(f[i].packet, m[i].eth, 2 * ETHER_ADDR_LEN);
+                sr_send_packet_if(sr, f[i].packet, f[i].len,
+                                  m[i].iface->index);
+                break;
+
+            case burst_unreachable:
+                ip_decrement_ttl(m[i].ip);
+                LogInfoRL("no match in LPM,send net unreachable\n");
+                sr_icmp_make_packet(sr, m[i].ip, 3, 0);
+                SR_IF_STAT_ADD(sr, f[i].if_index, drops, 1);
+                break;
+
+            case burst_queue:
+                ip_decrement_ttl(m[i].ip);
+                sr_ForwardPacket(sr, f[i].packet, m[i].nexthop, f[i].len,
+                                 m[i].iface);
+                break;
+
+            default:
+                sr_handlepacket_if(sr, f[i].packet, f[i].len, f[i].if_index);
+                break;
+        }
+    }
+} /* -- sr_burst_emit -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_handlepacket_burst(..)
+ * Scope: Global
+ *
+ * sr_handlepacket_if() for n frames, see sr_burst.h.  Every frame must
+ * outlive the calling thread's send batch (sr_vns_io.h), as the frames
+ * of one receive chunk do, since forwarded frames are sent in place.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_handlepacket_burst(struct sr_instance* sr,
+                           struct sr_burst_frame* frames, unsigned int n)
+{
+    struct sr_burst_meta meta[SR_BURST_MAX];
+    struct sr_dst_entry  dst;
+    unsigned int         i, k;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+    assert(frames || n == 0);
+
+    for(; n > 0; frames += k, n -= k)
+    {
+        k = n < SR_BURST_MAX ? n : SR_BURST_MAX;
+
+        sr_burst_parse(sr, frames, meta, k);
+
+        for(i = 0; i < k; i++)
+        {
+            if(meta[i].state != burst_cksum)
+            { continue; }
+            meta[i].state = ip_checksum(meta[i].ip, frames[i].len -
+                                        sizeof(sr_ethernet_hdr_t)) ?
+                            burst_route : burst_slow;
+            if(meta[i].state == burst_route)
+            { sr_dst_prefetch(sr->dst, meta[i].ip->ip_dst); }
+        }
+
+        for(i = 0; i < k; i++)
+        {
+            if(meta[i].state != burst_route)
+            { continue; }
+            if(sr_dst_lookup(sr->dst, &sr->cache, meta[i].ip->ip_dst, &dst))
+            {
+                meta[i].iface = dst.iface;
+                memcpy(meta[i].eth, dst.eth, sizeof(meta[i].eth));
+                meta[i].state = burst_send;
+                continue;
+            }
+            meta[i].rt_gen  = dst.rt_gen;
+            meta[i].arp_gen = dst.arp_gen;
+        }
+
+        sr_burst_route(sr, meta, k);
+
+        for(i = 0; i < k; i++)
+        {
+            int slot;
+
+            if(meta[i].state != burst_arp)
+            { continue; }
+            slot = meta[i].iface ? sr_arpcache_resolve(&sr->cache,
+                                       meta[i].nexthop, meta[i].eth) : -1;
+            if(slot < 0)
+            {
+                meta[i].state = burst_queue;
+                continue;
+            }
+
+            /* -- resolved, remember it for the next datagram -- */
+            memcpy(meta[i].eth + ETHER_ADDR_LEN, meta[i].iface->addr,
+                   ETHER_ADDR_LEN);
+            dst.arp_slot = slot;
+            dst.rt_gen   = meta[i].rt_gen;
+            dst.arp_gen  = meta[i].arp_gen;
+            dst.ip       = meta[i].ip->ip_dst;
+            dst.iface    = meta[i].iface;
+            memcpy(dst.eth, meta[i].eth, sizeof(dst.eth));
+            sr_dst_fill(sr->dst, &dst);
+            meta[i].state = burst_send;
+        }
+
+        sr_burst_emit(sr, frames, meta, k);
+    }
+} /* -- sr_handlepacket_burst -- */
@@ -0,0 +1,57 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_burst.h
+ *
+ * Description:
+ *
+ * Burst entry point to the router: sr_handlepacket_burst() takes up to
+ * SR_BURST_MAX frames at once and runs each stage of the forwarding path
+ * over all of them before the next, instead of one frame all the way
+ * through at a time.
+ *
+ *   parse     ethertype, length, TTL and whether the datagram is for us,
+ *             into a small metadata record per frame
+ *   checksum  IP header checksums
+ *   dst       the destination cache (sr_dst.h)
+ *   route     longest prefix match for the misses, with the FIB reads of
+ *             the whole burst interleaved (sr_fib_lookup_burst)
+ *   arp       next hop MACs, filling the destination cache
+ *   emit      in arrival order: TTL, MACs and send for the forwarded
+ *             frames, sr_handlepacket_if() for everything else
+ *
+ * Frames that are not plain transit IP (ARP, datagrams for the router,
+ * TTL expiring, bad checksums) leave the burst at the parse or checksum
+ * stage and are handled one at a time by sr_handlepacket_if() when their
+ * turn comes in emit, as are forwarded frames whose next hop is not in
+ * the ARP cache, through sr_ForwardPacket().  What goes out is what
+ * handling the frames one by one would send, in the same order, except
+ * that the tables are read for the whole burst before any of it goes
+ * out: an ARP reply in a burst is only used from the next one on.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_BURST_H
+#define sr_BURST_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+struct sr_instance;
+
+#define SR_BURST_MAX 64  /* frames per sr_handlepacket_burst() call */
+
+struct sr_burst_frame
+{
+    uint8_t*     packet;    /* lent, with SR_PKT_HEADROOM in front */
+    unsigned int len;
+    unsigned int if_index;  /* received on, see sr_if_by_index */
+};
+
+void sr_handlepacket_burst(struct sr_instance* sr,
+                           struct sr_burst_frame* frames, unsigned int n);
+
+#endif  /* --  sr_BURST_H -- */
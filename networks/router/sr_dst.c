@@ -0,0 +1,158 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_dst.c
+ *
+ * Description:
+ *
+ * Destination cache, see sr_dst.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sr_dst.h"
+#include "sr_arpcache.h"
+
+/*---------------------------------------------------------------------
+ * Method: sr_dst_slot(..)
+ * Scope: Local
+ *
+ * Slot of ip (network order), multiplicative hash as in the ARP cache.
+ *
+ *---------------------------------------------------------------------*/
+
+static struct sr_dst_entry* sr_dst_slot(struct sr_dst_cache* dc, uint32_t ip)
+{ return &dc->entries[(ip * 2654435761u) >> (32 - SR_DST_BITS)]; }
+
+/*---------------------------------------------------------------------
+ * Method: sr_dst_create()
+ * Scope: Global
+ *
+ * An empty cache, 0 if out of memory.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_dst_cache* sr_dst_create(void)
+{
+    struct sr_dst_cache* dc;
+
+    if(posix_memalign((void**)&dc, 64, sizeof(struct sr_dst_cache)) != 0)
+    { return 0; }
+    memset(dc, 0, sizeof(struct sr_dst_cache));
+    return dc;
+} /* -- sr_dst_create -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dst_lookup(..)
+ * Scope: Global
+ *
+ * Copy the current entry for ip into *out and return 1, or return 0.
+ * Either way out->rt_gen and out->arp_gen are the generations as they
+ * were before the lookup: after a miss the caller resolves ip, fills in
+ * out->ip, iface, eth and arp_slot and hands out to sr_dst_fill(), so an
+ * entry resolved while routes or ARP changed underneath is already stale.
+ * A hit marks the next hop's ARP entry used.  dc may be 0 (always a miss).
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_dst_lookup(struct sr_dst_cache* dc, struct sr_arpcache* arp,
+                  uint32_t ip, struct sr_dst_entry* out)
+{
+    struct sr_dst_entry* e;
+    unsigned int         seq, rt_gen, arp_gen;
+    int                  hit;
+
+    arp_gen = __atomic_load_n(&arp->gen, __ATOMIC_ACQUIRE);
+    rt_gen  = dc ? __atomic_load_n(&dc->gen, __ATOMIC_ACQUIRE) : 0;
+    if(!dc)
+    {
+        out->rt_gen  = rt_gen;
+        out->arp_gen = arp_gen;
+        return 0;
+    }
+
+    e = sr_dst_slot(dc, ip);
+    seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+    memcpy(out, e, sizeof(struct sr_dst_entry));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    hit = !(seq & 1) && __atomic_load_n(&e->seq, __ATOMIC_RELAXED) == seq &&
+          out->iface && out->ip == ip &&
+          out->rt_gen == rt_gen && out->arp_gen == arp_gen;
+
+    if(hit)
+    {
+        __atomic_fetch_add(&dc->hits, 1, __ATOMIC_RELAXED);
+        sr_arpcache_touch(arp, out->arp_slot);
+    }
+    else
+    {
+        __atomic_fetch_add(&dc->misses, 1, __ATOMIC_RELAXED);
+        out->rt_gen  = rt_gen;
+        out->arp_gen = arp_gen;
+    }
+    return hit;
+} /* -- sr_dst_lookup -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dst_prefetch(..)
+ * Scope: Global
+ *
+ * Start loading ip's entry, for a lookup of it soon after.  dc may be 0.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_dst_prefetch(struct sr_dst_cache* dc, uint32_t ip)
+{
+    if(dc)
+    { __builtin_prefetch(sr_dst_slot(dc, ip)); }
+} /* -- sr_dst_prefetch -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dst_fill(..)
+ * Scope: Global
+ *
+ * Store an entry set up as described at sr_dst_lookup().  Skipped if
+ * another thread is filling the same slot.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_dst_fill(struct sr_dst_cache* dc, const struct sr_dst_entry* in)
+{
+    struct sr_dst_entry* e;
+    unsigned int         seq;
+
+    if(!dc)
+    { return; }
+
+    e   = sr_dst_slot(dc, in->ip);
+    seq = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+    if((seq & 1) ||
+       !__atomic_compare_exchange_n(&e->seq, &seq, seq + 1, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    { return; }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    e->ip      = in->ip;
+    e->rt_gen  = in->rt_gen;
+    e->arp_gen = in->arp_gen;
+    e->iface   = in->iface;
+    e->arp_slot = in->arp_slot;
+    memcpy(e->eth, in->eth, sizeof(e->eth));
+
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+} /* -- sr_dst_fill -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dst_flush(..)
+ * Scope: Global
+ *
+ * Retire every entry; call when the routing table changes.  dc may be 0.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_dst_flush(struct sr_dst_cache* dc)
+{
+    if(dc)
+    { __atomic_add_fetch(&dc->gen, 1, __ATOMIC_RELEASE); }
+} /* -- sr_dst_flush -- */
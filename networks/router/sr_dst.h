@@ -0,0 +1,71 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_dst.h
+ *
+ * Description:
+ *
+ * Destination cache in front of the forwarding lookups.
+ *
+ * Forwarding a datagram takes a longest prefix match, the egress interface
+ * by name and the next hop's MAC from the ARP cache, and for a steady flow
+ * the answer is the same every time.  The destination cache is a direct
+ * mapped table keyed by ip_dst holding that answer: the egress interface
+ * and the two Ethernet addresses, in one cache line.
+ *
+ * Entries are never removed.  Each carries the generations of the routing
+ * table and of the ARP cache it was filled under, and only counts while
+ * both are current: reloading routes (sr_dst_flush) or an ARP mapping
+ * being removed or changed (sr_arpcache gen) retires every entry at once.
+ *
+ * Lookups take no lock.  Each entry is a small seqlock; a thread filling
+ * an entry another thread is filling gives up, it will be filled again.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_DST_H
+#define sr_DST_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include "sr_protocol.h"
+
+struct sr_if;
+struct sr_arpcache;
+
+#define SR_DST_BITS 10
+#define SR_DST_SIZE (1 << SR_DST_BITS)
+
+struct sr_dst_entry
+{
+    unsigned int  seq;      /* odd while being filled */
+    uint32_t      ip;       /* destination, network order */
+    unsigned int  rt_gen;   /* generations filled under */
+    unsigned int  arp_gen;
+    struct sr_if* iface;    /* egress, 0 for an empty entry */
+    uint8_t       eth[2 * ETHER_ADDR_LEN]; /* next hop then iface MAC, as
+                                              they go in the frame */
+    unsigned int  arp_slot; /* next hop's ARP entry, marked used on a hit */
+} __attribute__ ((aligned (64)));
+
+struct sr_dst_cache
+{
+    unsigned int        gen;      /* routing table generation, on a line of
+                                     its own ahead of the entries */
+    struct sr_dst_entry entries[SR_DST_SIZE];
+    unsigned long       hits;
+    unsigned long       misses;
+};
+
+struct sr_dst_cache* sr_dst_create(void);
+int  sr_dst_lookup(struct sr_dst_cache* dc, struct sr_arpcache* arp,
+                   uint32_t ip, struct sr_dst_entry* out);
+void sr_dst_prefetch(struct sr_dst_cache* dc, uint32_t ip);
+void sr_dst_fill(struct sr_dst_cache* dc, const struct sr_dst_entry* in);
+void sr_dst_flush(struct sr_dst_cache* dc);
+
+#endif  /* --  sr_DST_H -- */
@@ -0,0 +1,326 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_fib.c
+ *
+ * Description:
+ *
+ * Builds and queries the DIR-16-8-8 forwarding table described in sr_fib.h.
+ *
+ * Routes are inserted in order of increasing prefix length, so a longer
+ * prefix always overwrites the expansion of any shorter prefix covering it,
+ * and a block created for a long prefix inherits the entry it replaces.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_fib.h"
+#include "sr_rt.h"
+
+struct sr_fib_ins
+{
+    uint32_t prefix;   /* host order, already masked */
+    uint32_t len;
+    uint32_t order;    /* position in the routing list */
+};
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_masklen(..)
+ * Scope: Local
+ *
+ * Prefix length of a network order mask.  Non contiguous masks are not
+ * something longest prefix match can express, so warn and use the
+ * leading ones.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint32_t sr_fib_masklen(uint32_t mask_nbo)
+{
+    uint32_t mask = ntohl(mask_nbo);
+    uint32_t len  = 0;
+
+    while(len < 32 && (mask & (0x80000000u >> len)))
+    { len++; }
+
+    if(len < 32 && (mask << len) != 0)
+    {
+        fprintf(stderr, "sr_fib: non contiguous mask %08x, using /%u\n",
+                mask, len);
+    }
+
+    return len;
+} /* -- sr_fib_masklen -- */
+
+static int sr_fib_ins_cmp(const void* a, const void* b)
+{
+    const struct sr_fib_ins* x = a;
+    const struct sr_fib_ins* y = b;
+
+    if(x->len != y->len)
+    { return x->len < y->len ? -1 : 1; }
+
+    /* same length: insert later routes first so the earliest one in the
+     * list wins, as it did with the linear walk */
+    if(x->order != y->order)
+    { return x->order > y->order ? -1 : 1; }
+    return 0;
+} /* -- sr_fib_ins_cmp -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_child(..)
+ * Scope: Local
+ *
+ * Return the block index *slot points at, creating a block that
+ * inherits the current value of *slot if there is none yet.  Returns
+ * -1 if out of memory.
+ *
+ *---------------------------------------------------------------------*/
+
+static long sr_fib_child(struct sr_fib* fib, uint32_t* tbl, uint32_t slot)
+{
+    uint32_t  blk;
+    uint32_t  inherit = tbl[slot];
+    uint32_t* b;
+    int       i;
+
+    if(inherit & SR_FIB_CHILD)
+    { return inherit & ~SR_FIB_CHILD; }
+
+    if(fib->tbl8_blocks == fib->tbl8_cap)
+    {
+        uint32_t  cap = fib->tbl8_cap ? fib->tbl8_cap * 2 : 64;
+        uint32_t* n   = realloc(fib->tbl8,
+                                (size_t)cap * SR_FIB_BLK_SIZE * sizeof(uint32_t));
+        if(!n)
+        { return -1; }
+        /* tbl may point into tbl8 */
+        if(tbl != fib->tbl16)
+        { tbl = n + (tbl - fib->tbl8); }
+        fib->tbl8     = n;
+        fib->tbl8_cap = cap;
+    }
+
+    blk = fib->tbl8_blocks++;
+    b   = fib->tbl8 + (size_t)blk * SR_FIB_BLK_SIZE;
+    for(i = 0; i < SR_FIB_BLK_SIZE; i++)
+    { b[i] = inherit; }
+
+    tbl[slot] = SR_FIB_CHILD | blk;
+    return blk;
+} /* -- sr_fib_child -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_insert(..)
+ * Scope: Local
+ *
+ * Expand one prefix into the level it ends in.  Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_fib_insert(struct sr_fib* fib, uint32_t prefix, uint32_t len,
+                         uint32_t idx)
+{
+    uint32_t  i, first, count;
+    long      b2, b3;
+    uint32_t* tbl;
+
+    if(len <= 16)
+    {
+        first = prefix >> 16;
+        count = 1u << (16 - len);
+        for(i = 0; i < count; i++)
+        { fib->tbl16[first + i] = idx; }
+        return 0;
+    }
+
+    if((b2 = sr_fib_child(fib, fib->tbl16, prefix >> 16)) < 0)
+    { return -1; }
+
+    if(len <= 24)
+    {
+        tbl   = fib->tbl8 + (size_t)b2 * SR_FIB_BLK_SIZE;
+        first = (prefix >> 8) & 0xff;
+        count = 1u << (24 - len);
+        for(i = 0; i < count; i++)
+        { tbl[first + i] = idx; }
+        return 0;
+    }
+
+    if((b3 = sr_fib_child(fib, fib->tbl8 + (size_t)b2 * SR_FIB_BLK_SIZE,
+                          (prefix >> 8) & 0xff)) < 0)
+    { return -1; }
+
+    tbl   = fib->tbl8 + (size_t)b3 * SR_FIB_BLK_SIZE;
+    first = prefix & 0xff;
+    count = 1u << (32 - len);
+    for(i = 0; i < count; i++)
+    { tbl[first + i] = idx; }
+    return 0;
+} /* -- sr_fib_insert -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_build(..)
+ * Scope: Global
+ *
+ * Compile a routing list into a new FIB.  The FIB keeps pointers to the
+ * list entries, so the list must outlive it.  Returns 0 if out of
+ * memory.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_fib* sr_fib_build(struct sr_rt* routes)
+{
+    struct sr_fib*     fib;
+    struct sr_fib_ins* ins;
+    struct sr_rt*      rt_walker;
+    uint32_t           n = 0, i;
+
+    for(rt_walker = routes; rt_walker; rt_walker = rt_walker->next)
+    { n++; }
+
+    if((fib = calloc(1, sizeof(struct sr_fib))) == 0)
+    { return 0; }
+
+    fib->nroutes = n;
+    fib->routes  = malloc((n + 1) * sizeof(struct sr_rt*));
+    ins          = malloc((n + 1) * sizeof(struct sr_fib_ins));
+    if(!fib->routes || !ins)
+    {
+        free(ins);
+        sr_fib_destroy(fib);
+        return 0;
+    }
+
+    fib->routes[0] = 0;
+    for(i = 0, rt_walker = routes; rt_walker; rt_walker = rt_walker->next, i++)
+    {
+        fib->routes[i + 1] = rt_walker;
+        ins[i].len    = sr_fib_masklen(rt_walker->mask.s_addr);
+        ins[i].prefix = ntohl(rt_walker->dest.s_addr) &
+                        (ins[i].len ? 0xffffffffu << (32 - ins[i].len) : 0);
+        ins[i].order  = i;
+    }
+
+    qsort(ins, n, sizeof(struct sr_fib_ins), sr_fib_ins_cmp);
+
+    for(i = 0; i < n; i++)
+    {
+        if(sr_fib_insert(fib, ins[i].prefix, ins[i].len, ins[i].order + 1) != 0)
+        {
+            free(ins);
+            sr_fib_destroy(fib);
+            return 0;
+        }
+    }
+
+    free(ins);
+    return fib;
+} /* -- sr_fib_build -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_destroy(..)
+ * Scope: Global
+ *
+ * Free a FIB.  The routes it points to are not touched.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_fib_destroy(struct sr_fib* fib)
+{
+    if(!fib)
+    { return; }
+
+    free(fib->tbl8);
+    free(fib->routes);
+    free(fib);
+} /* -- sr_fib_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_lookup(..)
+ * Scope: Global
+ *
+ * Longest prefix match for a network order address, 0 if no route.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_fib_lookup(const struct sr_fib* fib, uint32_t ip_nbo)
+{
+    uint32_t a = ntohl(ip_nbo);
+    uint32_t e = fib->tbl16[a >> 16];
+
+    if(e & SR_FIB_CHILD)
+    {
+        e = fib->tbl8[((size_t)(e & ~SR_FIB_CHILD) << 8) | ((a >> 8) & 0xff)];
+        if(e & SR_FIB_CHILD)
+        { e = fib->tbl8[((size_t)(e & ~SR_FIB_CHILD) << 8) | (a & 0xff)]; }
+    }
+
+    return fib->routes[e];
+} /* -- sr_fib_lookup -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_lookup_burst(..)
+ * Scope: Global
+ *
+ * sr_fib_lookup() for n addresses into out.  The lookups go level by
+ * level over SR_FIB_BURST addresses at a time, prefetching the entries
+ * the next level reads, so the cache misses of a burst overlap instead
+ * of each lookup waiting on its own one after the other.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_fib_lookup_burst(const struct sr_fib* fib, const uint32_t* ip_nbo,
+                         struct sr_rt** out, unsigned int n)
+{
+    uint32_t     a[SR_FIB_BURST];
+    uint32_t     e[SR_FIB_BURST];
+    unsigned int i, m, level;
+
+    for(; n > 0; ip_nbo += m, out += m, n -= m)
+    {
+        m = n < SR_FIB_BURST ? n : SR_FIB_BURST;
+
+        for(i = 0; i < m; i++)
+        {
+            a[i] = ntohl(ip_nbo[i]);
+            __builtin_prefetch(&fib->tbl16[a[i] >> 16]);
+        }
+        for(i = 0; i < m; i++)
+        {
+            e[i] = fib->tbl16[a[i] >> 16];
+            if(e[i] & SR_FIB_CHILD)
+            {
+                __builtin_prefetch(&fib->tbl8[((size_t)(e[i] & ~SR_FIB_CHILD)
+                                               << 8) | ((a[i] >> 8) & 0xff)]);
+            }
+        }
+
+        /* -- second and third level, only for those that go there -- */
+        for(level = 0; level < 2; level++)
+        {
+            for(i = 0; i < m; i++)
+            {
+                if(!(e[i] & SR_FIB_CHILD))
+                { continue; }
+                e[i] = fib->tbl8[((size_t)(e[i] & ~SR_FIB_CHILD) << 8) |
+                                 ((a[i] >> (level ? 0 : 8)) & 0xff)];
+                if(level == 0 && (e[i] & SR_FIB_CHILD))
+                {
+                    __builtin_prefetch(&fib->tbl8[((size_t)(e[i] & ~SR_FIB_CHILD)
+                                                   << 8) | (a[i] & 0xff)]);
+                }
+            }
+        }
+
+        for(i = 0; i < m; i++)
+        {
+            out[i] = fib->routes[e[i]];
+            __builtin_prefetch(out[i]);
+        }
+    }
+} /* -- sr_fib_lookup_burst -- */
@@ -0,0 +1,62 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_fib.h
+ *
+ * Description:
+ *
+ * Compiled forwarding table (FIB) built from the sr_rt routing list.
+ *
+ * The FIB is a three level multibit trie with strides 16/8/8 (DIR-16-8-8).
+ * Prefixes are expanded into the level they end in, so a lookup is at most
+ * three array reads no matter how many routes are loaded.  A FIB is immutable
+ * once built; reloading the routing table builds a new one.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_FIB_H
+#define sr_FIB_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+struct sr_rt;
+
+#define SR_FIB_L1_BITS   16
+#define SR_FIB_L1_SIZE   (1 << SR_FIB_L1_BITS)
+#define SR_FIB_BLK_SIZE  256
+
+/* entry encoding: 0 is no route, SR_FIB_CHILD|n is 256 entry block n of
+ * tbl8, anything else is a 1 based index into routes */
+#define SR_FIB_CHILD     0x80000000u
+
+#define SR_FIB_BURST     64     /* lookups sr_fib_lookup_burst interleaves */
+
+/* ----------------------------------------------------------------------------
+ * struct sr_fib
+ *
+ * tbl16 is indexed by the top 16 bits of the (host order) destination,
+ * tbl8 holds the 256 entry blocks for prefixes longer than /16.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_fib
+{
+    uint32_t       tbl16[SR_FIB_L1_SIZE];
+    uint32_t*      tbl8;
+    uint32_t       tbl8_blocks;   /* blocks in use */
+    uint32_t       tbl8_cap;      /* blocks allocated */
+    struct sr_rt** routes;        /* routes[0] is unused */
+    uint32_t       nroutes;
+};
+
+struct sr_fib* sr_fib_build(struct sr_rt* routes);
+void sr_fib_destroy(struct sr_fib* fib);
+struct sr_rt* sr_fib_lookup(const struct sr_fib* fib, uint32_t ip_nbo);
+void sr_fib_lookup_burst(const struct sr_fib* fib, const uint32_t* ip_nbo,
+                         struct sr_rt** out, unsigned int n);
+
+#endif  /* --  sr_FIB_H -- */
@@ -54,6 +54,132 @@ struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name)
     return 0;
 } /* -- sr_get_interface -- */
 
+/*---------------------------------------------------------------------
+ * Method: sr_if_by_index(..)
+ * Scope: Global
+ *
+ * The interface with the given index (see struct sr_if) or 0.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_if* sr_if_by_index(struct sr_instance* sr, unsigned int index)
+{ return index < sr->if_count ? sr->if_index[index] : 0; }
+
+/*---------------------------------------------------------------------
+ * Method: sr_if_local_lookup(..)
+ * Scope: Global
+ *
+ * The interface that has ip (network order) as its address, or 0.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_if* sr_if_local_lookup(struct sr_instance* sr, uint32_t ip_nbo)
+{
+    struct sr_if_slot* slot;
+
+    if(!sr->if_local.slots)
+    { return 0; }
+
+    slot = &sr->if_local.slots[(ip_nbo * sr->if_local.mul) >>
+                               sr->if_local.shift];
+    return slot->ip == ip_nbo ? slot->iface : 0;
+} /* -- sr_if_local_lookup -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_if_local_build(..)
+ * Scope: Local
+ *
+ * Rebuild sr->if_local from the interface list: at least twice as many
+ * slots as addresses, doubled until one of SR_IF_LOCAL_TRIES
+ * multipliers puts every address in a slot of its own.  An address on
+ * two interfaces stays with the first, as with a walk of the list.
+ *
+ *---------------------------------------------------------------------*/
+
+static void sr_if_local_build(struct sr_instance* sr)
+{
+    struct sr_if*      if_walker;
+    struct sr_if_slot* slots = 0;
+    struct sr_if_slot* slot;
+    unsigned int       bits = 3, n = 0, tries;
+    uint32_t           mul = 0;
+
+    for(if_walker = sr->if_list; if_walker; if_walker = if_walker->next)
+    {
+        if(if_walker->ip)
+        { n++; }
+    }
+    while((1u << bits) < 2 * n)
+    { bits++; }
+
+    while(n)
+    {
+        slots = (struct sr_if_slot*)realloc(slots,
+                    sizeof(struct sr_if_slot) << bits);
+        assert(slots);
+
+        for(tries = 0, mul = 2654435761u; tries < SR_IF_LOCAL_TRIES;
+            tries++, mul += 0x9e3779b8u)
+        {
+            memset(slots, 0, sizeof(struct sr_if_slot) << bits);
+            for(if_walker = sr->if_list; if_walker; if_walker = if_walker->next)
+            {
+                if(!if_walker->ip)
+                { continue; }
+                slot = &slots[(if_walker->ip * mul) >> (32 - bits)];
+                if(slot->iface && slot->ip != if_walker->ip)
+                { break; }
+                if(!slot->iface)
+                {
+                    slot->ip    = if_walker->ip;
+                    slot->iface = if_walker;
+                }
+            }
+            if(!if_walker)
+            { break; }
+        }
+        if(tries < SR_IF_LOCAL_TRIES)
+        { break; }
+        bits++;
+    }
+
+    free(sr->if_local.slots);
+    sr->if_local.slots = slots;
+    sr->if_local.mul   = mul;
+    sr->if_local.shift = 32 - bits;
+} /* -- sr_if_local_build -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_if_index_add(..)
+ * Scope: Local
+ *
+ * Give a new interface the next index and a zeroed set of counters.
+ *
+ *---------------------------------------------------------------------*/
+
+static void sr_if_index_add(struct sr_instance* sr, struct sr_if* iface)
+{
+    struct sr_if_stats* stats;
+
+    sr->if_index = (struct sr_if**)realloc(sr->if_index,
+                       (sr->if_count + 1) * sizeof(struct sr_if*));
+    assert(sr->if_index);
+
+    /* -- realloc() would not keep the counters cache aligned -- */
+    if(posix_memalign((void**)&stats, 64,
+                      (sr->if_count + 1) * sizeof(struct sr_if_stats)) != 0)
+    { assert(0); }
+    memset(stats, 0, (sr->if_count + 1) * sizeof(struct sr_if_stats));
+    if(sr->if_stats)
+    { memcpy(stats, sr->if_stats, sr->if_count * sizeof(struct sr_if_stats)); }
+    free(sr->if_stats);
+    sr->if_stats = stats;
+
+    iface->index = sr->if_count;
+    sr->if_index[sr->if_count++] = iface;
+    sr_if_local_build(sr);
+} /* -- sr_if_index_add -- */
+
 /*--------------------------------------------------------------------- 
  * Method: sr_add_interface(..)
  * Scope: Global
@@ -75,8 +201,9 @@ void sr_add_interface(struct sr_instance* sr, const char* name)
     {
         sr->if_list = (struct sr_if*)malloc(sizeof(struct sr_if));
         assert(sr->if_list);
-        sr->if_list->next = 0;
+        memset(sr->if_list, 0, sizeof(struct sr_if));
         strncpy(sr->if_list->name,name,sr_IFACE_NAMELEN);
+        sr_if_index_add(sr, sr->if_list);
         return;
     }
 
@@ -88,8 +215,9 @@ void sr_add_interface(struct sr_instance* sr, const char* name)
     if_walker->next = (struct sr_if*)malloc(sizeof(struct sr_if));
     assert(if_walker->next);
     if_walker = if_walker->next;
+    memset(if_walker, 0, sizeof(struct sr_if));
     strncpy(if_walker->name,name,sr_IFACE_NAMELEN);
-    if_walker->next = 0;
+    sr_if_index_add(sr, if_walker);
 } /* -- sr_add_interface -- */ 
 
 /*--------------------------------------------------------------------- 
@@ -137,6 +265,7 @@ void sr_set_ether_ip(struct sr_instance* sr, uint32_t ip_nbo)
 
     /* -- copy address -- */
     if_walker->ip = ip_nbo;
+    sr_if_local_build(sr);
 
 } /* -- sr_set_ether_ip -- */
 
@@ -192,3 +321,26 @@ void sr_print_if(struct sr_if* iface)
     Debug("\n");
     Debug("\tinet addr %s\n",inet_ntoa(ip_addr));
 } /* -- sr_print_if -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_print_if_stats(..)
+ * Scope: Global
+ *
+ * One line of counters (struct sr_if_stats) per interface.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_print_if_stats(struct sr_instance* sr, FILE* fp)
+{
+    struct sr_if_stats* st;
+    unsigned int        i;
+
+    for(i = 0; i < sr->if_count; i++)
+    {
+        st = &sr->if_stats[i];
+        fprintf(fp, "%s: rx %lu frames %lu bytes, tx %lu frames %lu bytes, "
+                "%lu drops\n", sr->if_index[i]->name,
+                st->rx_packets, st->rx_bytes, st->tx_packets, st->tx_bytes,
+                st->drops);
+    }
+} /* -- sr_print_if_stats -- */
@@ -24,6 +24,8 @@
 #include <inttypes.h>
 #endif
 
+#include <stdio.h>
+
 #include "sr_protocol.h"
 
 struct sr_instance;
@@ -41,15 +43,69 @@ struct sr_if
   unsigned char addr[ETHER_ADDR_LEN];
   uint32_t ip;
   uint32_t speed;
+  unsigned int index;  /* dense, in order added, see sr_if_by_index */
   struct sr_if* next;
 };
 
+#define SR_IF_NONE (~0u)  /* index of no interface */
+
+/* ----------------------------------------------------------------------------
+ * struct sr_if_stats
+ *
+ * Per interface counters, in sr->if_stats by interface index, one cache
+ * line each so threads counting on different interfaces stay apart.
+ * Drops are frames received on the interface that the router threw away
+ * and frames it failed to send out of it.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_if_stats
+{
+  unsigned long rx_packets;
+  unsigned long rx_bytes;
+  unsigned long tx_packets;
+  unsigned long tx_bytes;
+  unsigned long drops;
+} __attribute__ ((aligned (64)));
+
+#define SR_IF_STAT_ADD(sr, index, field, n) \
+    __atomic_fetch_add(&(sr)->if_stats[index].field, (n), __ATOMIC_RELAXED)
+
+/* ----------------------------------------------------------------------------
+ * struct sr_if_local
+ *
+ * The router's own IP addresses, for telling whether a datagram is for us.
+ * A perfect hash: the multiplier is picked when the set is built so that
+ * no two addresses share a slot, and a lookup is one probe.  Rebuilt when
+ * an interface is added or its address set, which happens while the
+ * router is set up, before any packets.
+ *
+ * -------------------------------------------------------------------------- */
+
+#define SR_IF_LOCAL_TRIES 64  /* multipliers tried before doubling the slots */
+
+struct sr_if_slot
+{
+  uint32_t ip;           /* network order, 0 if empty */
+  struct sr_if* iface;
+};
+
+struct sr_if_local
+{
+  uint32_t mul;
+  unsigned int shift;    /* 32 - log2(slots) */
+  struct sr_if_slot* slots;
+};
+
 struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name);
+struct sr_if* sr_if_by_index(struct sr_instance* sr, unsigned int index);
+struct sr_if* sr_if_local_lookup(struct sr_instance* sr, uint32_t ip_nbo);
 void sr_add_interface(struct sr_instance*, const char*);
 void sr_set_ether_addr(struct sr_instance*, const unsigned char*);
 void sr_set_ether_ip(struct sr_instance*, uint32_t ip_nbo);
 struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name);
 void sr_print_if_list(struct sr_instance*);
 void sr_print_if(struct sr_if*);
+void sr_print_if_stats(struct sr_instance*, FILE*);
 
 #endif /* --  sr_INTERFACE_H -- */
@@ -0,0 +1,91 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_log.c
+ *
+ * Description:
+ *
+ * Leveled logging, see sr_log.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "sr_log.h"
+
+/* -- per packet lines are off unless asked for -- */
+int sr_log_level = SR_LOG_INFO;
+
+/*---------------------------------------------------------------------
+ * Method: sr_log_set_level(..)
+ * Scope: Global
+ *
+ * Change the run time level.  Levels above SR_LOG_BUILD stay silent.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_log_set_level(int level)
+{
+    if(level < SR_LOG_ERR)
+    { level = SR_LOG_ERR; }
+    if(level > SR_LOG_BUILD)
+    {
+        fprintf(stderr, "log level %d not compiled in, using %d\n",
+                level, SR_LOG_BUILD);
+        level = SR_LOG_BUILD;
+    }
+    __atomic_store_n(&sr_log_level, level, __ATOMIC_RELAXED);
+} /* -- sr_log_set_level -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_log_printf(..)
+ * Scope: Global
+ *
+ * Print one message, the caller has already checked the level.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_log_printf(int level, const char* fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(level <= SR_LOG_WARN ? stderr : stdout, fmt, ap);
+    va_end(ap);
+} /* -- sr_log_printf -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_log_ratelimit(..)
+ * Scope: Global
+ *
+ * Non zero if the call site owning rl may print another message this
+ * second.  The first message of a new second first reports how many
+ * were dropped.  Racing threads may let a message or two too many
+ * through, which is fine for logging.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_log_ratelimit(struct sr_log_rl* rl, int level, const char* file,
+                     int line)
+{
+    time_t        now = time(0);
+    unsigned long missed;
+
+    if(__atomic_load_n(&rl->sec, __ATOMIC_RELAXED) != now)
+    {
+        __atomic_store_n(&rl->sec, now, __ATOMIC_RELAXED);
+        __atomic_store_n(&rl->count, 0, __ATOMIC_RELAXED);
+        missed = __atomic_exchange_n(&rl->missed, 0, __ATOMIC_RELAXED);
+        if(missed)
+        {
+            sr_log_printf(level, "%s:%d: %lu messages suppressed\n",
+                          file, line, missed);
+        }
+    }
+
+    if(__atomic_fetch_add(&rl->count, 1, __ATOMIC_RELAXED) < SR_LOG_RL_BURST)
+    { return 1; }
+
+    __atomic_fetch_add(&rl->missed, 1, __ATOMIC_RELAXED);
+    return 0;
+} /* -- sr_log_ratelimit -- */
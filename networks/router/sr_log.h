@@ -0,0 +1,101 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_log.h
+ *
+ * Description:
+ *
+ * Leveled logging for the router.
+ *
+ * Each message has a level; it is printed when the level is at or below
+ * sr_log_level, which can be changed at run time (-d on the command
+ * line).  Levels above SR_LOG_BUILD are removed by the preprocessor: the
+ * sites compile to nothing and their arguments are never evaluated, so
+ * arguments must not have side effects.
+ *
+ * Errors and warnings go to stderr, everything else to stdout.  The *RL
+ * variants allow SR_LOG_RL_BURST messages per second from each call site
+ * and report how many they dropped; use them for anything a stream of
+ * bad packets could trigger.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_LOG_H
+#define sr_LOG_H
+
+#include <time.h>
+
+#define SR_LOG_ERR   0   /* the router cannot carry on as asked */
+#define SR_LOG_WARN  1   /* bad input, dropped packets */
+#define SR_LOG_INFO  2   /* setup, ICMP errors sent, ARP give ups */
+#define SR_LOG_DEBUG 3   /* a line or more for every packet */
+
+/* -- most verbose level compiled in, override with -DSR_LOG_BUILD=n -- */
+#ifndef SR_LOG_BUILD
+#ifdef _DEBUG_
+#define SR_LOG_BUILD SR_LOG_DEBUG
+#else
+#define SR_LOG_BUILD SR_LOG_INFO
+#endif
+#endif
+
+#define SR_LOG_RL_BURST 10
+
+/* -- dotted quad of an address in network byte order, for "%u.%u.%u.%u" -- */
+#define SR_LOG_IP(ip) \
+    (unsigned)(ntohl(ip) >> 24), (unsigned)(ntohl(ip) >> 16 & 0xff), \
+    (unsigned)(ntohl(ip) >> 8 & 0xff), (unsigned)(ntohl(ip) & 0xff)
+
+struct sr_log_rl
+{
+    time_t        sec;    /* second being counted */
+    unsigned int  count;  /* messages in that second */
+    unsigned long missed; /* dropped since the last report */
+};
+
+extern int sr_log_level;
+
+void sr_log_set_level(int level);
+void sr_log_printf(int level, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+int  sr_log_ratelimit(struct sr_log_rl* rl, int level, const char* file,
+                      int line);
+
+#define SR_LOG_AT(level, fmt, args...)                                   \
+    do {                                                                 \
+        if((level) <= sr_log_level)                                      \
+        { sr_log_printf((level), fmt, ## args); }                        \
+    } while(0)
+
+#define SR_LOG_RL_AT(level, fmt, args...)                                \
+    do {                                                                 \
+        static struct sr_log_rl sr_log_rl_;                              \
+        if((level) <= sr_log_level &&                                    \
+           sr_log_ratelimit(&sr_log_rl_, (level), __FILE__, __LINE__))   \
+        { sr_log_printf((level), fmt, ## args); }                        \
+    } while(0)
+
+#define LogErr(fmt, args...)    SR_LOG_AT(SR_LOG_ERR, fmt, ## args)
+#define LogErrRL(fmt, args...)  SR_LOG_RL_AT(SR_LOG_ERR, fmt, ## args)
+
+#if SR_LOG_BUILD >= SR_LOG_WARN
+#define LogWarn(fmt, args...)   SR_LOG_AT(SR_LOG_WARN, fmt, ## args)
+#define LogWarnRL(fmt, args...) SR_LOG_RL_AT(SR_LOG_WARN, fmt, ## args)
+#else
+#define LogWarn(fmt, args...)   do{}while(0)
+#define LogWarnRL(fmt, args...) do{}while(0)
+#endif
+
+#if SR_LOG_BUILD >= SR_LOG_INFO
+#define LogInfo(fmt, args...)   SR_LOG_AT(SR_LOG_INFO, fmt, ## args)
+#define LogInfoRL(fmt, args...) SR_LOG_RL_AT(SR_LOG_INFO, fmt, ## args)
+#else
+#define LogInfo(fmt, args...)   do{}while(0)
+#define LogInfoRL(fmt, args...) do{}while(0)
+#endif
+
+#if SR_LOG_BUILD >= SR_LOG_DEBUG
+#define LogDebug(fmt, args...)  SR_LOG_AT(SR_LOG_DEBUG, fmt, ## args)
+#else
+#define LogDebug(fmt, args...)  do{}while(0)
+#endif
+
+#endif  /* --  sr_LOG_H -- */
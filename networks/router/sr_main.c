@@ -29,9 +29,11 @@
 #include <getopt.h>
 #endif /* _LINUX_ */
 
-#include "sr_dumper.h"
+#include "sr_pcap.h"
 #include "sr_router.h"
 #include "sr_rt.h"
+#include "sr_pipeline.h"
+#include "sr_burst.h"
 
 extern char* optarg;
 
@@ -65,11 +67,21 @@ int main(int argc, char **argv)
     unsigned int port = DEFAULT_PORT;
     unsigned int topo = DEFAULT_TOPO;
     char *logfile = 0;
+    unsigned int snaplen = PACKET_DUMP_SIZE;
+    unsigned long rotate = 0;
+    enum sr_pcap_fmt logfmt = sr_pcap_classic;
+    unsigned int arpcache_sz = 0;
+    unsigned int arpq_req = 0, arpq_total = 0;
+    int arpq_oldest = 0;
+    unsigned int arp_retry = 0;
+    unsigned int arp_neg = 0;
+    int workers = 0;
+    unsigned int burst = 0;
     struct sr_instance sr;
 
     printf("Using %s\n", VERSION_INFO);
 
-    while ((c = getopt(argc, argv, "hs:v:p:u:t:r:l:T:")) != EOF)
+    while ((c = getopt(argc, argv, "hs:v:p:u:t:r:l:S:C:nT:a:j:q:Q:oR:N:b:d:")) != EOF)
     {
         switch (c)
         {
@@ -95,12 +107,48 @@ int main(int argc, char **argv)
             case 'l':
                 logfile = optarg;
                 break;
+            case 'S':
+                snaplen = atoi((char *) optarg);
+                break;
+            case 'C':
+                rotate = strtoul(optarg, 0, 10) * 1000000;
+                break;
+            case 'n':
+                logfmt = sr_pcap_ng;
+                break;
             case 'r':
                 rtable = optarg;
                 break;
             case 'T':
                 template = optarg;
                 break;
+            case 'a':
+                arpcache_sz = atoi((char *) optarg);
+                break;
+            case 'j':
+                workers = atoi((char *) optarg);
+                break;
+            case 'q':
+                arpq_req = atoi((char *) optarg);
+                break;
+            case 'Q':
+                arpq_total = atoi((char *) optarg);
+                break;
+            case 'o':
+                arpq_oldest = 1;
+                break;
+            case 'R':
+                arp_retry = atoi((char *) optarg);
+                break;
+            case 'b':
+                burst = atoi((char *) optarg);
+                break;
+            case 'N':
+                arp_neg = atoi((char *) optarg);
+                break;
+            case 'd':
+                sr_log_set_level(atoi((char *) optarg));
+                break;
         } /* switch */
     } /* -- while -- */
 
@@ -116,6 +164,13 @@ int main(int argc, char **argv)
         strncpy(sr.template, template, 30);
 
     sr.topo_id = topo;
+    sr.arpcache_sz = arpcache_sz;
+    sr.arpq_req_bytes = arpq_req;
+    sr.arpq_total_bytes = arpq_total;
+    sr.arpq_policy = arpq_oldest ? arpq_drop_oldest : arpq_drop_tail;
+    sr.arp_retry_ms = arp_retry;
+    sr.arp_neg_ms = arp_neg;
+    sr.burst = burst < SR_BURST_MAX ? burst : SR_BURST_MAX;
     strncpy(sr.host,host,32);
 
     if(! user )
@@ -126,8 +181,9 @@ int main(int argc, char **argv)
     /* -- set up file pointer for logging of raw packets -- */
     if(logfile != 0)
     {
-        sr.logfile = sr_dump_open(logfile,0,PACKET_DUMP_SIZE);
-        if(!sr.logfile)
+        sr.pcap = sr_pcap_open(logfile, logfmt,
+                               snaplen ? snaplen : PACKET_DUMP_SIZE, rotate);
+        if(!sr.pcap)
         {
             fprintf(stderr,"Error opening up dump file %s\n",
                     logfile);
@@ -159,8 +215,24 @@ int main(int argc, char **argv)
     /* call router init (for arp subsystem etc.) */
     sr_init(&sr);
 
-    /* -- whizbang main loop ;-) */
-    while( sr_read_from_server(&sr) == 1);
+    /* -- hand packets to forwarding workers if asked to -- */
+    if(workers > 0 && sr_pipeline_start(&sr, workers) != 0)
+    {
+        fprintf(stderr,"Error starting %d forwarding workers\n", workers);
+        return 1;
+    }
+
+    /* -- pick up changes to the routing table while running -- */
+    if(sr_rt_watch(&sr, rtable) != 0)
+    { fprintf(stderr,"Error watching routing table %s\n", rtable); }
+
+    /* -- whizbang main loop ;-) , quiescent between commands -- */
+    sr_qsbr_register(&sr.qsbr);
+    while( sr_read_from_server(&sr) == 1)
+    { sr_qsbr_quiescent(); }
+    sr_qsbr_unregister();
+
+    sr_pipeline_stop(&sr);
 
     sr_destroy_instance(&sr);
     return 0;
@@ -177,7 +249,20 @@ static void usage(char* argv0)
     printf("Format: %s [-h] [-v host] [-s server] [-p port] \n",argv0);
     printf("           [-T template_name] [-u username] \n");
     printf("           [-t topo id] [-r routing table] \n");
-    printf("           [-l log file] \n");
+    printf("           [-l log file] [-S log snap length] [-C log file MB] \n");
+    printf("           [-n log in pcapng, with interfaces and direction] \n");
+    printf("           [-a arp cache entries] \n");
+    printf("           [-j forwarding worker threads] \n");
+    printf("           [-b frames handled together, 1-%d, without -j] \n",
+            SR_BURST_MAX);
+    printf("           [-q ARP queue bytes per next hop] [-Q ARP queue bytes] \n");
+    printf("           [-o drop oldest queued frames, not newest] \n");
+    printf("           [-R ms between ARP requests, default %d] \n",
+            SR_ARPREQ_RETRY);
+    printf("           [-N ms a next hop that never answered ARP is down, "
+            "default %d] \n", SR_ARPNEG_TO);
+    printf("           [-d log level 0-3, 3 logs every packet] \n");
+    printf("   a server with a '/' in it is a Unix socket (sr_vns_server -U) \n");
     printf("   defaults server=%s port=%d host=%s  \n",
             DEFAULT_SERVER, DEFAULT_PORT, DEFAULT_HOST );
 } /* -- usage -- */
@@ -216,14 +301,24 @@ void sr_set_user(struct sr_instance* sr)
 
 static void sr_destroy_instance(struct sr_instance* sr)
 {
+    struct sr_pcap* pcap;
+
     /* REQUIRES */
     assert(sr);
 
-    if(sr->logfile)
+    /* -- the ARP thread still sends, so stop its logging first: every
+     *    sender reads sr->pcap online (sr_qsbr.h), wait until each has
+     *    been quiescent since it went -- */
+    if((pcap = __atomic_exchange_n(&sr->pcap, 0, __ATOMIC_ACQ_REL)))
     {
-        sr_dump_close(sr->logfile);
+        sr_qsbr_synchronize(&sr->qsbr);
+        sr_pcap_close(pcap);
     }
 
+    sr_print_pkt_stats(sr, stderr);
+    if(sr->rx_pool.objsize)
+    { sr_pool_destroy(&sr->rx_pool); }
+
     /*
     fprintf(stderr,"sr_destroy_instance leaking memory\n");
     */
@@ -246,61 +341,28 @@ static void sr_init_instance(struct sr_instance* sr)
     sr->host[0] = 0;
     sr->topo_id = 0;
     sr->if_list = 0;
+    sr->if_index = 0;
+    sr->if_stats = 0;
+    sr->if_count = 0;
+    memset(&sr->if_local, 0, sizeof(sr->if_local));
     sr->routing_table = 0;
-    sr->logfile = 0;
+    sr->fib = 0;
+    sr->dst = 0;
+    sr_qsbr_init(&sr->qsbr);
+    sr->arpcache_sz = 0;
+    sr->arpq_req_bytes = 0;
+    sr->arpq_total_bytes = 0;
+    sr->arpq_policy = arpq_drop_tail;
+    sr->arp_retry_ms = 0;
+    sr->arp_neg_ms = 0;
+    sr->pcap = 0;
+    sr->pipeline = 0;
+    sr->burst = 0;
+    memset(&sr->rx_pool, 0, sizeof(sr->rx_pool)); /* set up on first read */
+    memset(&sr->vns_rx, 0, sizeof(sr->vns_rx));
+    memset(&sr->stats, 0, sizeof(sr->stats));
 } /* -- sr_init_instance -- */
 
-/*-----------------------------------------------------------------------------
- * Method: sr_verify_routing_table()
- * Scope: Global
- *
- * make sure the routing table is consistent with the interface list by
- * verifying that all interfaces used in the routing table actually exist
- * in the hardware.
- *
- * RETURN VALUES:
- *
- *  0 on success
- *  something other than zero on error
- *
- *---------------------------------------------------------------------------*/
-
-int sr_verify_routing_table(struct sr_instance* sr)
-{
-    struct sr_rt* rt_walker = 0;
-    struct sr_if* if_walker = 0;
-    int ret = 0;
-
-    /* -- REQUIRES --*/
-    assert(sr);
-
-    if( (sr->if_list == 0) || (sr->routing_table == 0))
-    {
-        return 999; /* doh! */
-    }
-
-    rt_walker = sr->routing_table;
-
-    while(rt_walker)
-    {
-        /* -- check to see if interface exists -- */
-        if_walker = sr->if_list;
-        while(if_walker)
-        {
-            if( strncmp(if_walker->name,rt_walker->interface,sr_IFACE_NAMELEN)
-                    == 0)
-            { break; }
-            if_walker = if_walker->next;
-        }
-        if(if_walker == 0)
-        { ret++; } /* -- interface not found! -- */
-
-        rt_walker = rt_walker->next;
-    } /* -- while -- */
-
-    return ret;
-} /* -- sr_verify_routing_table -- */
-
 static void sr_load_rt_wrap(struct sr_instance* sr, char* rtable) {
     if(sr_load_rt(sr, rtable) != 0) {
         fprintf(stderr,"Error setting up routing table from file %s\n",
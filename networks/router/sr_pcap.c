@@ -0,0 +1,463 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pcap.c
+ *
+ * Description:
+ *
+ * Packet capture writer, see sr_pcap.h.
+ *
+ * The ring is a bounded multi producer queue: every slot carries a
+ * sequence number that says whose turn it is.  Slot i (mod SR_PCAP_SLOTS)
+ * is free for the logger that claims position i when its sequence is i,
+ * ready for the writer when it is i + 1, and free again for position
+ * i + SR_PCAP_SLOTS once the writer has stored that.
+ *
+ * pcapng blocks are written in host byte order, which the Section Header
+ * Block's byte order magic tells readers.  The logger cannot know the
+ * interface id of a frame (that is per file, and only the writer knows
+ * which file the frame lands in), so it leaves the name next to the
+ * record and the writer fills the id in.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <sys/uio.h>
+
+#include "sr_pcap.h"
+#include "sr_dumper.h"
+
+struct sr_pcap_slot
+{
+    unsigned long seq;
+    char          iface[SR_PCAP_IFNAME];
+    uint32_t      reclen;   /* bytes of the record that follows */
+    uint32_t      pad;
+};
+
+#define SR_PCAP_REC(slot) ((uint8_t*)((slot) + 1))
+
+/* -- pcapng block types and options -- */
+#define PCAPNG_SHB        0x0A0D0D0A
+#define PCAPNG_IDB        0x00000001
+#define PCAPNG_EPB        0x00000006
+#define PCAPNG_BOM        0x1A2B3C4D
+#define PCAPNG_OPT_END    0
+#define PCAPNG_IF_NAME    2
+#define PCAPNG_IF_TSRESOL 9
+#define PCAPNG_EPB_FLAGS  2
+
+#define PCAPNG_EPB_HDR    28   /* block header up to the packet data */
+#define PCAPNG_EPB_TAIL   16   /* epb_flags, end of options, length */
+#define PCAPNG_PAD(n)     (((n) + 3) & ~3u)
+
+#define SR_PCAP_SLOT(pc, pos) \
+    ((struct sr_pcap_slot*)((pc)->ring + ((pos) & (SR_PCAP_SLOTS - 1)) * (pc)->stride))
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcap_write(..)
+ * Scope: Local
+ *
+ * Write all of iov, picking up after short writes.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_pcap_write(struct sr_pcap* pc, struct iovec* iov, int niov)
+{
+    ssize_t n;
+
+    while(niov > 0)
+    {
+        if((n = writev(pc->fd, iov, niov)) == -1)
+        {
+            if(errno == EINTR)
+            { continue; }
+            return -1;
+        }
+        pc->file_bytes += n;
+        pc->bytes      += n;
+
+        while(niov > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if(niov > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+} /* -- sr_pcap_write -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcap_start_file(..)
+ * Scope: Local
+ *
+ * Open the next file of the capture (name, then name.1, name.2, ...) and
+ * write its header.  "-" is stdout and never rotates.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_pcap_start_file(struct sr_pcap* pc)
+{
+    struct pcap_file_header hdr;
+    uint32_t                shb[7];
+    struct iovec            iov;
+    char*                   path = pc->name;
+
+    if(pc->fd > STDOUT_FILENO)
+    { close(pc->fd); }
+
+    if(strcmp(pc->name, "-") == 0)
+    { pc->fd = STDOUT_FILENO; }
+    else
+    {
+        if(pc->files > 0)
+        {
+            if((path = malloc(strlen(pc->name) + 16)) == 0)
+            { return -1; }
+            sprintf(path, "%s.%u", pc->name, pc->files);
+        }
+        pc->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(pc->fd == -1)
+        { fprintf(stderr, "sr_pcap: can't open %s\n", path); }
+        if(path != pc->name)
+        { free(path); }
+        if(pc->fd == -1)
+        { return -1; }
+    }
+    pc->files++;
+    pc->file_bytes = 0;
+    pc->nifaces    = 0;
+
+    if(pc->fmt == sr_pcap_ng)
+    {
+        /* -- Section Header Block, version 1.0, length unknown -- */
+        shb[0] = PCAPNG_SHB;
+        shb[1] = sizeof(shb);
+        shb[2] = PCAPNG_BOM;
+        shb[3] = 1 | 0 << 16;
+        shb[4] = 0xffffffff;
+        shb[5] = 0xffffffff;
+        shb[6] = sizeof(shb);
+        iov.iov_base = shb;
+        iov.iov_len  = sizeof(shb);
+        return sr_pcap_write(pc, &iov, 1);
+    }
+
+    hdr.magic         = TCPDUMP_MAGIC;
+    hdr.version_major = PCAP_VERSION_MAJOR;
+    hdr.version_minor = PCAP_VERSION_MINOR;
+    hdr.thiszone      = 0;
+    hdr.sigfigs       = 0;
+    hdr.snaplen       = pc->snaplen;
+    hdr.linktype      = LINKTYPE_ETHERNET;
+
+    iov.iov_base = &hdr;
+    iov.iov_len  = sizeof(hdr);
+    return sr_pcap_write(pc, &iov, 1);
+} /* -- sr_pcap_start_file -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcap_iface(..)
+ * Scope: Local
+ *
+ * pcapng interface id of name in the current file.  An interface seen
+ * for the first time gets an Interface Description Block, added to iov
+ * so it is written ahead of the frame.  Past SR_PCAP_IFACES interfaces
+ * frames are filed under the last one.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint32_t sr_pcap_iface(struct sr_pcap* pc, const char* name,
+                              struct iovec* iov, int* niov)
+{
+    uint8_t*     idb;
+    uint32_t     w;
+    uint16_t     h;
+    unsigned int i, off, nlen;
+
+    for(i = 0; i < pc->nifaces; i++)
+    {
+        if(strncmp(pc->ifaces[i], name, SR_PCAP_IFNAME) == 0)
+        { return i; }
+    }
+    if(pc->nifaces == SR_PCAP_IFACES)
+    { return SR_PCAP_IFACES - 1; }
+
+    i = pc->nifaces++;
+    strncpy(pc->ifaces[i], name, SR_PCAP_IFNAME);
+    for(nlen = 0; nlen < SR_PCAP_IFNAME && name[nlen]; nlen++);
+
+    idb = pc->idb[i];
+    memset(idb, 0, SR_PCAP_IDB_MAX);
+    w = PCAPNG_IDB;                 memcpy(idb, &w, 4);
+    h = LINKTYPE_ETHERNET;          memcpy(idb + 8, &h, 2);
+    w = pc->snaplen;                memcpy(idb + 12, &w, 4);
+    off = 16;
+    h = PCAPNG_IF_NAME;             memcpy(idb + off, &h, 2);
+    h = nlen;                       memcpy(idb + off + 2, &h, 2);
+    memcpy(idb + off + 4, name, nlen);
+    off += 4 + PCAPNG_PAD(nlen);
+    h = PCAPNG_IF_TSRESOL;          memcpy(idb + off, &h, 2);
+    h = 1;                          memcpy(idb + off + 2, &h, 2);
+    idb[off + 4] = 9;               /* -- 10^-9 s -- */
+    off += 8;
+    off += 4;                       /* -- end of options, zero -- */
+    w = off + 4;
+    memcpy(idb + 4, &w, 4);
+    memcpy(idb + off, &w, 4);
+
+    iov[*niov].iov_base = idb;
+    iov[*niov].iov_len  = w;
+    (*niov)++;
+    return i;
+} /* -- sr_pcap_iface -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcap_writer(..)
+ * Scope: Local
+ *
+ * Writer thread: take runs of ready slots, write them, free them.  Only
+ * exits once stop is set and the ring is empty.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_pcap_ready(struct sr_pcap* pc, unsigned long pos)
+{
+    return __atomic_load_n(&SR_PCAP_SLOT(pc, pos)->seq, __ATOMIC_ACQUIRE)
+           == pos + 1;
+}
+
+static void* sr_pcap_writer(void* arg)
+{
+    struct sr_pcap*      pc = arg;
+    struct sr_pcap_slot* slot;
+    struct iovec         iov[2 * SR_PCAP_IOV];
+    struct timespec      idle;
+    uint32_t             id;
+    int                  n, niov, i, failed = 0;
+
+    idle.tv_sec  = 0;
+    idle.tv_nsec = SR_PCAP_IDLE_US * 1000;
+
+    while(1)
+    {
+        if(!sr_pcap_ready(pc, pc->head))
+        {
+            if(__atomic_load_n(&pc->stop, __ATOMIC_ACQUIRE) &&
+               !sr_pcap_ready(pc, pc->head))
+            { break; }
+            nanosleep(&idle, 0);
+            continue;
+        }
+
+        if(!failed && pc->rotate && pc->file_bytes >= pc->rotate &&
+           sr_pcap_start_file(pc) != 0)
+        { failed = 1; }
+
+        for(n = niov = 0; n < SR_PCAP_IOV && sr_pcap_ready(pc, pc->head + n); n++)
+        {
+            slot = SR_PCAP_SLOT(pc, pc->head + n);
+            if(pc->fmt == sr_pcap_ng)
+            {
+                id = sr_pcap_iface(pc, slot->iface, iov, &niov);
+                memcpy(SR_PCAP_REC(slot) + 8, &id, 4);
+            }
+            iov[niov].iov_base = SR_PCAP_REC(slot);
+            iov[niov].iov_len  = slot->reclen;
+            niov++;
+        }
+
+        if(!failed && sr_pcap_write(pc, iov, niov) != 0)
+        {
+            perror("writev(..):sr_pcap.c::sr_pcap_writer");
+            failed = 1; /* -- keep draining so loggers see free slots -- */
+        }
+
+        for(i = 0; i < n; i++)
+        {
+            slot = SR_PCAP_SLOT(pc, pc->head + i);
+            __atomic_store_n(&slot->seq, pc->head + i + SR_PCAP_SLOTS,
+                             __ATOMIC_RELEASE);
+        }
+        pc->head += n;
+    }
+    return 0;
+} /* -- sr_pcap_writer -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcap_open(..)
+ * Scope: Global
+ *
+ * Start capturing to name in format fmt, keeping at most snaplen bytes of
+ * each frame and starting a new file every rotate bytes (0 for never).
+ * Returns 0 if the file or the writer thread cannot be set up.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_pcap* sr_pcap_open(const char* name, enum sr_pcap_fmt fmt,
+                             unsigned int snaplen, unsigned long rotate)
+{
+    struct sr_pcap* pc;
+    unsigned long   i;
+    size_t          rec;
+
+    /* -- REQUIRES -- */
+    assert(name);
+    assert(snaplen > 0);
+
+    if((pc = calloc(1, sizeof(struct sr_pcap))) == 0)
+    { return 0; }
+    pc->fd      = -1;
+    pc->fmt     = fmt;
+    pc->snaplen = snaplen;
+    pc->rotate  = strcmp(name, "-") == 0 ? 0 : rotate;
+    if(fmt == sr_pcap_ng)
+    { rec = PCAPNG_EPB_HDR + PCAPNG_PAD(snaplen) + PCAPNG_EPB_TAIL; }
+    else
+    { rec = sizeof(struct pcap_sf_pkthdr) + snaplen; }
+    pc->stride  = (sizeof(struct sr_pcap_slot) + rec + 15) & ~(size_t)15;
+    pc->name    = malloc(strlen(name) + 1);
+    pc->ring    = malloc(pc->stride * SR_PCAP_SLOTS);
+    if(!pc->name || !pc->ring)
+    { goto fail; }
+    strcpy(pc->name, name);
+
+    for(i = 0; i < SR_PCAP_SLOTS; i++)
+    { SR_PCAP_SLOT(pc, i)->seq = i; }
+
+    if(sr_pcap_start_file(pc) != 0)
+    { goto fail; }
+    if(pthread_create(&pc->writer, 0, sr_pcap_writer, pc) != 0)
+    { goto fail; }
+    return pc;
+
+fail:
+    if(pc->fd > STDOUT_FILENO)
+    { close(pc->fd); }
+    free(pc->ring);
+    free(pc->name);
+    free(pc);
+    return 0;
+} /* -- sr_pcap_open -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcap_log(..)
+ * Scope: Global
+ *
+ * Capture a frame of len bytes that went dir on interface iface.  Never
+ * blocks; if the writer has fallen a whole ring behind the frame is only
+ * counted.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pcap_log(struct sr_pcap* pc, const uint8_t* buf, unsigned int len,
+                 const char* iface, enum sr_pcap_dir dir)
+{
+    struct sr_pcap_slot*   slot;
+    struct pcap_sf_pkthdr* hdr;
+    struct timespec        now;
+    unsigned long          pos, seq;
+    unsigned int           caplen, padded;
+    uint64_t               ns;
+    uint32_t*              w;
+
+    pos = __atomic_load_n(&pc->tail, __ATOMIC_RELAXED);
+    while(1)
+    {
+        slot = SR_PCAP_SLOT(pc, pos);
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if(seq == pos)
+        {
+            if(__atomic_compare_exchange_n(&pc->tail, &pos, pos + 1, 1,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            { break; }
+        }
+        else if((long)(seq - pos) < 0)
+        {
+            /* -- still holds the frame from a lap ago -- */
+            __atomic_fetch_add(&pc->overflows, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+        { pos = __atomic_load_n(&pc->tail, __ATOMIC_RELAXED); }
+    }
+
+    caplen = len < pc->snaplen ? len : pc->snaplen;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    if(pc->fmt == sr_pcap_ng)
+    {
+        /* -- Enhanced Packet Block, interface id filled in by the writer -- */
+        strncpy(slot->iface, iface ? iface : "", SR_PCAP_IFNAME);
+        padded = PCAPNG_PAD(caplen);
+        ns     = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+        w      = (uint32_t*)SR_PCAP_REC(slot);
+        w[0]   = PCAPNG_EPB;
+        w[1]   = PCAPNG_EPB_HDR + padded + PCAPNG_EPB_TAIL;
+        w[3]   = (uint32_t)(ns >> 32);
+        w[4]   = (uint32_t)ns;
+        w[5]   = caplen;
+        w[6]   = len;
+        memcpy(w + 7, buf, caplen);
+        memset((uint8_t*)(w + 7) + caplen, 0, padded - caplen);
+        w      = (uint32_t*)((uint8_t*)(w + 7) + padded);
+        w[0]   = PCAPNG_EPB_FLAGS | 4 << 16;
+        w[1]   = dir;
+        w[2]   = PCAPNG_OPT_END;
+        w[3]   = PCAPNG_EPB_HDR + padded + PCAPNG_EPB_TAIL;
+        slot->reclen = w[3];
+    }
+    else
+    {
+        hdr = (struct pcap_sf_pkthdr*)SR_PCAP_REC(slot);
+        hdr->ts.tv_sec  = now.tv_sec;
+        hdr->ts.tv_usec = now.tv_nsec / 1000;
+        hdr->caplen     = caplen;
+        hdr->len        = len;
+        memcpy(hdr + 1, buf, caplen);
+        slot->reclen    = sizeof(struct pcap_sf_pkthdr) + caplen;
+    }
+
+    __atomic_fetch_add(&pc->captured, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+} /* -- sr_pcap_log -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcap_close(..)
+ * Scope: Global
+ *
+ * Write out whatever is still in the ring, close the capture and report
+ * on it.  Nothing may be logging any more.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pcap_close(struct sr_pcap* pc)
+{
+    if(!pc)
+    { return; }
+
+    __atomic_store_n(&pc->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(pc->writer, 0);
+
+    if(pc->fd > STDOUT_FILENO)
+    { close(pc->fd); }
+
+    fprintf(stderr, "pcap %s: %lu frames captured, %lu overflowed, "
+            "%lu bytes in %u file(s)\n", pc->name, pc->captured,
+            pc->overflows, pc->bytes, pc->files);
+
+    free(pc->ring);
+    free(pc->name);
+    free(pc);
+} /* -- sr_pcap_close -- */
@@ -0,0 +1,95 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pcap.h
+ *
+ * Description:
+ *
+ * Packet capture (-l) off the forwarding path.
+ *
+ * Threads that log a frame copy up to snaplen bytes of it, with its
+ * timestamp, into a slot of a fixed ring and go on; claiming a slot is a
+ * single compare and swap, so any number of threads can log at once
+ * without a lock.  When the ring is full the frame is counted as an
+ * overflow and not captured: logging never blocks forwarding.
+ *
+ * A writer thread takes finished slots off the ring in order and hands
+ * runs of them to the kernel with one writev().  Each slot holds a frame
+ * exactly as it goes into the file (record header, then data), so nothing
+ * is copied again.  With a rotation size the capture moves on to name.1,
+ * name.2, ... once a file reaches it; each file is a complete capture.
+ *
+ * Two formats: classic pcap (microsecond timestamps, no interfaces) and
+ * pcapng (-n), where every frame is an Enhanced Packet Block with a
+ * nanosecond timestamp, the interface it was received or sent on and its
+ * direction.  The writer describes each interface in a file the first
+ * time a frame from it is written there.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_PCAP_H
+#define sr_PCAP_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <pthread.h>
+
+#define SR_PCAP_SLOTS   4096  /* ring size, a power of two */
+#define SR_PCAP_IOV     256   /* frames per writev() */
+#define SR_PCAP_IDLE_US 100   /* writer sleep with nothing to write */
+#define SR_PCAP_IFNAME  16    /* interface name kept per frame */
+#define SR_PCAP_IFACES  32    /* interfaces described per pcapng file */
+#define SR_PCAP_IDB_MAX 64    /* bytes in one Interface Description Block */
+
+enum sr_pcap_fmt
+{
+    sr_pcap_classic = 0,
+    sr_pcap_ng
+};
+
+enum sr_pcap_dir
+{
+    sr_pcap_in  = 1, /* values are the pcapng epb_flags direction bits */
+    sr_pcap_out = 2
+};
+
+struct sr_pcap
+{
+    char*             name;
+    enum sr_pcap_fmt  fmt;
+    int               fd;
+    unsigned int      snaplen;
+    unsigned long     rotate;      /* bytes per file, 0 for one file */
+    unsigned int      files;       /* files started so far */
+    unsigned long     file_bytes;  /* written to the current file */
+
+    uint8_t*          ring;
+    size_t            stride;      /* bytes per slot */
+    unsigned long     head;        /* next slot the writer takes */
+    unsigned long     tail;        /* next slot a logger claims */
+
+    pthread_t         writer;
+    int               stop;
+
+    /* -- writer only: interfaces described in the current pcapng file -- */
+    unsigned int      nifaces;
+    char              ifaces[SR_PCAP_IFACES][SR_PCAP_IFNAME];
+    uint8_t           idb[SR_PCAP_IFACES][SR_PCAP_IDB_MAX];
+
+    unsigned long     captured;
+    unsigned long     overflows;
+    unsigned long     bytes;       /* written, over all files */
+};
+
+struct sr_pcap* sr_pcap_open(const char* name, enum sr_pcap_fmt fmt,
+                             unsigned int snaplen, unsigned long rotate);
+void            sr_pcap_log(struct sr_pcap* pc, const uint8_t* buf,
+                            unsigned int len, const char* iface,
+                            enum sr_pcap_dir dir);
+void            sr_pcap_close(struct sr_pcap* pc);
+
+#endif  /* --  sr_PCAP_H -- */
@@ -0,0 +1,272 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pipeline.c
+ *
+ * Description:
+ *
+ * Reader to worker dispatch for multi-worker forwarding, see sr_pipeline.h.
+ *
+ * A worker that finds its ring empty polls SR_PIPE_SPIN times and then
+ * sleeps on its condition variable.  The worker announces it is going to
+ * sleep and re-checks the ring; the reader publishes a frame and then checks
+ * for a sleeper, with a full fence on both sides, so a wakeup cannot be lost.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <sched.h>
+
+#include <netinet/in.h>
+
+#include "sr_pipeline.h"
+#include "sr_router.h"
+#include "sr_protocol.h"
+#include "sr_utils.h"
+
+/*---------------------------------------------------------------------
+ * Method: sr_pipe_flow_hash(..)
+ * Scope: Local
+ *
+ * Hash of what identifies a flow: addresses and protocol for IP, the
+ * two protocol addresses for ARP.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint32_t sr_pipe_flow_hash(uint8_t* packet, unsigned int len)
+{
+    uint32_t h = 0;
+
+    if(len >= sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) &&
+       ethertype(packet) == ethertype_ip)
+    {
+        sr_ip_hdr_t* iphdr = (sr_ip_hdr_t*)(packet + sizeof(sr_ethernet_hdr_t));
+        h = (ntohl(iphdr->ip_src) * 0x9e3779b1u) ^ ntohl(iphdr->ip_dst) ^ iphdr->ip_p;
+    }
+    else if(len >= sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t) &&
+            ethertype(packet) == ethertype_arp)
+    {
+        sr_arp_hdr_t* arp_hdr = (sr_arp_hdr_t*)(packet + sizeof(sr_ethernet_hdr_t));
+        h = (ntohl(arp_hdr->ar_sip) * 0x9e3779b1u) ^ ntohl(arp_hdr->ar_tip);
+    }
+
+    /* murmur3 finaliser, every input bit reaches the low bits */
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    return h ^ (h >> 16);
+} /* -- sr_pipe_flow_hash -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pipe_worker_main(..)
+ * Scope: Local
+ *
+ * Worker thread: run sr_handlepacket_if() on each frame in the ring, a burst
+ * at a time, until told to stop and the ring is drained.
+ *
+ *---------------------------------------------------------------------*/
+
+static void* sr_pipe_worker_main(void* arg)
+{
+    struct sr_pipe_worker* w = arg;
+    struct sr_pipeline*    p = w->sr->pipeline;
+    struct sr_pipe_item*   item;
+    unsigned int           head = w->head, tail, n;
+    int                    idle = 0;
+
+    sr_txbatch_use(&w->tx);
+    sr_qsbr_register(&w->sr->qsbr);
+
+    while(1)
+    {
+        /* -- between bursts no routes are held, see sr_qsbr.h -- */
+        sr_qsbr_quiescent();
+
+        tail = __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+        if(head == tail)
+        {
+            if(__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE))
+            { break; }
+            if(++idle < SR_PIPE_SPIN)
+            {
+                sched_yield();
+                continue;
+            }
+
+            pthread_mutex_lock(&w->lock);
+            __atomic_store_n(&w->sleeping, 1, __ATOMIC_SEQ_CST);
+            if(head == __atomic_load_n(&w->tail, __ATOMIC_SEQ_CST) &&
+               !__atomic_load_n(&p->stop, __ATOMIC_SEQ_CST))
+            {
+                sr_qsbr_offline();
+                pthread_cond_wait(&w->wake, &w->lock);
+                sr_qsbr_online();
+            }
+            __atomic_store_n(&w->sleeping, 0, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&w->lock);
+            idle = 0;
+            continue;
+        }
+
+        idle = 0;
+        for(n = head; n != tail && n - head < SR_PIPE_BURST; n++)
+        {
+            item = &w->ring[n & (SR_PIPE_RING_SZ - 1)];
+            w->tx.frame = item->packet;
+            sr_handlepacket_if(w->sr, item->packet, item->len,
+                               item->if_index);
+        }
+
+        /* -- the batch points into the chunks, release them after -- */
+        sr_txbatch_flush(w->sr, &w->tx);
+        w->packets += n - head;
+        for(; head != n; head++)
+        { sr_vns_rx_release(w->sr, w->ring[head & (SR_PIPE_RING_SZ - 1)].chunk); }
+
+        __atomic_store_n(&w->head, head, __ATOMIC_RELEASE);
+    }
+
+    sr_qsbr_unregister();
+    sr_txbatch_use(0);
+    return 0;
+} /* -- sr_pipe_worker_main -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pipeline_start(..)
+ * Scope: Global
+ *
+ * Start nworkers forwarding threads.  From here on VNSPACKET frames are
+ * handed to sr_pipeline_dispatch() instead of sr_handlepacket_if().
+ * Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_pipeline_start(struct sr_instance* sr, int nworkers)
+{
+    struct sr_pipeline* p;
+    void* mem;
+    int   i;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+
+    if(nworkers < 1 || nworkers > SR_PIPE_MAX_WORKERS)
+    {
+        fprintf(stderr, "sr_pipeline: need 1 to %d workers\n",
+                SR_PIPE_MAX_WORKERS);
+        return -1;
+    }
+
+    if((p = calloc(1, sizeof(struct sr_pipeline))) == 0 ||
+       posix_memalign(&mem, 64, nworkers * sizeof(struct sr_pipe_worker)) != 0)
+    {
+        free(p);
+        return -1;
+    }
+
+    memset(mem, 0, nworkers * sizeof(struct sr_pipe_worker));
+    p->nworkers = nworkers;
+    p->workers  = mem;
+    sr->pipeline = p;
+
+    for(i = 0; i < nworkers; i++)
+    {
+        struct sr_pipe_worker* w = &p->workers[i];
+        w->sr = sr;
+        pthread_mutex_init(&w->lock, 0);
+        pthread_cond_init(&w->wake, 0);
+        if(pthread_create(&w->thread, &(sr->attr), sr_pipe_worker_main, w) != 0)
+        {
+            perror("pthread_create(..):sr_pipeline_start");
+            p->nworkers = i;
+            sr_pipeline_stop(sr);
+            return -1;
+        }
+    }
+
+    return 0;
+} /* -- sr_pipeline_start -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pipeline_dispatch(..)
+ * Scope: Global
+ *
+ * Queue a frame for the worker owning its flow.  Takes a reference to
+ * chunk, which packet points into.  If the worker is a full ring
+ * behind, the reader waits for it, which pushes back on the server
+ * connection rather than dropping.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pipeline_dispatch(struct sr_instance* sr, struct sr_rxchunk* chunk,
+                          uint8_t* packet, unsigned int len,
+                          unsigned int if_index)
+{
+    struct sr_pipeline*    p = sr->pipeline;
+    struct sr_pipe_worker* w;
+    struct sr_pipe_item*   item;
+    unsigned int           tail;
+
+    w    = &p->workers[sr_pipe_flow_hash(packet, len) % p->nworkers];
+    tail = w->tail;
+
+    if(tail - __atomic_load_n(&w->head, __ATOMIC_ACQUIRE) == SR_PIPE_RING_SZ)
+    {
+        w->stalls++;
+        while(tail - __atomic_load_n(&w->head, __ATOMIC_ACQUIRE) == SR_PIPE_RING_SZ)
+        { sched_yield(); }
+    }
+
+    sr_vns_rx_hold(chunk);
+    item = &w->ring[tail & (SR_PIPE_RING_SZ - 1)];
+    item->chunk  = chunk;
+    item->packet = packet;
+    item->len    = len;
+    item->if_index = if_index;
+    __atomic_store_n(&w->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(&w->sleeping, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+    }
+} /* -- sr_pipeline_dispatch -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pipeline_stop(..)
+ * Scope: Global
+ *
+ * Let the workers drain their rings, join them and go back to handling
+ * packets inline.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pipeline_stop(struct sr_instance* sr)
+{
+    struct sr_pipeline* p = sr->pipeline;
+    int i;
+
+    if(!p)
+    { return; }
+
+    __atomic_store_n(&p->stop, 1, __ATOMIC_SEQ_CST);
+    for(i = 0; i < p->nworkers; i++)
+    {
+        struct sr_pipe_worker* w = &p->workers[i];
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, 0);
+        fprintf(stderr, "worker %d: %lu packets, %lu ring full stalls\n",
+                i, w->packets, w->stalls);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->wake);
+    }
+
+    sr->pipeline = 0;
+    free(p->workers);
+    free(p);
+} /* -- sr_pipeline_stop -- */
@@ -0,0 +1,84 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pipeline.h
+ *
+ * Description:
+ *
+ * Optional multi-worker forwarding (sr -j N).  The thread reading from the
+ * VNS server frames commands as before, but instead of running
+ * sr_handlepacket() itself it hashes each frame's flow onto one of N worker
+ * threads and pushes it into that worker's single producer / single
+ * consumer ring.  A flow always lands on the same worker and a ring is
+ * FIFO, so packets of a flow leave in the order they arrived.  Writes to
+ * the server socket are serialised in sr_send_packet().
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_PIPELINE_H
+#define sr_PIPELINE_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <pthread.h>
+
+#include "sr_vns_io.h"
+
+struct sr_instance;
+
+#define SR_PIPE_MAX_WORKERS 64
+#define SR_PIPE_RING_SZ     1024 /* frames per worker, power of two */
+#define SR_PIPE_SPIN        64   /* empty polls before a worker sleeps */
+#define SR_PIPE_BURST       32   /* frames handled per send batch */
+
+struct sr_pipe_item
+{
+    struct sr_rxchunk* chunk;  /* holds a reference, dropped by the worker */
+    uint8_t*     packet;  /* ethernet frame inside chunk */
+    unsigned int len;
+    unsigned int if_index; /* receiving interface, see sr_if_by_index */
+};
+
+/* ----------------------------------------------------------------------------
+ * struct sr_pipe_worker
+ *
+ * head is only written by the worker and tail only by the reader; they sit
+ * on separate cache lines so the two sides do not false share.  A worker
+ * handles up to SR_PIPE_BURST frames, sends what they produced with one
+ * writev() and only then releases their chunks and the ring slots.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_pipe_worker
+{
+    struct sr_pipe_item ring[SR_PIPE_RING_SZ];
+    unsigned int head __attribute__ ((aligned (64)));
+    unsigned long packets;
+    unsigned int tail __attribute__ ((aligned (64)));
+    unsigned long stalls;     /* pushes that found the ring full */
+    int sleeping __attribute__ ((aligned (64)));
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    pthread_t thread;
+    struct sr_instance* sr;
+    struct sr_txbatch tx;
+};
+
+struct sr_pipeline
+{
+    int nworkers;
+    int stop;
+    struct sr_pipe_worker* workers;
+};
+
+int  sr_pipeline_start(struct sr_instance* sr, int nworkers);
+void sr_pipeline_dispatch(struct sr_instance* sr, struct sr_rxchunk* chunk,
+                          uint8_t* packet, unsigned int len,
+                          unsigned int if_index);
+void sr_pipeline_stop(struct sr_instance* sr);
+
+#endif  /* --  sr_PIPELINE_H -- */
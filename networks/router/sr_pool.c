@@ -0,0 +1,161 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pool.c
+ *
+ * Description:
+ *
+ * Fixed size object pool, see sr_pool.h.  Each slab starts with a 16 byte
+ * header linking it into the pool's slab list, followed by per_slab
+ * objects.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "sr_pool.h"
+
+#define SR_POOL_ALIGN 16
+
+/*---------------------------------------------------------------------
+ * Method: sr_pool_init(..)
+ * Scope: Global
+ *
+ * Set up an empty pool of objsize byte objects, growing per_slab objects
+ * at a time.  Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_pool_init(struct sr_pool* pool, const char* name, size_t objsize,
+                 unsigned int per_slab)
+{
+    /* -- REQUIRES -- */
+    assert(pool);
+    assert(per_slab > 0);
+
+    memset(pool, 0, sizeof(struct sr_pool));
+    if(objsize < sizeof(void*))
+    { objsize = sizeof(void*); }
+    pool->name     = name;
+    pool->objsize  = (objsize + SR_POOL_ALIGN - 1) & ~(size_t)(SR_POOL_ALIGN - 1);
+    pool->per_slab = per_slab;
+
+    return pthread_mutex_init(&pool->lock, 0);
+} /* -- sr_pool_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pool_destroy(..)
+ * Scope: Global
+ *
+ * Give every slab back to the heap.  Outstanding objects become invalid.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pool_destroy(struct sr_pool* pool)
+{
+    void* slab;
+
+    while((slab = pool->slabs) != 0)
+    {
+        pool->slabs = *(void**)slab;
+        free(slab);
+    }
+    pool->free_list = 0;
+    pthread_mutex_destroy(&pool->lock);
+} /* -- sr_pool_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pool_grow(..)
+ * Scope: Local
+ *
+ * Add a slab worth of objects to the free list.  Caller holds the lock.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_pool_grow(struct sr_pool* pool)
+{
+    char*        slab;
+    char*        obj;
+    unsigned int i;
+
+    slab = malloc(SR_POOL_ALIGN + pool->objsize * pool->per_slab);
+    if(!slab)
+    { return -1; }
+
+    *(void**)slab = pool->slabs;
+    pool->slabs   = slab;
+    pool->slab_count++;
+
+    obj = slab + SR_POOL_ALIGN;
+    for(i = 0; i < pool->per_slab; i++, obj += pool->objsize)
+    {
+        *(void**)obj    = pool->free_list;
+        pool->free_list = obj;
+    }
+    return 0;
+} /* -- sr_pool_grow -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pool_get(..)
+ * Scope: Global
+ *
+ * Take an object (uninitialised) from the pool, 0 if out of memory.
+ *
+ *---------------------------------------------------------------------*/
+
+void* sr_pool_get(struct sr_pool* pool)
+{
+    void* obj = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    if(pool->free_list || sr_pool_grow(pool) == 0)
+    {
+        obj = pool->free_list;
+        pool->free_list = *(void**)obj;
+        pool->gets++;
+        if(++pool->in_use > pool->peak)
+        { pool->peak = pool->in_use; }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return obj;
+} /* -- sr_pool_get -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pool_put(..)
+ * Scope: Global
+ *
+ * Return an object taken from the same pool.  0 is ignored.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pool_put(struct sr_pool* pool, void* obj)
+{
+    if(!obj)
+    { return; }
+
+    pthread_mutex_lock(&pool->lock);
+    *(void**)obj    = pool->free_list;
+    pool->free_list = obj;
+    pool->in_use--;
+    pthread_mutex_unlock(&pool->lock);
+} /* -- sr_pool_put -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pool_dump(..)
+ * Scope: Global
+ *
+ * One line of allocation statistics.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pool_dump(struct sr_pool* pool, FILE* fp)
+{
+    pthread_mutex_lock(&pool->lock);
+    fprintf(fp, "%-10s %6lu B  slabs %4lu (%lu objs)  in use %6lu  peak %6lu  gets %lu\n",
+            pool->name ? pool->name : "?", (unsigned long)pool->objsize,
+            pool->slab_count, pool->slab_count * pool->per_slab,
+            pool->in_use, pool->peak, pool->gets);
+    pthread_mutex_unlock(&pool->lock);
+} /* -- sr_pool_dump -- */
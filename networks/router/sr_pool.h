@@ -0,0 +1,42 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pool.h
+ *
+ * Description:
+ *
+ * Fixed size object pool.  Objects are carved out of slabs taken from the
+ * heap on demand and recycled through a free list, so once a pool has
+ * grown to the working set, getting and putting objects never touches
+ * malloc.  Pools are thread safe.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_POOL_H
+#define sr_POOL_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+struct sr_pool
+{
+    const char*     name;
+    size_t          objsize;    /* rounded up to a multiple of 16 */
+    unsigned int    per_slab;
+    void*           free_list;  /* linked through the first word */
+    void*           slabs;      /* linked through the first word */
+    pthread_mutex_t lock;
+
+    unsigned long   slab_count; /* heap allocations made */
+    unsigned long   gets;
+    unsigned long   in_use;
+    unsigned long   peak;
+};
+
+int   sr_pool_init(struct sr_pool* pool, const char* name, size_t objsize,
+                   unsigned int per_slab);
+void  sr_pool_destroy(struct sr_pool* pool);
+void* sr_pool_get(struct sr_pool* pool);
+void  sr_pool_put(struct sr_pool* pool, void* obj);
+void  sr_pool_dump(struct sr_pool* pool, FILE* fp);
+
+#endif  /* --  sr_POOL_H -- */
@@ -0,0 +1,176 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_qsbr.c
+ *
+ * Description:
+ *
+ * Quiescent state based reclamation, see sr_qsbr.h.
+ *
+ * A writer bumps the epoch and waits for each thread's seen to reach it.
+ * Offline is SR_QSBR_OFFLINE, above any epoch, so one comparison covers
+ * both.  Going online is the one place a reader needs a full fence: its
+ * store to seen and the writer's store of the new table must not both be
+ * missed by the other side.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "sr_qsbr.h"
+
+/* -- the calling thread's record, 0 if it has not registered -- */
+static __thread struct sr_qsbr_thread* sr_qsbr_self;
+
+/*---------------------------------------------------------------------
+ * Method: sr_qsbr_init(..)
+ * Scope: Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_qsbr_init(struct sr_qsbr* q)
+{
+    memset(q, 0, sizeof(struct sr_qsbr));
+} /* -- sr_qsbr_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_qsbr_register(..)
+ * Scope: Global
+ *
+ * Make the calling thread a reader of q's tables, online.  A thread
+ * registers with one sr_qsbr at a time.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_qsbr_register(struct sr_qsbr* q)
+{
+    struct sr_qsbr_thread* t;
+    int                    unused = 0;
+
+    assert(!sr_qsbr_self);
+
+    /* -- reuse a record a thread has given up, else add one -- */
+    for(t = __atomic_load_n(&q->threads, __ATOMIC_ACQUIRE); t; t = t->next)
+    {
+        if(__atomic_compare_exchange_n(&t->in_use, &unused, 1, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        { break; }
+        unused = 0;
+    }
+    if(!t)
+    {
+        if(posix_memalign((void**)&t, 64, sizeof(struct sr_qsbr_thread)) != 0)
+        { assert(0); }
+        t->seen   = SR_QSBR_OFFLINE;
+        t->in_use = 1;
+        t->q      = q;
+        t->next   = __atomic_load_n(&q->threads, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&q->threads, &t->next, t, 0,
+                                           __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        { ; }
+    }
+
+    sr_qsbr_self = t;
+    sr_qsbr_online();
+} /* -- sr_qsbr_register -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_qsbr_unregister()
+ * Scope: Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_qsbr_unregister(void)
+{
+    struct sr_qsbr_thread* t = sr_qsbr_self;
+
+    if(!t)
+    { return; }
+    sr_qsbr_offline();
+    sr_qsbr_self = 0;
+    __atomic_store_n(&t->in_use, 0, __ATOMIC_RELEASE);
+} /* -- sr_qsbr_unregister -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_qsbr_quiescent()
+ * Scope: Global
+ *
+ * The calling thread, which is online, holds no pointers into the
+ * tables.  Nothing if it has not registered.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_qsbr_quiescent(void)
+{
+    struct sr_qsbr_thread* t = sr_qsbr_self;
+    unsigned long          epoch;
+
+    if(!t)
+    { return; }
+    epoch = __atomic_load_n(&t->q->epoch, __ATOMIC_ACQUIRE);
+    if(t->seen != epoch)
+    { __atomic_store_n(&t->seen, epoch, __ATOMIC_RELEASE); }
+} /* -- sr_qsbr_quiescent -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_qsbr_offline()
+ * Scope: Global
+ *
+ * The calling thread stops reading the tables, e.g. before it blocks.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_qsbr_offline(void)
+{
+    struct sr_qsbr_thread* t = sr_qsbr_self;
+
+    if(t)
+    { __atomic_store_n(&t->seen, SR_QSBR_OFFLINE, __ATOMIC_RELEASE); }
+} /* -- sr_qsbr_offline -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_qsbr_online()
+ * Scope: Global
+ *
+ * The calling thread is about to read the tables again.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_qsbr_online(void)
+{
+    struct sr_qsbr_thread* t = sr_qsbr_self;
+
+    if(!t)
+    { return; }
+    __atomic_store_n(&t->seen, __atomic_load_n(&t->q->epoch, __ATOMIC_ACQUIRE),
+                     __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+} /* -- sr_qsbr_online -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_qsbr_synchronize(..)
+ * Scope: Global
+ *
+ * Wait until every registered thread has been quiescent or offline
+ * since the call.  Call after publishing a new table and before freeing
+ * the one it replaced.  The calling thread does not wait for itself.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_qsbr_synchronize(struct sr_qsbr* q)
+{
+    struct sr_qsbr_thread* t;
+    unsigned long          target;
+
+    target = __atomic_add_fetch(&q->epoch, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for(t = __atomic_load_n(&q->threads, __ATOMIC_ACQUIRE); t; t = t->next)
+    {
+        if(t == sr_qsbr_self)
+        { continue; }
+        while(__atomic_load_n(&t->seen, __ATOMIC_ACQUIRE) < target)
+        { usleep(SR_QSBR_POLL_US); }
+    }
+} /* -- sr_qsbr_synchronize -- */
@@ -0,0 +1,60 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_qsbr.h
+ *
+ * Description:
+ *
+ * Quiescent state based reclamation, for tables the packet path reads
+ * without a lock (the routing table and its FIB).
+ *
+ * Packet threads (the reader, forwarding workers, the ARP thread) register
+ * and announce a quiescent state between frames, a point where they hold
+ * no pointer into a shared table.  A thread about to block goes offline
+ * and counts as quiescent until it comes back.  A writer publishes a new
+ * table, calls sr_qsbr_synchronize() and can then free the old one: every
+ * registered thread has been quiescent or offline since, so none of them
+ * can still be looking at it.
+ *
+ * An announcement is a load of the epoch and, only when a writer has
+ * bumped it since the last one, a store to the thread's own cache line.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_QSBR_H
+#define sr_QSBR_H
+
+#define SR_QSBR_OFFLINE (~0ul)    /* seen by a thread that is not reading */
+#define SR_QSBR_POLL_US 1000      /* synchronize polls the threads this often */
+
+struct sr_qsbr;
+
+struct sr_qsbr_thread
+{
+    unsigned long          seen;    /* epoch at last quiescent state */
+    int                    in_use;  /* registered to a thread */
+    struct sr_qsbr*        q;
+    struct sr_qsbr_thread* next;
+} __attribute__ ((aligned (64)));
+
+/* ----------------------------------------------------------------------------
+ * struct sr_qsbr
+ *
+ * Zeroed is ready to use.  Thread records are never freed, a thread
+ * that unregisters leaves its record for the next one to register.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_qsbr
+{
+    unsigned long          epoch;
+    struct sr_qsbr_thread* threads;
+};
+
+void sr_qsbr_init(struct sr_qsbr* q);
+void sr_qsbr_register(struct sr_qsbr* q);
+void sr_qsbr_unregister(void);
+void sr_qsbr_quiescent(void);
+void sr_qsbr_offline(void);
+void sr_qsbr_online(void);
+void sr_qsbr_synchronize(struct sr_qsbr* q);
+
+#endif  /* --  sr_QSBR_H -- */
@@ -0,0 +1,629 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_replay.c
+ *
+ * Description:
+ *
+ * Offline replay: runs the router over a capture without a VNS server.
+ * Built with 'make replay', which links against the router objects
+ * (everything but sr_main.o).
+ *
+ *   ./sr_replay -f ifaces [-r rtable] [-a arp] [-w out.pcap [-n]]
+ *               [-c loops] [-b burst] [-i iface] [-d level] in.pcap
+ *
+ * ifaces has one interface per line, "name ip mac", e.g.
+ *
+ *   eth1 10.0.1.1 02:00:00:00:00:01
+ *
+ * and the optional arp file "ip mac" lines that are put in the ARP cache
+ * up front, so forwarded frames go out instead of waiting on ARP.  '#'
+ * starts a comment in both.
+ *
+ * The input is classic pcap (as -l writes it, micro or nanosecond) or
+ * pcapng (-l -n).  Each frame is handed to sr_handlepacket() as if it had
+ * arrived on: the interface named in its pcapng block, else the interface
+ * whose MAC it is addressed to, else -i (default the first interface).
+ * Frames pcapng marks as outbound are skipped.  Everything the router
+ * sends goes to /dev/null in batches, as it would to the server, and is
+ * captured to -w if given (pcapng with -n).
+ *
+ * With -b, frames go to sr_handlepacket_burst() burst at a time instead
+ * (see sr_burst.h).
+ *
+ * Reports frames per second over the whole run and the latency of each
+ * sr_handlepacket() call, or of each burst shared out over its frames.
+ * Numbers are only meaningful with optimisation on, e.g.
+ *   make replay CFLAGS="-O2 -Wall -ansi -D_GNU_SOURCE -D_LINUX_"
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_router.h"
+#include "sr_burst.h"
+#include "sr_rt.h"
+#include "sr_if.h"
+#include "sr_arpcache.h"
+#include "sr_protocol.h"
+#include "sr_pcap.h"
+
+#define REPLAY_FRAME_MAX 65535
+
+/* -- capture file magic numbers, as read in host order -- */
+#define PCAP_MAGIC_US    0xa1b2c3d4
+#define PCAP_MAGIC_NS    0xa1b23c4d
+#define PCAPNG_SHB       0x0A0D0D0A
+#define PCAPNG_BOM       0x1A2B3C4D
+
+struct replay_frame
+{
+    struct sr_if*  iface;
+    unsigned int   len;
+    const uint8_t* data;  /* in the loaded capture */
+};
+
+struct replay_trace
+{
+    uint8_t*             file;
+    struct replay_frame* frames;
+    unsigned long        n;
+    unsigned long        cap;
+    unsigned long        truncated;
+    unsigned long        skipped;   /* outbound or not Ethernet */
+};
+
+/*---------------------------------------------------------------------
+ * Method: replay_now(), replay_rd16(..), replay_rd32(..)
+ * Scope: Local
+ *
+ * Monotonic nanoseconds, and capture fields in the file's byte order.
+ *
+ *---------------------------------------------------------------------*/
+
+static double replay_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint16_t replay_rd16(const uint8_t* p, int swap)
+{
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return swap ? __builtin_bswap16(v) : v;
+}
+
+static uint32_t replay_rd32(const uint8_t* p, int swap)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+/*---------------------------------------------------------------------
+ * Method: replay_read_file(..)
+ * Scope: Local
+ *
+ * Whole file into memory, 0 on error.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint8_t* replay_read_file(const char* name, size_t* len)
+{
+    FILE*    fp;
+    uint8_t* buf;
+    long     size;
+
+    if((fp = fopen(name, "rb")) == 0)
+    {
+        perror(name);
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if(size < 0 || (buf = malloc(size + 1)) == 0 ||
+       fread(buf, 1, size, fp) != (size_t)size)
+    {
+        fprintf(stderr, "%s: can't read\n", name);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    buf[size] = 0;
+    *len = size;
+    return buf;
+}
+
+/*---------------------------------------------------------------------
+ * Method: replay_parse_mac(..)
+ * Scope: Local
+ *
+ *---------------------------------------------------------------------*/
+
+static int replay_parse_mac(const char* s, unsigned char* mac)
+{
+    unsigned int b[ETHER_ADDR_LEN];
+    int          i;
+
+    if(sscanf(s, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4],
+              &b[5]) != ETHER_ADDR_LEN)
+    { return -1; }
+    for(i = 0; i < ETHER_ADDR_LEN; i++)
+    { mac[i] = b[i]; }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: replay_load_ifaces(..), replay_load_arp(..)
+ * Scope: Local
+ *
+ * Interfaces ("name ip mac") and static ARP entries ("ip mac").
+ *
+ *---------------------------------------------------------------------*/
+
+static int replay_load_ifaces(struct sr_instance* sr, const char* name)
+{
+    FILE*          fp;
+    char           line[256], ifname[sr_IFACE_NAMELEN], ip[64], mac[64];
+    unsigned char  addr[ETHER_ADDR_LEN];
+    struct in_addr in;
+    int            lineno = 0;
+
+    if((fp = fopen(name, "r")) == 0)
+    {
+        perror(name);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp))
+    {
+        lineno++;
+        if(strchr(line, '#'))
+        { *strchr(line, '#') = 0; }
+        if(sscanf(line, "%31s %63s %63s", ifname, ip, mac) != 3)
+        { continue; }
+        if(inet_aton(ip, &in) == 0 || replay_parse_mac(mac, addr) != 0)
+        {
+            fprintf(stderr, "%s:%d: expected \"name ip mac\"\n", name, lineno);
+            fclose(fp);
+            return -1;
+        }
+        sr_add_interface(sr, ifname);
+        sr_set_ether_addr(sr, addr);
+        sr_set_ether_ip(sr, in.s_addr);
+    }
+    fclose(fp);
+
+    if(!sr->if_list)
+    {
+        fprintf(stderr, "%s: no interfaces\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+static int replay_load_arp(struct sr_instance* sr, const char* name)
+{
+    FILE*          fp;
+    char           line[256], ip[64], mac[64];
+    unsigned char  addr[ETHER_ADDR_LEN];
+    struct in_addr in;
+    int            lineno = 0;
+
+    if((fp = fopen(name, "r")) == 0)
+    {
+        perror(name);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp))
+    {
+        lineno++;
+        if(strchr(line, '#'))
+        { *strchr(line, '#') = 0; }
+        if(sscanf(line, "%63s %63s", ip, mac) != 2)
+        { continue; }
+        if(inet_aton(ip, &in) == 0 || replay_parse_mac(mac, addr) != 0)
+        {
+            fprintf(stderr, "%s:%d: expected \"ip mac\"\n", name, lineno);
+            fclose(fp);
+            return -1;
+        }
+        sr_arpcache_put(&sr->cache, addr, in.s_addr);
+    }
+    fclose(fp);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: replay_add(..)
+ * Scope: Local
+ *
+ * Append a frame to the trace, choosing the interface it arrives on.
+ *
+ *---------------------------------------------------------------------*/
+
+static int replay_add(struct sr_instance* sr, struct replay_trace* tr,
+                      struct sr_if* named, struct sr_if* dflt,
+                      const uint8_t* data, unsigned int caplen,
+                      unsigned int len)
+{
+    struct replay_frame* grown;
+    struct sr_if*        iface = named;
+
+    if(caplen < sizeof(sr_ethernet_hdr_t) || caplen > REPLAY_FRAME_MAX)
+    {
+        tr->skipped++;
+        return 0;
+    }
+    if(caplen < len)
+    { tr->truncated++; }
+
+    if(!iface)
+    {
+        for(iface = sr->if_list; iface; iface = iface->next)
+        {
+            if(memcmp(iface->addr, data, ETHER_ADDR_LEN) == 0)
+            { break; }
+        }
+    }
+    if(!iface)
+    { iface = dflt; }
+
+    if(tr->n == tr->cap)
+    {
+        tr->cap = tr->cap ? tr->cap * 2 : 1024;
+        grown = realloc(tr->frames, tr->cap * sizeof(struct replay_frame));
+        if(!grown)
+        { return -1; }
+        tr->frames = grown;
+    }
+    tr->frames[tr->n].iface = iface;
+    tr->frames[tr->n].len   = caplen;
+    tr->frames[tr->n].data  = data;
+    tr->n++;
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: replay_load_pcap(..)
+ * Scope: Local
+ *
+ * Read a classic pcap or pcapng capture, in either byte order, into tr.
+ *
+ *---------------------------------------------------------------------*/
+
+static int replay_load_classic(struct sr_instance* sr, struct replay_trace* tr,
+                               size_t size, int swap, struct sr_if* dflt)
+{
+    const uint8_t* p   = tr->file + 24;
+    const uint8_t* end = tr->file + size;
+    unsigned int   caplen, len;
+
+    if(replay_rd32(tr->file + 20, swap) != 1)
+    {
+        fprintf(stderr, "pcap: link type is not Ethernet\n");
+        return -1;
+    }
+    while(end - p >= 16)
+    {
+        caplen = replay_rd32(p + 8, swap);
+        len    = replay_rd32(p + 12, swap);
+        if((size_t)(end - p - 16) < caplen)
+        { break; }
+        if(replay_add(sr, tr, 0, dflt, p + 16, caplen, len) != 0)
+        { return -1; }
+        p += 16 + caplen;
+    }
+    return 0;
+}
+
+static int replay_load_ng(struct sr_instance* sr, struct replay_trace* tr,
+                          size_t size, struct sr_if* dflt)
+{
+    const uint8_t* p   = tr->file;
+    const uint8_t* end = tr->file + size;
+    const uint8_t* opt;
+    struct sr_if*  ifaces[256];
+    int            linktypes[256];
+    unsigned int   nifaces = 0, type, blen, id, caplen, len, code, olen;
+    unsigned int   flags;
+    char           name[sr_IFACE_NAMELEN];
+    int            swap = 0;
+
+    while(end - p >= 12)
+    {
+        type = replay_rd32(p, swap);
+        if(type == PCAPNG_SHB)
+        {
+            swap    = replay_rd32(p + 8, 0) != PCAPNG_BOM;
+            nifaces = 0; /* -- interfaces are per section -- */
+        }
+        blen = replay_rd32(p + 4, swap);
+        if(blen < 12 || (blen & 3) || (size_t)(end - p) < blen)
+        { break; }
+
+        if(type == 1 && nifaces < 256) /* -- Interface Description -- */
+        {
+            linktypes[nifaces] = replay_rd16(p + 8, swap);
+            ifaces[nifaces]    = 0;
+            for(opt = p + 16; opt + 4 <= p + blen - 4; opt += 4 + ((olen + 3) & ~3u))
+            {
+                code = replay_rd16(opt, swap);
+                olen = replay_rd16(opt + 2, swap);
+                if(code == 0)
+                { break; }
+                if(code == 2 && olen < sizeof(name))
+                {
+                    memcpy(name, opt + 4, olen);
+                    name[olen] = 0;
+                    ifaces[nifaces] = sr_get_interface(sr, name);
+                }
+            }
+            nifaces++;
+        }
+        else if(type == 6 && blen >= 32) /* -- Enhanced Packet -- */
+        {
+            id     = replay_rd32(p + 8, swap);
+            caplen = replay_rd32(p + 20, swap);
+            len    = replay_rd32(p + 24, swap);
+            flags  = 0;
+            if(caplen > blen - 32)
+            { break; }
+            for(opt = p + 28 + ((caplen + 3) & ~3u); opt + 4 <= p + blen - 4;
+                opt += 4 + ((olen + 3) & ~3u))
+            {
+                code = replay_rd16(opt, swap);
+                olen = replay_rd16(opt + 2, swap);
+                if(code == 0)
+                { break; }
+                if(code == 2 && olen == 4)
+                { flags = replay_rd32(opt + 4, swap); }
+            }
+            if(id >= nifaces || linktypes[id] != 1 || (flags & 3) == 2)
+            { tr->skipped++; }
+            else if(replay_add(sr, tr, ifaces[id], dflt, p + 28, caplen, len) != 0)
+            { return -1; }
+        }
+        else if(type == 3 && blen >= 16) /* -- Simple Packet, interface 0 -- */
+        {
+            len    = replay_rd32(p + 8, swap);
+            caplen = len < blen - 16 ? len : blen - 16;
+            if(nifaces == 0 || linktypes[0] != 1)
+            { tr->skipped++; }
+            else if(replay_add(sr, tr, ifaces[0], dflt, p + 12, caplen, len) != 0)
+            { return -1; }
+        }
+        p += blen;
+    }
+    return 0;
+}
+
+static int replay_load_pcap(struct sr_instance* sr, struct replay_trace* tr,
+                            const char* name, struct sr_if* dflt)
+{
+    size_t   size;
+    uint32_t magic;
+
+    memset(tr, 0, sizeof(struct replay_trace));
+    if((tr->file = replay_read_file(name, &size)) == 0)
+    { return -1; }
+    if(size < 24)
+    {
+        fprintf(stderr, "%s: too short for a capture\n", name);
+        return -1;
+    }
+
+    magic = replay_rd32(tr->file, 0);
+    if(magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS)
+    { return replay_load_classic(sr, tr, size, 0, dflt); }
+    if(magic == __builtin_bswap32(PCAP_MAGIC_US) ||
+       magic == __builtin_bswap32(PCAP_MAGIC_NS))
+    { return replay_load_classic(sr, tr, size, 1, dflt); }
+    if(magic == PCAPNG_SHB)
+    { return replay_load_ng(sr, tr, size, dflt); }
+
+    fprintf(stderr, "%s: not a pcap or pcapng file\n", name);
+    return -1;
+}
+
+/*---------------------------------------------------------------------
+ * Method: replay_run(..)
+ * Scope: Local
+ *
+ * Feed the trace through the router loops times, one frame or burst
+ * frames per call, timing each call into lat (a burst's time is shared
+ * out over its frames).  Frames are copied out of the trace (the router
+ * rewrites them) into one of SR_TXBATCH_IOV buffers with headroom, so a
+ * forwarded frame stays put until the send batch is flushed, which
+ * happens before its buffer comes round again.
+ *
+ *---------------------------------------------------------------------*/
+
+static double replay_run(struct sr_instance* sr, struct replay_trace* tr,
+                         unsigned int loops, unsigned int burst, double* lat)
+{
+    struct sr_txbatch*    tx = &sr->vns_rx.tx;
+    struct sr_burst_frame frames[SR_BURST_MAX];
+    uint8_t*              work;
+    uint8_t*              frame;
+    size_t                stride = SR_PKT_HEADROOM + REPLAY_FRAME_MAX + 1;
+    unsigned long         i = 0, k, j, total = tr->n * loops;
+    unsigned int          n, slot = 0;
+    double                t0, t1, start;
+
+    if((work = malloc(stride * SR_TXBATCH_IOV)) == 0)
+    { return -1; }
+
+    sr_txbatch_use(tx);
+    start = replay_now();
+    for(k = 0; k < total; k += n)
+    {
+        if(slot + burst > SR_TXBATCH_IOV)
+        {
+            sr_txbatch_flush(sr, tx);
+            slot = 0;
+        }
+        for(n = 0; n < burst && k + n < total; n++, i = (i + 1) % tr->n)
+        {
+            frame = work + slot++ * stride + SR_PKT_HEADROOM;
+            memcpy(frame, tr->frames[i].data, tr->frames[i].len);
+            frames[n].packet   = frame;
+            frames[n].len      = tr->frames[i].len;
+            frames[n].if_index = tr->frames[i].iface->index;
+        }
+
+        t0 = replay_now();
+        if(burst == 1)
+        {
+            tx->frame = frames[0].packet;
+            sr_handlepacket_if(sr, frames[0].packet, frames[0].len,
+                               frames[0].if_index);
+        }
+        else
+        { sr_handlepacket_burst(sr, frames, n); }
+        t1 = replay_now();
+        for(j = 0; j < n; j++)
+        { lat[k + j] = (t1 - t0) / n; }
+    }
+    sr_txbatch_flush(sr, tx);
+    t1 = replay_now() - start;
+    sr_txbatch_use(0);
+
+    free(work);
+    return t1;
+}
+
+static int replay_cmp(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(char* argv0)
+{
+    printf("Format: %s -f ifaces [-r rtable] [-a arp] [-w out.pcap [-n]] \n", argv0);
+    printf("           [-c loops] [-b burst] [-i iface] [-d log level] in.pcap \n");
+    printf("   ifaces  lines of \"name ip mac\" \n");
+    printf("   arp     lines of \"ip mac\", cached before the run \n");
+    printf("   burst   frames per sr_handlepacket_burst() call, 1-%d \n",
+           SR_BURST_MAX);
+    printf("   iface   where frames arrive that are not addressed to one \n");
+}
+
+int main(int argc, char** argv)
+{
+    struct sr_instance  sr;
+    struct replay_trace tr;
+    struct sr_if*       dflt;
+    char*               ifaces = 0;
+    char*               rtable = "rtable";
+    char*               arp    = 0;
+    char*               out    = 0;
+    char*               ingress = 0;
+    unsigned int        loops  = 1;
+    unsigned int        burst  = 1;
+    enum sr_pcap_fmt    fmt    = sr_pcap_classic;
+    struct sr_pcap*     pcap;
+    unsigned long       total;
+    double*             lat;
+    double              t;
+    int                 c;
+
+    while((c = getopt(argc, argv, "hf:r:a:w:nc:b:i:d:")) != EOF)
+    {
+        switch(c)
+        {
+            case 'f': ifaces  = optarg;               break;
+            case 'r': rtable  = optarg;               break;
+            case 'a': arp     = optarg;               break;
+            case 'w': out     = optarg;               break;
+            case 'n': fmt     = sr_pcap_ng;           break;
+            case 'c': loops   = atoi(optarg);         break;
+            case 'b': burst   = atoi(optarg);         break;
+            case 'i': ingress = optarg;               break;
+            case 'd': sr_log_set_level(atoi(optarg)); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(!ifaces || optind != argc - 1 || loops == 0 || burst == 0 ||
+       burst > SR_BURST_MAX)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(&sr, 0, sizeof(sr));
+    if((sr.sockfd = open("/dev/null", O_WRONLY)) == -1)
+    {
+        perror("/dev/null");
+        return 1;
+    }
+    if(replay_load_ifaces(&sr, ifaces) != 0)
+    { return 1; }
+    if(sr_load_rt(&sr, rtable) != 0)
+    {
+        fprintf(stderr, "Error setting up routing table from file %s\n", rtable);
+        return 1;
+    }
+    sr_init(&sr);
+    if(arp && replay_load_arp(&sr, arp) != 0)
+    { return 1; }
+
+    dflt = ingress ? sr_get_interface(&sr, ingress) : sr.if_list;
+    if(!dflt)
+    {
+        fprintf(stderr, "no interface %s\n", ingress);
+        return 1;
+    }
+    if(replay_load_pcap(&sr, &tr, argv[optind], dflt) != 0)
+    { return 1; }
+    if(tr.n == 0)
+    {
+        fprintf(stderr, "%s: no frames to replay\n", argv[optind]);
+        return 1;
+    }
+
+    if(out && (sr.pcap = sr_pcap_open(out, fmt, PACKET_DUMP_SIZE,
+                                      0)) == 0)
+    { return 1; }
+
+    total = tr.n * loops;
+    if((lat = malloc(total * sizeof(double))) == 0)
+    { return 1; }
+
+    t = replay_run(&sr, &tr, loops, burst, lat);
+    if(t < 0)
+    { return 1; }
+    qsort(lat, total, sizeof(double), replay_cmp);
+
+    fprintf(stderr, "%lu frames (%lu truncated, %lu skipped) x %u: "
+            "%lu sent, %lu queued for ARP\n", tr.n, tr.truncated, tr.skipped,
+            loops, sr.stats.tx, sr.cache.queued);
+    fprintf(stderr, "%.1f kpkts/s\n", total / t * 1e6);
+    fprintf(stderr, "latency ns: p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  "
+            "max %.0f\n", lat[total / 2], lat[total * 9 / 10],
+            lat[total * 99 / 100], lat[total * 999 / 1000], lat[total - 1]);
+
+    /* -- the ARP thread may still be sending, see sr_destroy_instance -- */
+    if((pcap = __atomic_exchange_n(&sr.pcap, 0, __ATOMIC_ACQ_REL)))
+    {
+        sr_qsbr_synchronize(&sr.qsbr);
+        sr_pcap_close(pcap);
+    }
+    free(lat);
+    free(tr.frames);
+    free(tr.file);
+    return 0;
+}
@@ -17,6 +17,8 @@
 
 #include "sr_if.h"
 #include "sr_rt.h"
+#include "sr_fib.h"
+#include "sr_dst.h"
 #include "sr_router.h"
 #include "sr_protocol.h"
 #include "sr_arpcache.h"
@@ -46,7 +48,17 @@ void sr_init(struct sr_instance* sr)
     assert(sr);
 
     /* Initialize cache and cache cleanup thread */
-    sr_arpcache_init(&(sr->cache));
+    sr_arpcache_init(&(sr->cache), sr->arpcache_sz);
+    sr_arpcache_set_queue_limits(&(sr->cache), sr->arpq_req_bytes,
+                                 sr->arpq_total_bytes, sr->arpq_policy);
+    sr_arpcache_set_retry(&(sr->cache), sr->arp_retry_ms);
+    sr_arpcache_set_negative(&(sr->cache), sr->arp_neg_ms);
+
+    /* cache of forwarding results, lookups fall through without it */
+    sr->dst = sr_dst_create();
+
+    /* the cleanup thread and any forwarding workers all send */
+    pthread_mutex_init(&(sr->send_lock), 0);
 
     pthread_attr_init(&(sr->attr));
     pthread_attr_setdetachstate(&(sr->attr), PTHREAD_CREATE_JOINABLE);
@@ -67,21 +79,12 @@ void sr_init(struct sr_instance* sr)
    target IP.
    ===================================================== */
 struct sr_rt* longestprefixmatch(struct sr_instance* sr,uint32_t target_ip){
- struct sr_rt* next = sr->routing_table;
- struct sr_rt* nexthop = 0;
- uint32_t mask,longest = 0;
- while(next){ /*loop through the routing table*/
-   mask = next->mask.s_addr;
-   if((mask&next->dest.s_addr)==(mask&target_ip)){
-        /*pairwise or to determine our forwarding interface*/
-       if(!nexthop||(mask > longest)){
-         nexthop = next;
-         longest = mask;
-       }
-   }
-   next = next->next;
- }
- return nexthop;
+ /*swapped by reloads, see sr_rt_publish*/
+ struct sr_fib* fib = __atomic_load_n(&sr->fib,__ATOMIC_ACQUIRE);
+ if(fib) /*compiled table, at most three reads*/
+   return sr_fib_lookup(fib,target_ip);
+ return sr_rt_lookup_linear(__atomic_load_n(&sr->routing_table,__ATOMIC_ACQUIRE),
+   target_ip);
 }
 
 /* =====================================================
@@ -96,10 +99,10 @@ void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
   uint16_t ip_len = ntohs(siphdr->ip_len);
   unsigned int len;
   if (type == 0){
-    printf("sending icmp echo reply\n");
+    LogDebug("sending icmp echo reply\n");
     len = sizeof(sr_ethernet_hdr_t)+ip_len;
   }else if (type == 11){
-    printf("sending icmp time to live exceeded\n");
+    LogDebug("sending icmp time to live exceeded\n");
     len = sizeof(sr_ethernet_hdr_t)+sizeof(sr_ip_hdr_t)+
 	   sizeof(sr_icmp_t11_hdr_t);
   }else if (type == 3){
@@ -107,20 +110,27 @@ void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
 	   sizeof(sr_icmp_t3_hdr_t);
   }
   else{
-    printf("icmp type not supported\n");
+    LogWarnRL("icmp type %u not supported\n",type);
     return;
   }
 
   /*gets next hop*/
   struct sr_rt *nexthop = longestprefixmatch(sr,siphdr->ip_src);
   if(!nexthop){
-    printf("Destination net unreachable\n");
+    LogInfoRL("Destination net unreachable\n");
+    return;
+  }
+  struct sr_if* interface = sr_if_by_index(sr,nexthop->if_index);
+  if(!interface){ /*route names an interface we don't have*/
+    LogInfoRL("no interface for route to %u.%u.%u.%u\n",
+      SR_LOG_IP(siphdr->ip_src));
     return;
   }
-  struct sr_if* interface = sr_get_interface(sr,nexthop->interface);
 
-  /*Create our ethernet frame*/
-  uint8_t* packet = (uint8_t*)malloc(len);
+  /*Create our ethernet frame, from the frame pool (it has headroom)*/
+  uint8_t* packet = sr_arpcache_frame_get(&sr->cache,len);
+  if(!packet)
+    return;
   sr_ethernet_hdr_t* eth_hdr =(sr_ethernet_hdr_t*)(packet);
   eth_hdr->ether_type = htons(ethertype_ip);
 	memset(eth_hdr->ether_shost,0x00,6);
@@ -132,8 +142,10 @@ void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
 
   if (type == 0){ /*Echo Reply*/
     memcpy(ip_hdr,siphdr,ip_len);
+    SR_STAT_INC(sr, copies);
     ip_hdr->ip_dst = siphdr->ip_src;
     ip_hdr->ip_src = siphdr->ip_dst;
+    ip_hdr->ip_sum = 0; /*copied from the request*/
     ip_hdr->ip_sum = cksum(packet+sizeof(sr_ethernet_hdr_t),sizeof(sr_ip_hdr_t));
 
     /*ICMP part*/
@@ -171,13 +183,13 @@ void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
 
       /*Determine code of Dest Unreachable message*/
       if(code==0){
-        printf("sending icmp net unreachable\n");
+        LogInfoRL("sending icmp net unreachable\n");
       }
       else if(code==1){
-        printf("sending icmp host unreachable\n");
+        LogInfoRL("sending icmp host unreachable\n");
       }
       else if(code==3){
-        printf("sending icmp port unreachable\n");
+        LogInfoRL("sending icmp port unreachable\n");
       }
     }else{
       ip_hdr->ip_sum = cksum(packet+sizeof(sr_ethernet_hdr_t),sizeof(sr_ip_hdr_t));
@@ -191,8 +203,26 @@ void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
                               -sizeof(sr_ethernet_hdr_t)-sizeof(sr_ip_hdr_t));
     }
   }
-  printf("made packet forwarded\n" );
+  LogDebug("made packet forwarded\n" );
   sr_ForwardPacket(sr,packet,nexthop->gw.s_addr,len,interface);
+  sr_arpcache_frame_put(&sr->cache,packet,len); /*sent or queued by now*/
+}
+/* =====================================================
+   icmp_error_allowed
+   No ICMP errors about ARP frames, short datagrams or
+   other ICMP errors; echoes are fine.
+   ===================================================== */
+int icmp_error_allowed(uint8_t* packet,unsigned int len){
+  if(ethertype(packet) != ethertype_ip ||
+     len < sizeof(sr_ethernet_hdr_t)+sizeof(sr_ip_hdr_t))
+    return 0;
+  sr_ip_hdr_t *iphdr = (sr_ip_hdr_t*)(packet+sizeof(sr_ethernet_hdr_t));
+  if(iphdr->ip_p != ip_protocol_icmp)
+    return 1;
+  if(len < sizeof(sr_ethernet_hdr_t)+iphdr->ip_hl*4+sizeof(sr_icmp_hdr_t))
+    return 0;
+  sr_icmp_hdr_t *icmp_hdr = (sr_icmp_hdr_t*)((uint8_t*)iphdr+iphdr->ip_hl*4);
+  return icmp_hdr->icmp_type == 0 || icmp_hdr->icmp_type == 8;
 }
 /* =====================================================
    IPcheck
@@ -200,36 +230,39 @@ void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
    our router's IPs, if so, returns interface.
    ===================================================== */
 struct sr_if* IPcheck(uint32_t tar, struct sr_instance* sr){
-  struct sr_if* if_walker = 0;
-  if_walker = sr->if_list;
-
-  while(if_walker != NULL){ /*iterate through the interface linked list*/
-    if(tar == if_walker->ip){
-      return if_walker; /*Found a match, return the interface*/
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
+  return sr_if_local_lookup(sr,tar); /*one probe, see sr_if.h*/
 }
 /* =====================================================
     ip_checksum
-    Computes checksum of IP datagram, given IP header.
+    Verifies checksum of IP datagram, given IP header.
+    The header (options included) is summed with its
+    checksum in place, so nothing is modified. len is what
+    the frame holds from the header on, options past it
+    fail rather than being read from beyond the frame.
+   ===================================================== */
+int ip_checksum(sr_ip_hdr_t *iphdr, unsigned int len){
+  if(iphdr->ip_hl < 5 || iphdr->ip_hl*4u > len)
+    return 0;
+  return cksum_ok(iphdr, iphdr->ip_hl*4);
+}
+/* =====================================================
+   ip_decrement_ttl
+   Takes the TTL of a datagram being forwarded down, only
+   its 16-bit word of the checksum changes.
    ===================================================== */
-int ip_checksum(sr_ip_hdr_t *iphdr){
-	uint16_t recved = iphdr->ip_sum;
-	iphdr->ip_sum = 0;
-  uint16_t expected = cksum(iphdr, sizeof(sr_ip_hdr_t));
-  return recved == expected;
+void ip_decrement_ttl(sr_ip_hdr_t *iphdr){
+  uint16_t ttl_word = htons(iphdr->ip_ttl << 8 | iphdr->ip_p);
+  iphdr->ip_ttl-=2;
+  iphdr->ip_sum = cksum_update16(iphdr->ip_sum, ttl_word,
+    htons(iphdr->ip_ttl << 8 | iphdr->ip_p));
 }
 /* =====================================================
    icmp_checksum
-   Computes checksum of ICMP packet, given ICMP header.
+   Verifies checksum of ICMP packet, given ICMP header,
+   without modifying it.
    ===================================================== */
 int icmp_checksum(sr_icmp_hdr_t *icmp_hdr,sr_ip_hdr_t *iphdr){
-	uint16_t recved = icmp_hdr->icmp_sum;
-	icmp_hdr->icmp_sum = 0;
-  uint16_t expected = cksum(icmp_hdr, ntohs(iphdr->ip_len)-sizeof(sr_ip_hdr_t));
-  return recved == expected;
+  return cksum_ok(icmp_hdr, ntohs(iphdr->ip_len)-sizeof(sr_ip_hdr_t));
 }
 /*---------------------------------------------------------------------
  * Method: sr_handlepacket(uint8_t* p,char* interface)
@@ -245,100 +278,136 @@ int icmp_checksum(sr_icmp_hdr_t *icmp_hdr,sr_ip_hdr_t *iphdr){
  * packet instead if you intend to keep it around beyond the scope of
  * the method call.
  *
+ * The packet is preceded by SR_PKT_HEADROOM spare bytes, so a forwarded
+ * frame is rewritten and handed to sr_send_packet() where it lies.  The
+ * interface name lives in that headroom and is overwritten by the send.
+ *
+ * Only the interface is looked up here, by name; the router works with
+ * its index, see sr_handlepacket_if().
+ *
  *---------------------------------------------------------------------*/
 
- void sr_handlepacket(struct sr_instance* sr,
+void sr_handlepacket(struct sr_instance* sr,
+        uint8_t * packet/* lent */,
+        unsigned int len,
+        char* interface/* lent */)
+{
+  struct sr_if* iface;
+
+  /* REQUIRES */
+  assert(sr);
+  assert(interface);
+
+  if((iface = sr_get_interface(sr,interface)) == 0){
+    LogWarnRL("packet on unknown interface %s\n",interface);
+    return;
+  }
+  sr_handlepacket_if(sr,packet,len,iface->index);
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_handlepacket_if(uint8_t* p,unsigned int if_index)
+ * Scope:  Global
+ *
+ * sr_handlepacket() for a frame received on the interface with index
+ * if_index (see sr_if_by_index), which must exist.  Frames the router
+ * throws away are counted against that interface.
+ *
+ *---------------------------------------------------------------------*/
+
+ void sr_handlepacket_if(struct sr_instance* sr,
          uint8_t * packet/* lent */,
          unsigned int len,
-         char* interface/* lent */)
+         unsigned int if_index)
  {
    /* REQUIRES */
    assert(sr);
    assert(packet);
-   assert(interface);
+   assert(if_index < sr->if_count);
 
-   printf("*** -> Received packet of length %d \n",len);
+   LogDebug("*** -> Received packet of length %d \n",len);
 
    /*ARP packet (arp ethertype is 0x0806 (2054 in dec))*/
    if(ethertype(packet) == 2054){
-     printf("got an arp ");
-     if (len < (sizeof(sr_ethernet_hdr_t)+sizeof(sr_arp_hdr_t))) /*validate  ARP packet size*/
-       fprintf(stderr, "Corruption: packet too small\n");
-     else{
+     if (len < (sizeof(sr_ethernet_hdr_t)+sizeof(sr_arp_hdr_t))){ /*validate  ARP packet size*/
+       LogWarnRL("Corruption: packet too small\n");
+       SR_IF_STAT_ADD(sr,if_index,drops,1);
+     }else{
        sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t*)(packet+sizeof(sr_ethernet_hdr_t));
        uint32_t target_ip = arp_hdr->ar_tip;
        struct sr_if *found_interface = IPcheck(target_ip,sr);
 
        if(ntohs(arp_hdr->ar_op) == 2){ /*ARP reply*/
-         printf("reply packet.\n");
+         LogDebug("got an arp reply packet.\n");
          if(found_interface){
            if (strncmp((const char*)found_interface->addr,
              (const char*)arp_hdr->ar_tha,ETHER_ADDR_LEN)){
-             printf("bad mac\n");
+             LogWarnRL("bad mac\n");
+             SR_IF_STAT_ADD(sr,if_index,drops,1);
              return;
            }
-           sr_arpcacheinsert(&sr->cache,arp_hdr->ar_sha,arp_hdr->ar_sip);
+           sr_arpcacheinsert(sr,arp_hdr->ar_sha,arp_hdr->ar_sip);
          }else{
            struct sr_rt *nexthop = longestprefixmatch(sr,target_ip);
            if(!nexthop){
-             printf("Destination net unreachable\n");
+             LogInfoRL("Destination net unreachable\n");
+             SR_IF_STAT_ADD(sr,if_index,drops,1);
              return;
            }
-           struct sr_if* sinterface = sr_get_interface(sr,interface);
-           printf("reply forwarded to nexthop\n");
-           uint8_t* buf = (uint8_t*)malloc(len);
-           memcpy(buf, packet, len);
-           sr_ForwardPacket(sr,buf,nexthop->gw.s_addr,len,sinterface);
+           struct sr_if* sinterface = sr_if_by_index(sr,if_index);
+           LogDebug("reply forwarded to nexthop\n");
+           sr_ForwardPacket(sr,packet,nexthop->gw.s_addr,len,sinterface);
          }
        }
        else if(ntohs(arp_hdr->ar_op) == 1){ /*ARP request*/
-         printf("request packet .\n");
-         struct sr_if* sinterface = sr_get_interface(sr,interface);
+         LogDebug("got an arp request packet .\n");
+         struct sr_if* sinterface = sr_if_by_index(sr,if_index);
          if(found_interface){ /*tar ip is one of ours*/
            /*send ARP reply, return*/
            sr_arp_make_packet(sr, sinterface, arp_hdr->ar_sha, arp_hdr->ar_sip, 0);
-           sr_arpcacheinsert(&sr->cache,arp_hdr->ar_sha,arp_hdr->ar_sip);
+           sr_arpcacheinsert(sr,arp_hdr->ar_sha,arp_hdr->ar_sip);
           }else{ /*target IP not ours*/
-            struct sr_arpentry* entry = sr_arpcache_lookup(&sr->cache,target_ip);
-            if (entry){
-              sr_arp_make_packet(sr, sinterface, entry->mac, arp_hdr->ar_sip, 0);
+            unsigned char mac[ETHER_ADDR_LEN];
+            if (sr_arpcache_lookup_mac(&sr->cache,target_ip,mac)){
+              sr_arp_make_packet(sr, sinterface, mac, arp_hdr->ar_sip, 0);
             /*forward ARP request (using routing table), return*/
-              free(entry);
             }
             else{
               struct sr_rt *nexthop = longestprefixmatch(sr,target_ip);
               if(!nexthop){
-                printf("Destination net unreachable\n");
+                LogInfoRL("Destination net unreachable\n");
+                SR_IF_STAT_ADD(sr,if_index,drops,1);
                 return;
               }
-              printf("arp req mac address not found, request queued\n");
-              uint8_t* buf = (uint8_t*)malloc(len);
-              memcpy(buf, packet, len);
-              sr_arpcache_queuereq(&sr->cache,nexthop->gw.s_addr,buf,
-                sizeof(sr_ethernet_hdr_t)+sizeof(sr_arp_hdr_t),nexthop->interface);
+              LogDebug("arp req mac address not found, request queued\n");
+              SR_STAT_INC(sr, copies); /*queue keeps its own copy*/
+              sr_arpcache_queuereq(&sr->cache,nexthop->gw.s_addr,packet,
+                sizeof(sr_ethernet_hdr_t)+sizeof(sr_arp_hdr_t),
+                nexthop->if_index);
             }
           }
         }
         else
-          return;
+          SR_IF_STAT_ADD(sr,if_index,drops,1);
       }
   }
    else if(ethertype(packet) == ethertype_ip){ /*IP Packet*/
-     printf("got an ip ");
-     if(len >= 20){ /*valid size (large enough to hold an IP header)*/
+     if(len >= sizeof(sr_ethernet_hdr_t)+sizeof(sr_ip_hdr_t)){ /*large enough to hold an IP header*/
        sr_ip_hdr_t *iphdr = (sr_ip_hdr_t *)(packet+sizeof(sr_ethernet_hdr_t)); /*access IP header*/
-       if (!ip_checksum(iphdr)){ /*Recompute checksum before we do anything*/
-         fprintf(stderr,"Corruption: bad ip checksum\n");
+       if (!ip_checksum(iphdr,len-sizeof(sr_ethernet_hdr_t))){ /*Recompute checksum before we do anything*/
+         LogWarnRL("Corruption: bad ip checksum\n");
+         SR_IF_STAT_ADD(sr,if_index,drops,1);
          return;
        }
        struct sr_if *found_interface = IPcheck(iphdr->ip_dst,sr);
        if (found_interface){
          if(iphdr->ip_p == 1){ /* ICMP protocol */
-           printf("icmp packet \n");
+           LogDebug("got an ip icmp packet \n");
            sr_icmp_hdr_t *icmp_hdr =(sr_icmp_hdr_t*)(packet
              +sizeof(sr_ethernet_hdr_t)+sizeof(sr_ip_hdr_t));
              if (!icmp_checksum(icmp_hdr,iphdr)){
-               fprintf(stderr,"Corruption: bad icmp checksum\n");
+               LogWarnRL("Corruption: bad icmp checksum\n");
+               SR_IF_STAT_ADD(sr,if_index,drops,1);
                return;
              }
              if(icmp_hdr->icmp_type==8){ /*Ping request*/
@@ -352,21 +421,39 @@ int icmp_checksum(sr_icmp_hdr_t *icmp_hdr,sr_ip_hdr_t *iphdr){
      }else{
        if(iphdr->ip_ttl == 1){ /*ICMP time exceeded*/
          sr_icmp_make_packet(sr,iphdr, 11, 0);
+         SR_IF_STAT_ADD(sr,if_index,drops,1);
+         return;
+       }
+       ip_decrement_ttl(iphdr);
+       /*seen this destination lately: MACs and interface in one read*/
+       struct sr_dst_entry dst;
+       if(sr_dst_lookup(sr->dst,&sr->cache,iphdr->ip_dst,&dst)){
+         LogDebug("ip forwarded to cached nexthop\n");
+         memcpy(packet,dst.eth,2*ETHER_ADDR_LEN);
+         sr_send_packet_if(sr,packet,len,dst.iface->index);
          return;
        }
-       iphdr->ip_ttl-=2; /*decrement TTL*/
-       iphdr->ip_sum = 0;
-       iphdr->ip_sum = cksum(iphdr,iphdr->ip_hl*4);
        struct sr_rt *nexthop = longestprefixmatch(sr,iphdr->ip_dst);
        if(!nexthop){
-         printf("no match in LPM,send net unreachable\n");
+         LogInfoRL("no match in LPM,send net unreachable\n");
          sr_icmp_make_packet(sr,iphdr, 3, 0);
+         SR_IF_STAT_ADD(sr,if_index,drops,1);
        }else{
-         struct sr_if* sinterface = sr_get_interface(sr,nexthop->interface);
-         printf("ip forwarded to nexthop\n");
-         uint8_t* buf = (uint8_t*)malloc(len);
-         memcpy(buf, packet, len);
-         sr_ForwardPacket(sr,buf,nexthop->gw.s_addr,len,sinterface);
+         struct sr_if* sinterface = sr_if_by_index(sr,nexthop->if_index);
+         LogDebug("ip forwarded to nexthop\n");
+         int slot = sinterface ?
+           sr_arpcache_resolve(&sr->cache,nexthop->gw.s_addr,dst.eth) : -1;
+         if(slot >= 0){
+           /*resolved, remember it for the next datagram*/
+           dst.arp_slot = slot;
+           memcpy(dst.eth+ETHER_ADDR_LEN,sinterface->addr,ETHER_ADDR_LEN);
+           dst.ip = iphdr->ip_dst;
+           dst.iface = sinterface;
+           sr_dst_fill(sr->dst,&dst);
+           memcpy(packet,dst.eth,2*ETHER_ADDR_LEN);
+           sr_send_packet_if(sr,packet,len,sinterface->index);
+         }else
+           sr_ForwardPacket(sr,packet,nexthop->gw.s_addr,len,sinterface);
        }
      }
    }
@@ -375,47 +462,59 @@ int icmp_checksum(sr_icmp_hdr_t *icmp_hdr,sr_ip_hdr_t *iphdr){
 
 /* =====================================================
     sr_arpcache_insert
-    Iterates through and adds to our ARP cache.
+    Iterates through and adds to our ARP cache. Packets
+    queued on this IP go out now, not on the next retry.
    ===================================================== */
-void sr_arpcacheinsert(struct sr_arpcache *cache, unsigned char *mac,uint32_t ip){
-  /*insert mac into cache */
-  int i;
-  for (i = 0; i < SR_ARPCACHE_SZ; i++) {
-      if (!(cache->entries[i].valid))
-          break;
-  }
-  if (i != SR_ARPCACHE_SZ) {
-      memcpy(cache->entries[i].mac, mac, 6);
-      cache->entries[i].ip = ip;
-      cache->entries[i].added = time(NULL);
-      cache->entries[i].valid = 1;
-      printf("ip cached\n" );
-      print_addr_ip_int(cache->entries[i].ip);
+void sr_arpcacheinsert(struct sr_instance* sr, unsigned char *mac,uint32_t ip){
+  /*insert mac into cache, taking its request off the queue*/
+  struct sr_arpreq *req = sr_arpcache_insert(&sr->cache,mac,ip);
+  LogDebug("ip cached %u.%u.%u.%u\n",SR_LOG_IP(ip));
+  if(req){
+    LogDebug("sending %lu queued packets\n",req->queued - req->dropped);
+    sr_arpreq_flush(sr,req,mac);
+    sr_arpreq_destroy(&sr->cache,req);
   }
 }
 
 /* =====================================================
     sr_ForwardPacket
     Forwards packet to the interface determined by
-    longestprefixmatch.
+    longestprefixmatch. The packet is only borrowed: it
+    is rewritten and sent in place (it needs headroom, see
+    SR_PKT_HEADROOM) or copied into the ARP queue, unless
+    the nexthop is down: then it is dropped with a host
+    unreachable (see sr_arpcache_dead). Dropped too when
+    interface is NULL, a route to one we don't have.
    ===================================================== */
 void sr_ForwardPacket(struct sr_instance* sr,uint8_t* packet,
   uint32_t nexthop_ip,unsigned int len, struct sr_if* interface){
 
-  struct sr_arpentry* entry = sr_arpcache_lookup(&sr->cache,nexthop_ip);
-  if(entry){
+  unsigned char mac[ETHER_ADDR_LEN];
+  enum sr_arpneg_verdict verdict;
+  if(!interface){ /*route names an interface we don't have*/
+    LogInfoRL("no interface for nexthop %u.%u.%u.%u, dropped\n",
+      SR_LOG_IP(nexthop_ip));
+    return;
+  }
+  if(sr_arpcache_lookup_mac(&sr->cache,nexthop_ip,mac)){
     sr_ethernet_hdr_t* eth_hdr =(sr_ethernet_hdr_t*)(packet);
     memcpy(eth_hdr->ether_shost,interface->addr,6);
-    memcpy(eth_hdr->ether_dhost,entry->mac,6);
-    printf("%s \n",interface->name);
-    sr_send_packet(sr,packet,len,interface->name);
-    free(entry);
+    memcpy(eth_hdr->ether_dhost,mac,6);
+    LogDebug("%s \n",interface->name);
+    sr_send_packet_if(sr,packet,len,interface->index);
+  }
+  else if((verdict = sr_arpcache_dead(&sr->cache,nexthop_ip)) != arpneg_none){
+    /*gave up on this nexthop lately, answer now rather than queue*/
+    LogDebug("nexthop %u.%u.%u.%u down, not queued\n",SR_LOG_IP(nexthop_ip));
+    if(verdict == arpneg_icmp && icmp_error_allowed(packet,len))
+      sr_icmp_make_packet(sr,(sr_ip_hdr_t*)(packet+sizeof(sr_ethernet_hdr_t)),3,1);
+    SR_IF_STAT_ADD(sr,interface->index,drops,1);
   }
   else{
-    printf("forward mac address not found, request queued\n");
-    printf("nexthop_ip\n");
-    print_addr_ip_int(nexthop_ip);
-    sr_arpcache_queuereq(&sr->cache,nexthop_ip,packet,len,interface->name);
+    LogDebug("forward mac address not found, request queued\n");
+    LogDebug("nexthop_ip %u.%u.%u.%u\n",SR_LOG_IP(nexthop_ip));
+    SR_STAT_INC(sr, copies); /*queue keeps its own copy*/
+    sr_arpcache_queuereq(&sr->cache,nexthop_ip,packet,len,interface->index);
   }
 }
 /* end sr_ForwardPacket */
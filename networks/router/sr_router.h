@@ -15,6 +15,10 @@
 
 #include "sr_protocol.h"
 #include "sr_arpcache.h"
+#include "sr_pool.h"
+#include "sr_vns_io.h"
+#include "sr_qsbr.h"
+#include "sr_log.h"
 
 /* we dont like this debug , but what to do for varargs ? */
 #ifdef _DEBUG_
@@ -30,9 +34,40 @@
 #define INIT_TTL 255
 #define PACKET_DUMP_SIZE 1024
 
+/* bytes in front of every frame handed to sr_handlepacket() or
+   sr_send_packet(), where sr_send_packet() builds the VNS header */
+#define SR_PKT_HEADROOM 24
+
 /* forward declare */
 struct sr_if;
 struct sr_rt;
+struct sr_fib;
+struct sr_dst_cache;
+struct sr_pipeline;
+struct sr_pcap;
+
+/* ----------------------------------------------------------------------------
+ * struct sr_pkt_stats
+ *
+ * Frame buffer accounting on the packet path.  Forwarded frames are
+ * rewritten and sent from their receive buffer, so copies only move for
+ * frames the router builds itself or has to queue behind an ARP request.
+ * Buffers come from pools; sr_pkt_heap_allocs() counts what the pools and
+ * oversize frames took from the heap.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_pkt_stats
+{
+    unsigned long rx;       /* frames read from the server */
+    unsigned long tx;       /* frames written to the server */
+    unsigned long copies;   /* frames (or partial frames) copied */
+    unsigned long rx_calls; /* recv() calls on the server socket */
+    unsigned long tx_calls; /* write calls on the server socket */
+};
+
+#define SR_STAT_INC(sr, field) \
+    __atomic_fetch_add(&(sr)->stats.field, 1, __ATOMIC_RELAXED)
 
 /* ----------------------------------------------------------------------------
  * struct sr_instance
@@ -50,10 +85,30 @@ struct sr_instance
     unsigned short topo_id;
     struct sockaddr_in sr_addr; /* address to server */
     struct sr_if* if_list; /* list of interfaces */
+    struct sr_if** if_index; /* if_list by sr_if index */
+    struct sr_if_stats* if_stats; /* counters by sr_if index */
+    unsigned int if_count;
+    struct sr_if_local if_local; /* our IP addresses, see sr_if.h */
     struct sr_rt* routing_table; /* routing table */
+    struct sr_fib* fib; /* compiled routing table, see sr_fib.h */
+    struct sr_dst_cache* dst; /* forwarding results by ip_dst, see sr_dst.h */
+    struct sr_qsbr qsbr;  /* packet threads, for freeing replaced routes */
     struct sr_arpcache cache;   /* ARP cache */
+    unsigned int arpcache_sz;   /* ARP cache capacity, 0 for the default */
+    unsigned int arpq_req_bytes;   /* ARP queue caps, 0 for the defaults */
+    unsigned int arpq_total_bytes;
+    enum sr_arpq_policy arpq_policy;
+    unsigned int arp_retry_ms;  /* ms between ARP requests, 0 for the default */
+    unsigned int arp_neg_ms;    /* ms a next hop stays down, 0 for the default */
     pthread_attr_t attr;
-    FILE* logfile;
+    struct sr_pcap* pcap;       /* packet capture (-l), see sr_pcap.h */
+    struct sr_pipeline* pipeline; /* forwarding workers (-j), 0 if inline */
+    unsigned int burst;         /* frames the reader handles together (-b),
+                                   see sr_burst.h; 0 or 1 one at a time */
+    pthread_mutex_t send_lock;  /* serialises writes to sockfd */
+    struct sr_pool rx_pool;     /* receive chunks, see sr_vns_io.h */
+    struct sr_vns_rx vns_rx;    /* reader's receive chunk and send batch */
+    struct sr_pkt_stats stats;
 };
 /* =====================================================
    longestprefixmatch
@@ -69,6 +124,13 @@ struct sr_rt* longestprefixmatch(struct sr_instance* ,uint32_t);
    ===================================================== */
 void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
   uint8_t type, uint8_t code);
+/* =====================================================
+   icmp_error_allowed
+   Whether an ICMP error may be sent about this frame: it
+   must be an IP datagram, and not an ICMP message other
+   than an echo, so there are no errors about errors.
+   ===================================================== */
+int icmp_error_allowed(uint8_t* packet,unsigned int len);
   /* =====================================================
      IPcheck
      Determines if packet's target IP is one of the router's
@@ -78,37 +140,49 @@ void sr_icmp_make_packet(struct sr_instance* sr,sr_ip_hdr_t* siphdr,
 struct sr_if* IPcheck(uint32_t tar, struct sr_instance* sr);
 /* =====================================================
    ip_checksum
-   Computes the checksum of the IP datagram, given the IP
-   header.
+   Verifies the checksum of the IP datagram, given the IP
+   header and the bytes of the frame from it on, without
+   modifying it. A header longer than that fails.
+   ===================================================== */
+int ip_checksum(sr_ip_hdr_t *iphdr, unsigned int len);
+/* =====================================================
+   ip_decrement_ttl
+   Takes down the TTL of a datagram being forwarded and
+   patches its checksum to match.
    ===================================================== */
-int ip_checksum(sr_ip_hdr_t *iphdr);
+void ip_decrement_ttl(sr_ip_hdr_t *iphdr);
 /* =====================================================
    icmp_checksum
-   Computers the checksum of ICMP packet, given the header
-   of the packet.
+   Verifies the checksum of ICMP packet, given the header
+   of the packet, without modifying it.
    ===================================================== */
 int icmp_checksum(sr_icmp_hdr_t *icmp_hdr,sr_ip_hdr_t *iphdr);
 /* =====================================================
    sr_arpcache_insert
    Given a MAC and IP address, this functions adds the pair
    into the ARP cache for later use when handling ARP
-   requests.
+   requests, and sends the packets waiting on that IP.
    ===================================================== */
-void sr_arpcacheinsert(struct sr_arpcache *cache, unsigned char *mac,uint32_t ip);
+void sr_arpcacheinsert(struct sr_instance* sr, unsigned char *mac,uint32_t ip);
 
 
 /* -- sr_main.c -- */
-int sr_verify_routing_table(struct sr_instance* sr);
 void sr_ForwardPacket(struct sr_instance* sr,uint8_t* packet,
   uint32_t nexthop_ip,unsigned int len, struct sr_if* interface);
 /* -- sr_vns_comm.c -- */
 int sr_send_packet(struct sr_instance* , uint8_t* , unsigned int , const char*);
+int sr_send_packet_if(struct sr_instance* , uint8_t* , unsigned int ,
+                      unsigned int );
 int sr_connect_to_server(struct sr_instance* ,unsigned short , char* );
 int sr_read_from_server(struct sr_instance* );
+void sr_print_pkt_stats(struct sr_instance* , FILE* );
+unsigned long sr_pkt_heap_allocs(struct sr_instance* );
 
 /* -- sr_router.c -- */
 void sr_init(struct sr_instance* );
 void sr_handlepacket(struct sr_instance* , uint8_t * , unsigned int , char* );
+void sr_handlepacket_if(struct sr_instance* , uint8_t * , unsigned int ,
+                        unsigned int );
 
 /* -- sr_if.c -- */
 void sr_add_interface(struct sr_instance* , const char* );
@@ -12,33 +12,417 @@
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
 
 
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
 #define __USE_MISC 1 /* force linux to show inet_aton */
 #include <arpa/inet.h>
 
 #include "sr_rt.h"
+#include "sr_fib.h"
+#include "sr_dst.h"
+#include "sr_qsbr.h"
 #include "sr_router.h"
 
+/* -- same file contents as far as stat() can tell -- */
+#define SR_RT_SAME_FILE(a, b) \
+    ((a).st_ino == (b).st_ino && (a).st_size == (b).st_size && \
+     (a).st_mtime == (b).st_mtime)
+
+/* -- one writer at a time publishes a routing table -- */
+static pthread_mutex_t sr_rt_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* -- set by SIGHUP, see sr_rt_watch -- */
+static volatile sig_atomic_t sr_rt_hup = 0;
+
 /*---------------------------------------------------------------------
- * Method:
+ * Method: sr_rt_new(..)
+ * Scope: Local
+ *
+ * A routing entry that is on no list yet.  The interface is looked up
+ * by name here if the router already has it, else when the routing
+ * table is verified against the hardware.
+ *
+ *---------------------------------------------------------------------*/
+
+static struct sr_rt* sr_rt_new(struct sr_instance* sr, struct in_addr dest,
+                               struct in_addr gw, struct in_addr mask,
+                               char* if_name)
+{
+    struct sr_rt* rt = 0;
+    struct sr_if* iface = 0;
+
+    rt = (struct sr_rt*)malloc(sizeof(struct sr_rt));
+    assert(rt);
+
+    iface = sr_get_interface(sr,if_name);
+
+    rt->next = 0;
+    rt->dest = dest;
+    rt->gw   = gw;
+    rt->mask = mask;
+    strncpy(rt->interface,if_name,sr_IFACE_NAMELEN);
+    rt->if_index = iface ? iface->index : SR_IF_NONE;
+    rt->block = 0;
+
+    return rt;
+} /* -- sr_rt_new -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_free(..)
+ * Scope: Local
+ *
+ * Free a routing list: entries added one at a time, and the arrays a
+ * loaded table sits in once nothing on the list still points into them.
+ * The first entry of each array is reused to chain the arrays.
+ *
+ *---------------------------------------------------------------------*/
+
+static void sr_rt_free(struct sr_rt* routes)
+{
+    struct sr_rt* next;
+    struct sr_rt* blocks = 0;
+
+    for(; routes; routes = next)
+    {
+        next = routes->next;
+        if(!routes->block)
+        { free(routes); }
+        else if(routes->block == routes)
+        {
+            routes->next = blocks;
+            blocks = routes;
+        }
+    }
+    for(; blocks; blocks = next)
+    {
+        next = blocks->next;
+        free(blocks);
+    }
+} /* -- sr_rt_free -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_publish(..)
+ * Scope: Local
+ *
+ * Compile routes into a FIB and make them the routing table.  Packet
+ * threads keep forwarding with the old table until they see the new
+ * one; the old list and FIB are freed once none of them can be using
+ * them any more (see sr_qsbr.h).  routes may be the current list.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_rt_publish(struct sr_instance* sr, struct sr_rt* routes)
+{
+    struct sr_fib* fib;
+    struct sr_fib* old_fib;
+    struct sr_rt*  old_routes;
+
+    if((fib = sr_fib_build(routes)) == 0)
+    { return -1; }
+
+    pthread_mutex_lock(&sr_rt_lock);
+    old_routes = sr->routing_table;
+    old_fib    = sr->fib;
+
+    /* -- lookups go through the FIB, so publish it last -- */
+    __atomic_store_n(&sr->routing_table, routes, __ATOMIC_RELEASE);
+    __atomic_store_n(&sr->fib, fib, __ATOMIC_RELEASE);
+    sr_dst_flush(sr->dst);
+
+    sr_qsbr_synchronize(&sr->qsbr);
+    pthread_mutex_unlock(&sr_rt_lock);
+
+    sr_fib_destroy(old_fib);
+    if(old_routes != routes)
+    { sr_rt_free(old_routes); }
+    return 0;
+} /* -- sr_rt_publish -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_if_index(..)
+ * Scope: Local
+ *
+ * Index of the interface called name (len bytes), SR_IF_NONE if the
+ * router does not have it (yet).  *last remembers the previous answer:
+ * consecutive routes tend to go out of the same interface.
+ *
+ *---------------------------------------------------------------------*/
+
+static unsigned int sr_rt_if_index(struct sr_instance* sr, const char* name,
+                                   unsigned int len, struct sr_if** last)
+{
+    struct sr_if* if_walker;
+
+    if(*last && strncmp((*last)->name, name, len) == 0 && !(*last)->name[len])
+    { return (*last)->index; }
+
+    for(if_walker = sr->if_list; if_walker; if_walker = if_walker->next)
+    {
+        if(strncmp(if_walker->name, name, len) == 0 && !if_walker->name[len])
+        {
+            *last = if_walker;
+            return if_walker->index;
+        }
+    }
+    return SR_IF_NONE;
+} /* -- sr_rt_if_index -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_parse_ip(..)
+ * Scope: Local
+ *
+ * Parse len bytes at p as an IPv4 address.  Dotted quads are parsed by
+ * hand, anything else inet_aton() takes (hex, fewer parts) goes to
+ * inet_aton().  Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_rt_parse_ip(const char* p, unsigned int len, struct in_addr* out)
+{
+    const char*  start = p;
+    const char*  end = p + len;
+    uint32_t     addr = 0, part;
+    unsigned int parts = 0, digits;
+    char         buf[32];
+
+    while(p < end && parts < 4)
+    {
+        for(part = 0, digits = 0; p < end && *p >= '0' && *p <= '9' &&
+            digits < 3; p++, digits++)
+        { part = part * 10 + (*p - '0'); }
+        if(!digits || part > 255 || (digits > 1 && *(p - digits) == '0'))
+        { break; }
+        addr = addr << 8 | part;
+        if(++parts < 4)
+        {
+            if(p == end || *p != '.')
+            { break; }
+            p++;
+        }
+    }
+    if(parts == 4 && p == end)
+    {
+        out->s_addr = htonl(addr);
+        return 0;
+    }
+
+    /* -- the unusual forms -- */
+    if(len >= sizeof(buf))
+    { return -1; }
+    memcpy(buf, start, len);
+    buf[len] = 0;
+    return inet_aton(buf, out) ? 0 : -1;
+} /* -- sr_rt_parse_ip -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_parse_text(..)
+ * Scope: Local
+ *
+ * Parse a routing table file ("dest gw mask iface" per line, lines with
+ * fewer fields are skipped) mapped at p into *out.  The entries are
+ * allocated as one array, sized by counting lines, and chained in file
+ * order.  Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+#define SR_RT_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || \
+                        (c) == '\v' || (c) == '\f')
+
+static int sr_rt_parse_text(struct sr_instance* sr, const char* p,
+                            size_t len, struct sr_rt** out)
+{
+    const char*    end = p + len;
+    const char*    eol;
+    const char*    tok[4];
+    unsigned int   toklen[4], ntok;
+    size_t         lines = 1, n = 0;
+    struct sr_rt*  block;
+    struct sr_rt*  rt;
+    struct sr_if*  last = 0;
+    struct in_addr addr[3];
+    int            i;
+
+    for(eol = p; (eol = memchr(eol, '\n', end - eol)) != 0; eol++)
+    { lines++; }
+
+    block = (struct sr_rt*)malloc(lines * sizeof(struct sr_rt));
+    if(!block)
+    { return -1; }
+
+    for(; p < end; p = eol + 1)
+    {
+        if((eol = memchr(p, '\n', end - p)) == 0)
+        { eol = end; }
+
+        /* -- first four whitespace separated fields -- */
+        for(ntok = 0; ntok < 4; ntok++)
+        {
+            while(p < eol && SR_RT_SPACE(*p))
+            { p++; }
+            if(p == eol)
+            { break; }
+            tok[ntok] = p;
+            while(p < eol && !SR_RT_SPACE(*p))
+            { p++; }
+            toklen[ntok] = p - tok[ntok];
+        }
+        if(ntok < 4)
+        { continue; }
+
+        for(i = 0; i < 3; i++)
+        {
+            if(sr_rt_parse_ip(tok[i], toklen[i], &addr[i]) != 0)
+            {
+                fprintf(stderr,
+                        "Error loading routing table, cannot convert %.*s to valid IP\n",
+                        (int)toklen[i], tok[i]);
+                free(block);
+                return -1;
+            }
+        }
+        if(toklen[3] >= sr_IFACE_NAMELEN)
+        { toklen[3] = sr_IFACE_NAMELEN - 1; }
+
+        rt = &block[n++];
+        rt->dest = addr[0];
+        rt->gw   = addr[1];
+        rt->mask = addr[2];
+        memcpy(rt->interface, tok[3], toklen[3]);
+        memset(rt->interface + toklen[3], 0, sr_IFACE_NAMELEN - toklen[3]);
+        rt->if_index = sr_rt_if_index(sr, tok[3], toklen[3], &last);
+        rt->block = block;
+        rt->next  = rt + 1;
+    }
+
+    if(n == 0)
+    {
+        free(block);
+        block = 0;
+    }
+    else
+    { block[n - 1].next = 0; }
+
+    *out = block;
+    return 0;
+} /* -- sr_rt_parse_text -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_parse_bin(..)
+ * Scope: Local
+ *
+ * Parse a binary routing table (see sr_rt.h) mapped at p into *out, as
+ * sr_rt_parse_text() does.  Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_rt_parse_bin(struct sr_instance* sr, const uint8_t* p,
+                           size_t len, struct sr_rt** out)
+{
+    struct sr_rt_bin_hdr   hdr;
+    struct sr_rt_bin_entry e;
+    const char*            names;
+    unsigned int           index[256];
+    uint32_t               n, nifaces, i;
+    struct sr_rt*          block;
+    struct sr_rt*          rt;
+    struct sr_if*          last = 0;
+
+    memcpy(&hdr, p, sizeof(hdr));
+    n       = ntohl(hdr.nroutes);
+    nifaces = ntohl(hdr.nifaces);
+    if(ntohl(hdr.version) != SR_RT_BIN_VERSION || nifaces > 256 ||
+       len != sizeof(hdr) + (size_t)nifaces * SR_RT_BIN_NAMELEN +
+              (size_t)n * sizeof(struct sr_rt_bin_entry))
+    {
+        fprintf(stderr, "Error loading routing table, bad binary table\n");
+        return -1;
+    }
+
+    names = (const char*)p + sizeof(hdr);
+    for(i = 0; i < nifaces; i++)
+    {
+        index[i] = sr_rt_if_index(sr, names + i * SR_RT_BIN_NAMELEN,
+                                  strnlen(names + i * SR_RT_BIN_NAMELEN,
+                                          SR_RT_BIN_NAMELEN), &last);
+    }
+    p += sizeof(hdr) + nifaces * SR_RT_BIN_NAMELEN;
+
+    *out = 0;
+    if(n == 0)
+    { return 0; }
+    if((block = (struct sr_rt*)malloc(n * sizeof(struct sr_rt))) == 0)
+    { return -1; }
+
+    for(i = 0; i < n; i++, p += sizeof(e))
+    {
+        memcpy(&e, p, sizeof(e));
+        if(e.plen > 32 || e.iface >= nifaces)
+        {
+            fprintf(stderr, "Error loading routing table, bad binary entry %u\n", i);
+            free(block);
+            return -1;
+        }
+        rt = &block[i];
+        rt->dest.s_addr = e.dest;
+        rt->gw.s_addr   = e.gw;
+        rt->mask.s_addr = htonl(e.plen ? 0xffffffffu << (32 - e.plen) : 0);
+        memset(rt->interface, 0, sr_IFACE_NAMELEN);
+        memcpy(rt->interface, names + e.iface * SR_RT_BIN_NAMELEN,
+               SR_RT_BIN_NAMELEN);
+        rt->if_index = index[e.iface];
+        rt->block = block;
+        rt->next  = rt + 1;
+    }
+    block[n - 1].next = 0;
+
+    *out = block;
+    return 0;
+} /* -- sr_rt_parse_bin -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_unknown_if(..)
+ * Scope: Local
+ *
+ * Whether any of routes names an interface the router does not have.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_rt_unknown_if(struct sr_rt* routes)
+{
+    for(; routes; routes = routes->next)
+    {
+        if(routes->if_index == SR_IF_NONE)
+        { return 1; }
+    }
+    return 0;
+} /* -- sr_rt_unknown_if -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_load_rt(..)
+ * Scope: Global
+ *
+ * Read a routing table file, text ("dest gw mask iface" per line) or
+ * binary (sr_rt_save_bin()), and make it the routing table, see
+ * sr_rt_publish().  Safe while packets are being forwarded.  On error,
+ * if the file has no routes, or if the interfaces are known and a route
+ * names one that is not among them, the current table stays.
  *
  *---------------------------------------------------------------------*/
 
 int sr_load_rt(struct sr_instance* sr,const char* filename)
 {
-    FILE* fp;
-    char  line[BUFSIZ];
-    char  dest[32];
-    char  gw[32];
-    char  mask[32];
-    char  iface[32];
-    struct in_addr dest_addr;
-    struct in_addr gw_addr;
-    struct in_addr mask_addr;
-    int clear_routing_table = 0;
+    int           fd;
+    struct stat   st;
+    void*         map = 0;
+    struct sr_rt* routes = 0;
+    int           ret = 0;
 
     /* -- REQUIRES -- */
     assert(filename);
@@ -48,46 +432,137 @@ int sr_load_rt(struct sr_instance* sr,const char* filename)
         return -1;
     }
 
-    fp = fopen(filename,"r");
+    if((fd = open(filename, O_RDONLY)) == -1 || fstat(fd, &st) != 0)
+    {
+        perror("open");
+        if(fd != -1)
+        { close(fd); }
+        return -1;
+    }
 
-    while( fgets(line,BUFSIZ,fp) != 0)
+    /* -- parsed straight out of the page cache -- */
+    if(st.st_size > 0)
     {
-        sscanf(line,"%s %s %s %s",dest,gw,mask,iface);
-        if(inet_aton(dest,&dest_addr) == 0)
+        map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED)
         {
-            fprintf(stderr,
-                    "Error loading routing table, cannot convert %s to valid IP\n",
-                    dest);
+            perror("mmap");
+            close(fd);
             return -1;
         }
-        if(inet_aton(gw,&gw_addr) == 0)
+        if((size_t)st.st_size >= sizeof(struct sr_rt_bin_hdr) &&
+           memcmp(map, SR_RT_BIN_MAGIC, 4) == 0)
+        { ret = sr_rt_parse_bin(sr, map, st.st_size, &routes); }
+        else
+        { ret = sr_rt_parse_text(sr, map, st.st_size, &routes); }
+        munmap(map, st.st_size);
+    }
+    close(fd);
+
+    if(ret != 0)
+    { return -1; }
+    if(routes == 0)
+    { return 0; }
+
+    /* -- once the interfaces are known every route must name one -- */
+    if(sr->if_list && sr_rt_unknown_if(routes))
+    {
+        fprintf(stderr,"Routing table %s not consistent with hardware, "
+                "keeping the current one\n", filename);
+        sr_rt_free(routes);
+        return -1;
+    }
+
+    printf("Loading routing table from server, clear local routing table.\n");
+    if(sr_rt_publish(sr, routes) != 0)
+    {
+        fprintf(stderr,"Error building forwarding table\n");
+        sr_rt_free(routes);
+        return -1;
+    }
+
+    return 0; /* -- success -- */
+} /* -- sr_load_rt -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_save_bin(..)
+ * Scope: Global
+ *
+ * Write routes as a binary routing table (see sr_rt.h).  Every mask must
+ * be a prefix and there can be at most 256 interface names.  Returns 0
+ * on success.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_save_bin(struct sr_rt* routes, const char* filename)
+{
+    struct sr_rt_bin_hdr   hdr;
+    struct sr_rt_bin_entry e;
+    char                   names[256][SR_RT_BIN_NAMELEN];
+    uint32_t               n = 0, nifaces = 0, i, mask;
+    struct sr_rt*          rt_walker;
+    FILE*                  fp;
+
+    memset(names, 0, sizeof(names));
+    for(rt_walker = routes; rt_walker; rt_walker = rt_walker->next, n++)
+    {
+        mask = ~ntohl(rt_walker->mask.s_addr);
+        if(mask & (mask + 1)) /* host part is not all the low bits */
+        { return -1; }
+        for(i = 0; i < nifaces; i++)
         {
-            fprintf(stderr,
-                    "Error loading routing table, cannot convert %s to valid IP\n",
-                    gw);
-            return -1;
+            if(strncmp(names[i], rt_walker->interface, SR_RT_BIN_NAMELEN) == 0)
+            { break; }
         }
-        if(inet_aton(mask,&mask_addr) == 0)
+        if(i == nifaces)
         {
-            fprintf(stderr,
-                    "Error loading routing table, cannot convert %s to valid IP\n",
-                    mask);
-            return -1;
+            if(nifaces == 256)
+            { return -1; }
+            strncpy(names[nifaces++], rt_walker->interface, SR_RT_BIN_NAMELEN);
         }
-        if( clear_routing_table == 0 ){
-            printf("Loading routing table from server, clear local routing table.\n");
-            sr->routing_table = 0;
-            clear_routing_table = 1;
-        }
-        sr_add_rt_entry(sr,dest_addr,gw_addr,mask_addr,iface);
-    } /* -- while -- */
+    }
 
-    return 0; /* -- success -- */
-} /* -- sr_load_rt -- */
+    if((fp = fopen(filename, "w")) == 0)
+    {
+        perror(filename);
+        return -1;
+    }
+
+    memcpy(hdr.magic, SR_RT_BIN_MAGIC, 4);
+    hdr.version = htonl(SR_RT_BIN_VERSION);
+    hdr.nroutes = htonl(n);
+    hdr.nifaces = htonl(nifaces);
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(names, SR_RT_BIN_NAMELEN, nifaces, fp);
+
+    memset(&e, 0, sizeof(e));
+    for(rt_walker = routes; rt_walker; rt_walker = rt_walker->next)
+    {
+        for(i = 0; strncmp(names[i], rt_walker->interface, SR_RT_BIN_NAMELEN); i++)
+        { ; }
+        for(mask = ntohl(rt_walker->mask.s_addr), e.plen = 0; mask;
+            mask <<= 1, e.plen++)
+        { ; }
+        e.dest  = rt_walker->dest.s_addr;
+        e.gw    = rt_walker->gw.s_addr;
+        e.iface = i;
+        fwrite(&e, sizeof(e), 1, fp);
+    }
+
+    if(fclose(fp) != 0)
+    {
+        perror(filename);
+        return -1;
+    }
+    return 0;
+} /* -- sr_rt_save_bin -- */
 
 /*---------------------------------------------------------------------
  * Method:
  *
+ * Appends to the routing table in place: only for setting up the table
+ * before packets flow, sr_rt_build_fib() publishes it.
+ *
  *---------------------------------------------------------------------*/
 
 void sr_add_rt_entry(struct sr_instance* sr, struct in_addr dest,
@@ -102,14 +577,7 @@ struct in_addr gw, struct in_addr mask,char* if_name)
     /* -- empty list special case -- */
     if(sr->routing_table == 0)
     {
-        sr->routing_table = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-        assert(sr->routing_table);
-        sr->routing_table->next = 0;
-        sr->routing_table->dest = dest;
-        sr->routing_table->gw   = gw;
-        sr->routing_table->mask = mask;
-        strncpy(sr->routing_table->interface,if_name,sr_IFACE_NAMELEN);
-
+        sr->routing_table = sr_rt_new(sr,dest,gw,mask,if_name);
         return;
     }
 
@@ -119,18 +587,214 @@ struct in_addr gw, struct in_addr mask,char* if_name)
       rt_walker = rt_walker->next;
     }
 
-    rt_walker->next = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-    assert(rt_walker->next);
-    rt_walker = rt_walker->next;
-
-    rt_walker->next = 0;
-    rt_walker->dest = dest;
-    rt_walker->gw   = gw;
-    rt_walker->mask = mask;
-    strncpy(rt_walker->interface,if_name,sr_IFACE_NAMELEN);
+    rt_walker->next = sr_rt_new(sr,dest,gw,mask,if_name);
 
 } /* -- sr_add_entry -- */
 
+/*---------------------------------------------------------------------
+ * Method: sr_rt_build_fib(..)
+ * Scope: Global
+ *
+ * (Re)compile sr->routing_table into the FIB used by longestprefixmatch.
+ * Must be called after the routing list changes.  Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_build_fib(struct sr_instance* sr)
+{
+    /* -- REQUIRES -- */
+    assert(sr);
+
+    return sr_rt_publish(sr, sr->routing_table);
+} /* -- sr_rt_build_fib -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_hup_handler(..)
+ * Scope: Local
+ *
+ *---------------------------------------------------------------------*/
+
+static void sr_rt_hup_handler(int sig)
+{
+    sr_rt_hup = 1;
+} /* -- sr_rt_hup_handler -- */
+
+/* -- what the watcher thread is given -- */
+struct sr_rt_watch
+{
+    struct sr_instance* sr;
+    char                filename[BUFSIZ];
+};
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_watch_main(..)
+ * Scope: Local
+ *
+ * Watcher thread: once a second, reload the routing table if SIGHUP
+ * came in or if the file changed and then stayed the same for a second,
+ * so a table still being written is not picked up half way.
+ *
+ *---------------------------------------------------------------------*/
+
+static void* sr_rt_watch_main(void* arg)
+{
+    struct sr_rt_watch* w = arg;
+    struct stat         loaded, seen, now;
+
+    if(stat(w->filename, &loaded) != 0)
+    { memset(&loaded, 0, sizeof(loaded)); }
+    seen = loaded;
+
+    while(1)
+    {
+        sleep(1);
+
+        if(stat(w->filename, &now) != 0)
+        { continue; }
+
+        if(!sr_rt_hup)
+        {
+            if(SR_RT_SAME_FILE(now, loaded) || !SR_RT_SAME_FILE(now, seen))
+            {
+                seen = now;
+                continue;
+            }
+        }
+        sr_rt_hup = 0;
+
+        if(sr_load_rt(w->sr, w->filename) != 0)
+        { fprintf(stderr,"Error reloading routing table from %s\n", w->filename); }
+        else
+        { printf("Reloaded routing table from %s\n", w->filename); }
+        loaded = seen = now;
+    }
+
+    return 0;
+} /* -- sr_rt_watch_main -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_watch(..)
+ * Scope: Global
+ *
+ * Reload the routing table from filename when the file is replaced or
+ * the process gets SIGHUP, in a thread of its own.  Returns 0 on success.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_watch(struct sr_instance* sr, const char* filename)
+{
+    struct sr_rt_watch* w;
+    struct sigaction    sa;
+    pthread_t           thread;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+    assert(filename);
+
+    if((w = (struct sr_rt_watch*)malloc(sizeof(struct sr_rt_watch))) == 0)
+    { return -1; }
+    w->sr = sr;
+    strncpy(w->filename, filename, BUFSIZ - 1);
+    w->filename[BUFSIZ - 1] = 0;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sr_rt_hup_handler;
+    sa.sa_flags   = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGHUP, &sa, 0);
+
+    if(pthread_create(&thread, 0, sr_rt_watch_main, w) != 0)
+    {
+        free(w);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+} /* -- sr_rt_watch -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_lookup_linear(..)
+ * Scope: Global
+ *
+ * Longest prefix match by walking the routing list.  Only used when no
+ * FIB has been built and as a reference for the FIB.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_rt_lookup_linear(struct sr_rt* routes, uint32_t target_ip)
+{
+    struct sr_rt* next = routes;
+    struct sr_rt* nexthop = 0;
+    uint32_t mask,longest = 0;
+
+    while(next)
+    {
+        mask = ntohl(next->mask.s_addr);
+        if((mask&ntohl(next->dest.s_addr))==(mask&ntohl(target_ip)))
+        {
+            if(!nexthop||(mask > longest))
+            {
+                nexthop = next;
+                longest = mask;
+            }
+        }
+        next = next->next;
+    }
+    return nexthop;
+} /* -- sr_rt_lookup_linear -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_verify_routing_table()
+ * Scope: Global
+ *
+ * make sure the routing table is consistent with the interface list by
+ * verifying that all interfaces used in the routing table actually exist
+ * in the hardware, and give each route the index of its interface.
+ *
+ * RETURN VALUES:
+ *
+ *  0 on success
+ *  something other than zero on error
+ *
+ *---------------------------------------------------------------------------*/
+
+int sr_verify_routing_table(struct sr_instance* sr)
+{
+    struct sr_rt* rt_walker = 0;
+    struct sr_if* if_walker = 0;
+    int ret = 0;
+
+    /* -- REQUIRES --*/
+    assert(sr);
+
+    if( (sr->if_list == 0) || (sr->routing_table == 0))
+    {
+        return 999; /* doh! */
+    }
+
+    rt_walker = sr->routing_table;
+
+    while(rt_walker)
+    {
+        /* -- check to see if interface exists -- */
+        if_walker = sr->if_list;
+        while(if_walker)
+        {
+            if( strncmp(if_walker->name,rt_walker->interface,sr_IFACE_NAMELEN)
+                    == 0)
+            { break; }
+            if_walker = if_walker->next;
+        }
+        if(if_walker == 0)
+        { ret++; } /* -- interface not found! -- */
+        rt_walker->if_index = if_walker ? if_walker->index : SR_IF_NONE;
+
+        rt_walker = rt_walker->next;
+    } /* -- while -- */
+
+    return ret;
+} /* -- sr_verify_routing_table -- */
+
 /*---------------------------------------------------------------------
  * Method:
  *
@@ -33,13 +33,51 @@ struct sr_rt
     struct in_addr gw;
     struct in_addr mask;
     char   interface[sr_IFACE_NAMELEN];
+    unsigned int if_index;  /* of interface, SR_IF_NONE until it exists */
     struct sr_rt* next;
+    struct sr_rt* block;    /* array holding a loaded table, 0 if malloc'd alone */
+};
+
+/* ----------------------------------------------------------------------------
+ * Binary routing table
+ *
+ * What sr_rt_save_bin() writes and sr_load_rt() takes as well as text: a
+ * header, nifaces interface names of SR_RT_BIN_NAMELEN bytes (zero
+ * padded) and nroutes entries naming their interface by position.
+ * Everything is in network order.
+ *
+ * -------------------------------------------------------------------------- */
+
+#define SR_RT_BIN_MAGIC   "SRRT"
+#define SR_RT_BIN_VERSION 1
+#define SR_RT_BIN_NAMELEN 16    /* as in the VNS protocol */
+
+struct sr_rt_bin_hdr
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t nroutes;
+    uint32_t nifaces;
+};
+
+struct sr_rt_bin_entry
+{
+    uint32_t dest;
+    uint32_t gw;
+    uint8_t  plen;      /* mask length */
+    uint8_t  iface;     /* index into the names */
+    uint16_t pad;
 };
 
 
 int sr_load_rt(struct sr_instance*,const char*);
 void sr_add_rt_entry(struct sr_instance*, struct in_addr,struct in_addr,
                   struct in_addr, char*);
+int sr_rt_build_fib(struct sr_instance*);
+int sr_rt_watch(struct sr_instance*, const char*);
+int sr_rt_save_bin(struct sr_rt*, const char*);
+struct sr_rt* sr_rt_lookup_linear(struct sr_rt*, uint32_t);
+int sr_verify_routing_table(struct sr_instance* sr);
 void sr_print_routing_table(struct sr_instance* sr);
 void sr_print_routing_entry(struct sr_rt* entry);
 
@@ -0,0 +1,170 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_timer.c
+ *
+ * Description:
+ *
+ * Hashed timing wheel, see sr_timer.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "sr_timer.h"
+
+/*---------------------------------------------------------------------
+ * Method: sr_timer_now()
+ * Scope: Global
+ *
+ * Milliseconds on the monotonic clock, the wheel's time.
+ *
+ *---------------------------------------------------------------------*/
+
+uint64_t sr_timer_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+} /* -- sr_timer_now -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_wheel_init(..)
+ * Scope: Global
+ *
+ * An empty wheel that has run up to now.  Returns 0, or -1 if out of
+ * memory.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_wheel_init(struct sr_wheel* w)
+{
+    w->slots = (struct sr_timer**)calloc(SR_WHEEL_SLOTS,
+                                         sizeof(struct sr_timer*));
+    w->now   = sr_timer_now();
+    w->count = 0;
+    return w->slots ? 0 : -1;
+} /* -- sr_wheel_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_wheel_destroy(..)
+ * Scope: Global
+ *
+ * Timers still on the wheel belong to their owners and are left alone.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_wheel_destroy(struct sr_wheel* w)
+{
+    free(w->slots);
+    w->slots = 0;
+} /* -- sr_wheel_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_wheel_add(..)
+ * Scope: Global
+ *
+ * Schedule t, which is not on the wheel, for expires.  A time already
+ * past goes in the next slot to run.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_wheel_add(struct sr_wheel* w, struct sr_timer* t, uint64_t expires)
+{
+    struct sr_timer** slot;
+
+    t->expires = expires;
+    slot = &w->slots[(expires > w->now ? expires : w->now + 1) &
+                     (SR_WHEEL_SLOTS - 1)];
+    t->next  = *slot;
+    t->pprev = slot;
+    if(t->next)
+    { t->next->pprev = &t->next; }
+    *slot = t;
+    w->count++;
+} /* -- sr_wheel_add -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_wheel_del(..)
+ * Scope: Global
+ *
+ * Take t off the wheel, nothing if it is not on it.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_wheel_del(struct sr_wheel* w, struct sr_timer* t)
+{
+    if(!t->pprev)
+    { return; }
+    *t->pprev = t->next;
+    if(t->next)
+    { t->next->pprev = t->pprev; }
+    t->next  = 0;
+    t->pprev = 0;
+    w->count--;
+} /* -- sr_wheel_del -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_wheel_expire(..)
+ * Scope: Global
+ *
+ * Run the wheel up to now: take off every timer that expires by then and
+ * return them linked through next, soonest slot first.  They are off the
+ * wheel and may be added again.  After a gap of more than a turn every
+ * slot is looked at once.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_timer* sr_wheel_expire(struct sr_wheel* w, uint64_t now)
+{
+    struct sr_timer*  head = 0;
+    struct sr_timer** tail = &head;
+    struct sr_timer*  t;
+    struct sr_timer*  next;
+    uint64_t          tick, last;
+
+    if(now <= w->now)
+    { return 0; }
+
+    last = now - w->now > SR_WHEEL_SLOTS ? w->now + SR_WHEEL_SLOTS : now;
+    for(tick = w->now + 1; tick <= last && w->count; tick++)
+    {
+        for(t = w->slots[tick & (SR_WHEEL_SLOTS - 1)]; t; t = next)
+        {
+            next = t->next;
+            if(t->expires > now)
+            { continue; }
+            sr_wheel_del(w, t);
+            *tail = t;
+            tail  = &t->next;
+        }
+    }
+    *tail  = 0;
+    w->now = now;
+    return head;
+} /* -- sr_wheel_expire -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_wheel_next(..)
+ * Scope: Global
+ *
+ * When the wheel next needs running: the tick of the first slot ahead
+ * holding a timer, or limit if that is sooner.  A slot may hold only
+ * timers a turn or more away, so this can be early but never late.
+ *
+ *---------------------------------------------------------------------*/
+
+uint64_t sr_wheel_next(struct sr_wheel* w, uint64_t limit)
+{
+    uint64_t tick;
+
+    if(!w->count)
+    { return limit; }
+    for(tick = w->now + 1; tick < limit && tick <= w->now + SR_WHEEL_SLOTS;
+        tick++)
+    {
+        if(w->slots[tick & (SR_WHEEL_SLOTS - 1)])
+        { return tick; }
+    }
+    return limit;
+} /* -- sr_wheel_next -- */
@@ -0,0 +1,56 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_timer.h
+ *
+ * Description:
+ *
+ * Hashed timing wheel with millisecond ticks.
+ *
+ * A timer goes on the list of the slot its expiry hashes to, so adding
+ * and removing one is constant time, and running the wheel up to now
+ * visits only the slots for the milliseconds that passed.  A timer more
+ * than a turn of the wheel away is left in its slot when the slot comes
+ * round early.  Timers are embedded in whatever they time and the wheel
+ * allocates nothing after init.
+ *
+ * Not thread safe, the owner locks.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_TIMER_H
+#define sr_TIMER_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_WHEEL_BITS  14
+#define SR_WHEEL_SLOTS (1 << SR_WHEEL_BITS)  /* 16.4 s around */
+
+struct sr_timer
+{
+    uint64_t          expires;  /* ms, on the sr_timer_now() clock */
+    unsigned int      kind;     /* the owner's, e.g. what the timer is for */
+    struct sr_timer*  next;
+    struct sr_timer** pprev;    /* 0 when not on the wheel */
+};
+
+struct sr_wheel
+{
+    uint64_t          now;      /* slots up to here have been run */
+    unsigned long     count;    /* timers on the wheel */
+    struct sr_timer** slots;
+};
+
+uint64_t sr_timer_now(void);
+int  sr_wheel_init(struct sr_wheel* w);
+void sr_wheel_destroy(struct sr_wheel* w);
+void sr_wheel_add(struct sr_wheel* w, struct sr_timer* t, uint64_t expires);
+void sr_wheel_del(struct sr_wheel* w, struct sr_timer* t);
+struct sr_timer* sr_wheel_expire(struct sr_wheel* w, uint64_t now);
+uint64_t sr_wheel_next(struct sr_wheel* w, uint64_t limit);
+
+#endif  /* --  sr_TIMER_H -- */
@@ -3,20 +3,30 @@
 #include <string.h>
 #include "sr_protocol.h"
 #include "sr_utils.h"
+#include "inet_cksum.h"
 
 
+/* Word at a time, vectorised where the CPU allows; see inet_cksum.h. */
 uint16_t cksum (const void *_data, int len) {
-  const uint8_t *data = _data;
-  uint32_t sum;
-
-  for (sum = 0;len >= 2; data += 2, len -= 2)
-    sum += data[0] << 8 | data[1];
-  if (len > 0)
-    sum += data[0] << 8;
-  while (sum > 0xffff)
-    sum = (sum >> 16) + (sum & 0xffff);
-  sum = htons (~sum);
-  return sum ? sum : 0xffff;
+  return inet_cksum(_data, len);
+}
+
+/* True if the one's complement sum over len bytes, stored checksum
+   included, is all ones. Verifies a header without zeroing its checksum. */
+int cksum_ok (const void *_data, int len) {
+  return cksum(_data, len) == 0xffff;
+}
+
+/* RFC 1624 eqn. 3: the checksum sum (as stored) after a 16-bit field of
+   the data it covers changes from old to new. All three are in network
+   byte order. Gives the same result as recomputing with cksum(). */
+uint16_t cksum_update16 (uint16_t sum, uint16_t old, uint16_t new) {
+  uint32_t s = (uint16_t)~sum + (uint32_t)(uint16_t)~old + new;
+
+  s = (s & 0xffff) + (s >> 16);
+  s = (s & 0xffff) + (s >> 16);
+  s = (uint16_t)~s;
+  return s ? s : 0xffff;
 }
 
 
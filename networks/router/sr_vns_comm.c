@@ -32,23 +32,34 @@
 #include <errno.h>
 
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
 
-#include "sr_dumper.h"
+#include "sr_pcap.h"
 #include "sr_router.h"
 #include "sr_if.h"
+#include "sr_rt.h"
+#include "sr_pipeline.h"
+#include "sr_burst.h"
+#include "sr_dst.h"
 #include "sr_protocol.h"
 
 #include "sha1.h"
 #include "vnscommand.h"
 
-static void sr_log_packet(struct sr_instance* , uint8_t* , int );
+/* -- a received frame's VNS header doubles as its headroom -- */
+typedef char sr_headroom_check[(SR_PKT_HEADROOM == sizeof(c_packet_header)) ? 1 : -1];
+
+static void sr_log_packet(struct sr_instance* , uint8_t* , int ,
+                          const char* , enum sr_pcap_dir );
 static int  sr_arp_req_not_for_us(struct sr_instance* sr,
                                   uint8_t * packet /* lent */,
                                   unsigned int len,
-                                  char* interface  /* lent */);
+                                  struct sr_if* iface  /* lent */);
+static int  sr_vns_packet_in(struct sr_instance* sr, uint8_t* buf, int len,
+                             struct sr_burst_frame* frame);
 int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expected_cmd);
 
 /*-----------------------------------------------------------------------------
@@ -62,32 +73,17 @@ static void sr_session_closed_help()
 }
 
 /*-----------------------------------------------------------------------------
- * Method: sr_connect_to_server()
- * Scope: Global
- *
- * Connect to the virtual server
- *
- * RETURN VALUES:
+ * Method: sr_connect_inet(..), sr_connect_unix(..)
+ * Scope: Local
  *
- *  0 on success
- *  something other than zero on error
+ * Open sr->sockfd to the server at server:port, or at the Unix socket
+ * path.  0 on success.
  *
  *---------------------------------------------------------------------------*/
-int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
-                         char* server)
+static int sr_connect_inet(struct sr_instance* sr, unsigned short port,
+                           char* server)
 {
     struct hostent *hp;
-    c_open command;
-    c_open_template ot;
-    char* buf;
-    uint32_t buf_len;
-
-    /* REQUIRES */
-    assert(sr);
-    assert(server);
-
-    /* purify UMR be gone ! */
-    memset((void*)&command,0,sizeof(c_open));
 
     /* zero out server address struct */
     memset(&(sr->sr_addr),0,sizeof(struct sockaddr_in));
@@ -98,7 +94,7 @@ int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
     /* grab hosts address from domain name */
     if ((hp = gethostbyname(server))==0)
     {
-        perror("gethostbyname:sr_client.c::sr_connect_to_server(..)");
+        perror("gethostbyname:sr_client.c::sr_connect_inet(..)");
         return -1;
     }
 
@@ -108,7 +104,7 @@ int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
     /* create socket */
     if ((sr->sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
     {
-        perror("socket(..):sr_client.c::sr_connect_to_server(..)");
+        perror("socket(..):sr_client.c::sr_connect_inet(..)");
         return -1;
     }
 
@@ -116,11 +112,72 @@ int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
     if (connect(sr->sockfd, (struct sockaddr *)&(sr->sr_addr),
                 sizeof(sr->sr_addr)) < 0)
     {
-        perror("connect(..):sr_client.c::sr_connect_to_server(..)");
+        perror("connect(..):sr_client.c::sr_connect_inet(..)");
         close(sr->sockfd);
         return -1;
     }
 
+    return 0;
+} /* -- sr_connect_inet -- */
+
+static int sr_connect_unix(struct sr_instance* sr, char* path)
+{
+    struct sockaddr_un sun;
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strncpy(sun.sun_path, path, sizeof(sun.sun_path) - 1);
+
+    if ((sr->sockfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+        perror("socket(..):sr_client.c::sr_connect_unix(..)");
+        return -1;
+    }
+    if (connect(sr->sockfd, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+    {
+        perror("connect(..):sr_client.c::sr_connect_unix(..)");
+        close(sr->sockfd);
+        return -1;
+    }
+    return 0;
+} /* -- sr_connect_unix -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_connect_to_server()
+ * Scope: Global
+ *
+ * Connect to the virtual server
+ *
+ * RETURN VALUES:
+ *
+ *  0 on success
+ *  something other than zero on error
+ *
+ *---------------------------------------------------------------------------*/
+int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
+                         char* server)
+{
+    c_open command;
+    c_open_template ot;
+    char* buf;
+    uint32_t buf_len;
+
+    /* REQUIRES */
+    assert(sr);
+    assert(server);
+
+    /* purify UMR be gone ! */
+    memset((void*)&command,0,sizeof(c_open));
+
+    /* -- a path is the Unix socket of a local server (sr_vns_server -U) -- */
+    if(strchr(server, '/'))
+    {
+        if(sr_connect_unix(sr, server) != 0)
+        { return -1; }
+    }
+    else if(sr_connect_inet(sr, port, server) != 0)
+    { return -1; }
+
     /* wait for authentication to be completed (server sends the first message) */
     if(sr_read_from_server_expect(sr, VNS_AUTH_REQUEST)!= 1 ||
        sr_read_from_server_expect(sr, VNS_AUTH_STATUS) != 1)
@@ -331,80 +388,92 @@ int sr_read_from_server(struct sr_instance* sr /* borrowed */)
     return sr_read_from_server_expect(sr, 0);
 }
 
-int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expected_cmd)
+/*-----------------------------------------------------------------------------
+ * Method: sr_read_done(..)
+ * Scope: Local
+ *
+ * Common exit of sr_read_from_server_expect: the reader's send batch is
+ * flushed if the session is ending and detached from the thread.
+ *
+ *---------------------------------------------------------------------------*/
+
+static int sr_read_done(struct sr_instance* sr, int ret)
 {
-    int command, len;
-    unsigned char *buf = 0;
-    c_packet_ethernet_header* sr_pkt = 0;
-    int ret = 0, bytes_read = 0;
+    if(ret != 1)
+    { sr_txbatch_flush(sr, &sr->vns_rx.tx); }
+    sr_txbatch_use(0);
+    return ret;
+} /* -- sr_read_done -- */
 
-    /* REQUIRES */
-    assert(sr);
+/*-----------------------------------------------------------------------------
+ * Method: sr_vns_packet_in(..)
+ * Scope: Local
+ *
+ * Take in a VNSPACKET command: count and log the frame and look up the
+ * interface it came in on.  Returns 1 with the frame in *frame if the
+ * router should handle it, 0 if it is dropped here.
+ *
+ *---------------------------------------------------------------------------*/
 
-    /*---------------------------------------------------------------------------
-      Read a command from the server
-      -------------------------------------------------------------------------*/
+static int sr_vns_packet_in(struct sr_instance* sr, uint8_t* buf, int len,
+                            struct sr_burst_frame* frame)
+{
+    c_packet_ethernet_header* sr_pkt = (c_packet_ethernet_header *)buf;
+    struct sr_if* iface = 0;
+    unsigned int frame_len;
 
-    bytes_read = 0;
+    SR_STAT_INC(sr, rx);
+    frame_len = len - sizeof(c_packet_ethernet_header) +
+                sizeof(struct sr_ethernet_hdr);
 
-    /* attempt to read the size of the incoming packet */
-    while( bytes_read < 4)
+    /* -- the only lookup by name, from here on the index -- */
+    if((iface = sr_get_interface(sr, sr_pkt->mInterfaceName)) == 0)
     {
-        do
-        { /* -- just in case SIGALRM breaks recv -- */
-            errno = 0; /* -- hacky glibc workaround -- */
-            if((ret = recv(sr->sockfd,((uint8_t*)&len) + bytes_read,
-                            4 - bytes_read, 0)) == -1)
-            {
-                if ( errno == EINTR )
-                { continue; }
-
-                perror("recv(..):sr_client.c::sr_read_from_server");
-                return -1;
-            }
-            bytes_read += ret;
-        } while ( errno == EINTR); /* be mindful of signals */
-
+        fprintf(stderr, "** Error, interface %.16s, does not exist\n",
+                sr_pkt->mInterfaceName);
+        return 0;
     }
+    SR_IF_STAT_ADD(sr, iface->index, rx_packets, 1);
+    SR_IF_STAT_ADD(sr, iface->index, rx_bytes, frame_len);
 
-    len = ntohl(len);
-
-    if ( len > 10000 || len < 0 )
+    /* -- check if it is an ARP to another router if so drop   -- */
+    if ( sr_arp_req_not_for_us(sr,
+            (buf+sizeof(c_packet_header)), frame_len, iface) )
     {
-        fprintf(stderr,"Error: command length to large %d\n",len);
-        close(sr->sockfd);
-        return -1;
+        SR_IF_STAT_ADD(sr, iface->index, drops, 1);
+        return 0;
     }
 
-    if((buf = malloc(len)) == 0)
-    {
-        fprintf(stderr,"Error: out of memory (sr_read_from_server)\n");
-        return -1;
-    }
+    /* -- log packet -- */
+    sr_log_packet(sr, buf + sizeof(c_packet_header),
+            ntohl(sr_pkt->mLen) - sizeof(c_packet_header),
+            sr_pkt->mInterfaceName, sr_pcap_in);
+
+    frame->packet   = buf + sizeof(c_packet_header);
+    frame->len      = frame_len;
+    frame->if_index = iface->index;
+    return 1;
+} /* -- sr_vns_packet_in -- */
+
+int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expected_cmd)
+{
+    int command, len;
+    unsigned char *buf = 0;
+    struct sr_burst_frame burst[SR_BURST_MAX];
+    unsigned int n;
+    int ret = 0;
+
+    /* REQUIRES */
+    assert(sr);
 
-    /* set first field of command since we've already read it */
-    *((int *)buf) = htonl(len);
+    /*---------------------------------------------------------------------------
+      Read a command from the server, see sr_vns_io.c for the buffering
+      -------------------------------------------------------------------------*/
 
-    bytes_read = 0;
+    sr_txbatch_use(&sr->vns_rx.tx);
 
-    /* read the rest of the command */
-    while ( bytes_read < len - 4)
-    {
-        do
-        {/* -- just in case SIGALRM breaks recv -- */
-            errno = 0; /* -- hacky glibc workaround -- */
-            if ((ret = read(sr->sockfd, buf+4+bytes_read, len - 4 - bytes_read)) ==
-                    -1)
-            {
-                if ( errno == EINTR )
-                { continue; }
-                fprintf(stderr,"Error: failed reading command body %d\n",ret);
-                close(sr->sockfd);
-                return -1;
-            }
-            bytes_read += ret;
-        } while (errno == EINTR); /* be mindful of signals */
-    }
+    if((buf = sr_vns_rx_next(sr, &len)) == 0)
+    { return sr_read_done(sr, -1); }
 
     /* My entry for most unreadable line of code - guido */
     /* ... you win - mc                                  */
@@ -414,7 +483,7 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
     if(expected_cmd && command!=expected_cmd) {
         if(command != VNSCLOSE) { /* VNSCLOSE is always ok */
             fprintf(stderr, "Error: expected command %d but got %d\n", expected_cmd, command);
-            return -1;
+            return sr_read_done(sr, -1);
         }
     }
 
@@ -424,26 +493,36 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
         /* -------------        VNSPACKET     -------------------- */
 
         case VNSPACKET:
-            sr_pkt = (c_packet_ethernet_header *)buf;
-
-            /* -- check if it is an ARP to another router if so drop   -- */
-            if ( sr_arp_req_not_for_us(sr,
-                    (buf+sizeof(c_packet_header)),
-                    len - sizeof(c_packet_ethernet_header) +
-                    sizeof(struct sr_ethernet_hdr),
-                    (char*)(buf + sizeof(c_base))) )
+            if(!sr_vns_packet_in(sr, buf, len, &burst[0]))
             { break; }
 
-            /* -- log packet -- */
-            sr_log_packet(sr, buf + sizeof(c_packet_header),
-                    ntohl(sr_pkt->mLen) - sizeof(c_packet_header));
+            /* -- with -j a worker takes a reference to the chunk -- */
+            if(sr->pipeline)
+            {
+                sr_pipeline_dispatch(sr, sr->vns_rx.chunk, burst[0].packet,
+                        burst[0].len, burst[0].if_index);
+                break;
+            }
+
+            /* -- with -b the packets already received behind it go too,
+                  all in this chunk until the send batch is flushed -- */
+            if(sr->burst > 1)
+            {
+                for(n = 1; n < sr->burst && n < SR_BURST_MAX &&
+                        (buf = sr_vns_rx_packet(sr, &len)) != 0; )
+                {
+                    if(sr_vns_packet_in(sr, buf, len, &burst[n]))
+                    { n++; }
+                }
+                sr_handlepacket_burst(sr, burst, n);
+                break;
+            }
 
-            /* -- pass to router, student's code should take over here -- */
-            sr_handlepacket(sr,
-                    (buf+sizeof(c_packet_header)),
-                    len - sizeof(c_packet_ethernet_header) +
-                    sizeof(struct sr_ethernet_hdr),
-                    (char*)(buf + sizeof(c_base)));
+            /* -- pass to router, student's code should take over here.
+                  The VNS header in front of the frame is its headroom -- */
+            sr->vns_rx.tx.frame = burst[0].packet;
+            sr_handlepacket_if(sr, burst[0].packet, burst[0].len,
+                    burst[0].if_index);
 
             break;
 
@@ -454,9 +533,7 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
             fprintf(stderr,"Reason: %s\n",((c_close*)buf)->mErrorMessage);
             sr_session_closed_help();
 
-            if(buf)
-            { free(buf); }
-            return 0;
+            return sr_read_done(sr, 0);
             break;
 
             /* -------------        VNSBANNER      -------------------- */
@@ -472,7 +549,7 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
             if(sr_verify_routing_table(sr) != 0)
             {
                 fprintf(stderr,"Routing table not consistent with hardware\n");
-                return -1;
+                return sr_read_done(sr, -1);
             }
             printf(" <-- Ready to process packets --> \n");
             break;
@@ -501,9 +578,7 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
 
     }/* -- switch -- */
 
-    if(buf)
-    { free(buf); }
-    return ret;
+    return sr_read_done(sr, ret);
 }/* -- sr_read_from_server -- */
 
 /*-----------------------------------------------------------------------------
@@ -517,23 +592,16 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
 static int
 sr_ether_addrs_match_interface( struct sr_instance* sr, /* borrowed */
                                 uint8_t* buf, /* borrowed */
-                                const char* name /* borrowed */ )
+                                struct sr_if* iface /* borrowed */ )
 {
     struct sr_ethernet_hdr* ether_hdr = 0;
-    struct sr_if* iface = 0;
 
     /* -- REQUIRES -- */
     assert(sr);
     assert(buf);
-    assert(name);
+    assert(iface);
 
     ether_hdr = (struct sr_ethernet_hdr*)buf;
-    iface = sr_get_interface(sr, name);
-
-    if ( iface == 0 ){
-        fprintf( stderr, "** Error, interface %s, does not exist\n", name);
-        return 0;
-    }
 
     if ( memcmp( ether_hdr->ether_shost, iface->addr, ETHER_ADDR_LEN) != 0 ){
         fprintf( stderr, "** Error, source address does not match interface\n");
@@ -555,7 +623,9 @@ sr_ether_addrs_match_interface( struct sr_instance* sr, /* borrowed */
  * Scope: Global
  *
  * Send a packet (ethernet header included!) of length 'len' to the server
- * to be injected onto the wire.
+ * to be injected onto the wire.  The VNS header is written into the
+ * SR_PKT_HEADROOM bytes in front of buf, so buf must have been received
+ * from the server or allocated with that much room to spare.
  *
  *---------------------------------------------------------------------------*/
 
@@ -563,50 +633,137 @@ int sr_send_packet(struct sr_instance* sr /* borrowed */,
                          uint8_t* buf /* borrowed */ ,
                          unsigned int len,
                          const char* iface /* borrowed */)
+{
+    struct sr_if* if_rec = 0;
+
+    /* REQUIRES */
+    assert(sr);
+    assert(buf);
+    assert(iface);
+
+    if ( (if_rec = sr_get_interface(sr, iface)) == 0 ){
+        fprintf( stderr, "** Error, interface %s, does not exist\n", iface);
+        return -1;
+    }
+
+    return sr_send_packet_if(sr, buf, len, if_rec->index);
+} /* -- sr_send_packet -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_send_packet_if(..)
+ * Scope: Global
+ *
+ * sr_send_packet() out of the interface with index if_index (see
+ * sr_if_by_index).  The name the server wants is copied from the
+ * interface record, and the frame counted against it.
+ *
+ *---------------------------------------------------------------------------*/
+
+int sr_send_packet_if(struct sr_instance* sr /* borrowed */,
+                      uint8_t* buf /* borrowed */ ,
+                      unsigned int len,
+                      unsigned int if_index)
 {
     c_packet_header *sr_pkt;
+    struct sr_if* iface = sr_if_by_index(sr, if_index);
     unsigned int total_len =  len + (sizeof(c_packet_header));
 
     /* REQUIRES */
     assert(sr);
     assert(buf);
-    assert(iface);
+
+    if ( iface == 0 ){
+        fprintf( stderr, "** Error, interface %u, does not exist\n", if_index);
+        return -1;
+    }
 
     /* don't waste my time ... */
     if ( len < sizeof(struct sr_ethernet_hdr) ){
         fprintf(stderr , "** Error: packet is wayy to short \n");
+        SR_IF_STAT_ADD(sr, if_index, drops, 1);
         return -1;
     }
 
-    /* Create packet */
-    sr_pkt = (c_packet_header *)malloc(len +
-            sizeof(c_packet_header));
-    assert(sr_pkt);
-    sr_pkt->mLen  = htonl(total_len);
-    sr_pkt->mType = htonl(VNSPACKET);
-    strncpy(sr_pkt->mInterfaceName,iface,16);
-    memcpy(((uint8_t*)sr_pkt) + sizeof(c_packet_header),
-            buf,len);
-
     /* -- log packet -- */
-    sr_log_packet(sr,buf,len);
+    sr_log_packet(sr,buf,len,iface->name,sr_pcap_out);
 
     if ( ! sr_ether_addrs_match_interface( sr, buf, iface) ){
         fprintf( stderr, "*** Error: problem with ethernet header, check log\n");
-        free ( sr_pkt );
+        SR_IF_STAT_ADD(sr, if_index, drops, 1);
         return -1;
     }
 
-    if( write(sr->sockfd, sr_pkt, total_len) < total_len ){
-        fprintf(stderr, "Error writing packet\n");
-        free(sr_pkt);
-        return -1;
-    }
+    /* Create packet header in the headroom, the name is zero padded */
+    sr_pkt = (c_packet_header *)(buf - sizeof(c_packet_header));
+    sr_pkt->mLen  = htonl(total_len);
+    sr_pkt->mType = htonl(VNSPACKET);
+    memcpy(sr_pkt->mInterfaceName, iface->name, sizeof(sr_pkt->mInterfaceName));
 
-    free(sr_pkt);
+    SR_STAT_INC(sr, tx);
+    SR_IF_STAT_ADD(sr, if_index, tx_packets, 1);
+    SR_IF_STAT_ADD(sr, if_index, tx_bytes, len);
 
-    return 0;
-} /* -- sr_send_packet -- */
+    /* -- batched if this thread has a batch, see sr_vns_io.h -- */
+    return sr_vns_send(sr, (uint8_t*)sr_pkt, total_len);
+} /* -- sr_send_packet_if -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_pkt_heap_allocs(..)
+ * Scope: Global
+ *
+ * Heap allocations made for packet buffers: pool slabs plus frames too
+ * big for the frame pool.
+ *
+ *---------------------------------------------------------------------------*/
+
+unsigned long sr_pkt_heap_allocs(struct sr_instance* sr)
+{
+    return sr->rx_pool.slab_count + sr->cache.req_pool.slab_count +
+           sr->cache.pkt_pool.slab_count + sr->cache.frame_pool.slab_count +
+           sr->cache.frame_mallocs;
+} /* -- sr_pkt_heap_allocs -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_print_pkt_stats(..)
+ * Scope: Global
+ *
+ * Frame buffer accounting, see struct sr_pkt_stats.
+ *
+ *---------------------------------------------------------------------------*/
+
+void sr_print_pkt_stats(struct sr_instance* sr, FILE* fp)
+{
+    unsigned long pkts, allocs;
+
+    /* REQUIRES */
+    assert(sr);
+
+    pkts   = sr->stats.rx ? sr->stats.rx : 1;
+    allocs = sr_pkt_heap_allocs(sr);
+
+    fprintf(fp, "frames: %lu in, %lu out, %lu heap allocs (%.3f/pkt), "
+            "%lu copies (%.3f/pkt), %lu syscalls (%.3f/pkt)\n",
+            sr->stats.rx, sr->stats.tx,
+            allocs, (double)allocs / pkts,
+            sr->stats.copies, (double)sr->stats.copies / pkts,
+            sr->stats.rx_calls + sr->stats.tx_calls,
+            (double)(sr->stats.rx_calls + sr->stats.tx_calls) / pkts);
+    if(sr->dst)
+    {
+        fprintf(fp, "dst cache: %lu hits, %lu misses\n",
+                sr->dst->hits, sr->dst->misses);
+    }
+    fprintf(fp, "arp: %lu hits, %lu misses, %lu frames queued; "
+            "%lu polls, %lu entries refreshed, %lu lost; "
+            "%lu next hops down, %lu frames not queued\n",
+            sr->cache.hits, sr->cache.misses, sr->cache.queued,
+            sr->cache.refreshes, sr->cache.refreshed, sr->cache.refresh_failed,
+            sr->cache.neg_added, sr->cache.neg_hits);
+    if(sr->rx_pool.objsize)
+    { sr_pool_dump(&sr->rx_pool, fp); }
+    sr_print_if_stats(sr, fp);
+    sr_arpcache_dump_pools(&sr->cache, fp);
+} /* -- sr_print_pkt_stats -- */
 
 /*-----------------------------------------------------------------------------
  * Method: sr_log_packet()
@@ -614,25 +771,20 @@ int sr_send_packet(struct sr_instance* sr /* borrowed */,
  *
  *---------------------------------------------------------------------------*/
 
-void sr_log_packet(struct sr_instance* sr, uint8_t* buf, int len )
+void sr_log_packet(struct sr_instance* sr, uint8_t* buf, int len,
+                   const char* iface, enum sr_pcap_dir dir)
 {
-    struct pcap_pkthdr h;
-    int size;
+    struct sr_pcap* pcap;
 
     /* REQUIRES */
     assert(sr);
 
-    if(!sr->logfile)
+    /* -- read once, shutdown clears it (sr_destroy_instance) -- */
+    if(!(pcap = __atomic_load_n(&sr->pcap, __ATOMIC_ACQUIRE)))
     {return; }
 
-    size = min(PACKET_DUMP_SIZE, len);
-
-    gettimeofday(&h.ts, 0);
-    h.caplen = size;
-    h.len = (size < PACKET_DUMP_SIZE) ? size : PACKET_DUMP_SIZE;
-
-    sr_dump(sr->logfile, &h, buf);
-    fflush(sr->logfile);
+    /* -- copied into the capture ring, written out by its own thread -- */
+    sr_pcap_log(pcap, buf, len, iface, dir);
 } /* -- sr_log_packet -- */
 
 /*-----------------------------------------------------------------------------
@@ -644,9 +796,8 @@ void sr_log_packet(struct sr_instance* sr, uint8_t* buf, int len )
 int  sr_arp_req_not_for_us(struct sr_instance* sr,
                            uint8_t * packet /* lent */,
                            unsigned int len,
-                           char* interface  /* lent */)
+                           struct sr_if* iface  /* lent */)
 {
-    struct sr_if* iface = sr_get_interface(sr, interface);
     struct sr_ethernet_hdr* e_hdr = 0;
     struct sr_arp_hdr*       a_hdr = 0;
 
@@ -0,0 +1,360 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_vns_io.c
+ *
+ * Description:
+ *
+ * Batched I/O on the VNS server socket, see sr_vns_io.h.
+ *
+ * A command is always parsed from one contiguous stretch of a chunk.  When
+ * fewer than SR_VNS_MAX_CMD bytes are left behind the read position, the
+ * head of the next command (if any has arrived) is carried over to a fresh
+ * chunk, which is the only copy on the receive side.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "sr_router.h"
+#include "sr_vns_io.h"
+#include "vnscommand.h"
+
+/* -- batch the calling thread's sends go to, 0 to write them directly -- */
+static __thread struct sr_txbatch* sr_txbatch_cur;
+
+/*---------------------------------------------------------------------
+ * Method: sr_vns_rx_hold(..), sr_vns_rx_release(..)
+ * Scope: Global
+ *
+ * Take and drop a reference to a receive chunk.  The last reference
+ * returns it to sr->rx_pool.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_vns_rx_hold(struct sr_rxchunk* chunk)
+{ __atomic_fetch_add(&chunk->refs, 1, __ATOMIC_RELAXED); }
+
+void sr_vns_rx_release(struct sr_instance* sr, struct sr_rxchunk* chunk)
+{
+    if(__atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    { sr_pool_put(&sr->rx_pool, chunk); }
+} /* -- sr_vns_rx_release -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_vns_rx_chunk(..)
+ * Scope: Local
+ *
+ * A fresh chunk holding only the reader's reference, 0 if out of memory.
+ * Sets up the pool on first use.
+ *
+ *---------------------------------------------------------------------*/
+
+static struct sr_rxchunk* sr_vns_rx_chunk(struct sr_instance* sr)
+{
+    struct sr_rxchunk* chunk;
+
+    if(!sr->rx_pool.objsize &&
+       sr_pool_init(&sr->rx_pool, "rx", sizeof(struct sr_rxchunk),
+                    SR_RXCHUNK_SLAB) != 0)
+    { return 0; }
+
+    if((chunk = sr_pool_get(&sr->rx_pool)) != 0)
+    {
+        chunk->refs = 1;
+        chunk->len  = 0;
+    }
+    return chunk;
+} /* -- sr_vns_rx_chunk -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_vns_rx_next(..)
+ * Scope: Global
+ *
+ * Return the next complete command from the server and its length.  The
+ * command stays valid until the next call; hold its chunk to keep it
+ * longer.  Only calls recv() when no complete command is buffered, after
+ * flushing the reader's send batch.  Returns 0 on error or when the
+ * server goes away.
+ *
+ *---------------------------------------------------------------------*/
+
+uint8_t* sr_vns_rx_next(struct sr_instance* sr, int* len)
+{
+    struct sr_vns_rx*  rx = &sr->vns_rx;
+    struct sr_rxchunk* fresh;
+    unsigned int       avail;
+    uint32_t           clen;
+    uint8_t*           cmd;
+    ssize_t            n;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+    assert(len);
+
+    if(!rx->chunk)
+    {
+        if((rx->chunk = sr_vns_rx_chunk(sr)) == 0)
+        {
+            fprintf(stderr,"Error: out of memory (sr_vns_rx_next)\n");
+            return 0;
+        }
+        rx->off = 0;
+    }
+
+    while(1)
+    {
+        avail = rx->chunk->len - rx->off;
+        if(avail >= 4)
+        {
+            memcpy(&clen, rx->chunk->data + rx->off, 4);
+            clen = ntohl(clen);
+            if(clen > SR_VNS_MAX_CMD || clen < 8)
+            {
+                fprintf(stderr,"Error: command length to large %d\n",(int)clen);
+                close(sr->sockfd);
+                return 0;
+            }
+            if(avail >= clen)
+            {
+                cmd      = rx->chunk->data + rx->off;
+                rx->off += clen;
+                *len     = clen;
+                return cmd;
+            }
+        }
+
+        /* -- about to block, anything sent from this chunk goes first -- */
+        sr_txbatch_flush(sr, &rx->tx);
+
+        if(avail == 0 && __atomic_load_n(&rx->chunk->refs, __ATOMIC_ACQUIRE) == 1)
+        {
+            /* -- nothing of ours still out, start over -- */
+            rx->chunk->len = rx->off = 0;
+        }
+        else if(rx->off + SR_VNS_MAX_CMD > SR_RXCHUNK_SZ)
+        {
+            if((fresh = sr_vns_rx_chunk(sr)) == 0)
+            {
+                fprintf(stderr,"Error: out of memory (sr_vns_rx_next)\n");
+                return 0;
+            }
+            if(avail)
+            {
+                memcpy(fresh->data, rx->chunk->data + rx->off, avail);
+                SR_STAT_INC(sr, copies);
+            }
+            fresh->len = avail;
+            sr_vns_rx_release(sr, rx->chunk);
+            rx->chunk = fresh;
+            rx->off   = 0;
+        }
+
+        /* -- may block for a while, don't hold up route reloads -- */
+        sr_qsbr_offline();
+        do
+        { /* -- just in case SIGALRM breaks recv -- */
+            n = recv(sr->sockfd, rx->chunk->data + rx->chunk->len,
+                     SR_RXCHUNK_SZ - rx->chunk->len, 0);
+        } while(n == -1 && errno == EINTR);
+        sr_qsbr_online();
+
+        if(n <= 0)
+        {
+            if(n == -1)
+            { perror("recv(..):sr_vns_io.c::sr_vns_rx_next"); }
+            else
+            { fprintf(stderr,"Error: server closed the connection\n"); }
+            return 0;
+        }
+        SR_STAT_INC(sr, rx_calls);
+        rx->chunk->len += n;
+    }
+} /* -- sr_vns_rx_next -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_vns_rx_packet(..)
+ * Scope: Global
+ *
+ * The next command if it is a VNSPACKET that has arrived in full, else
+ * 0 and the command is left for sr_vns_rx_next().  Never calls recv(),
+ * so commands returned since the last sr_vns_rx_next() stay valid until
+ * the next one.
+ *
+ *---------------------------------------------------------------------*/
+
+uint8_t* sr_vns_rx_packet(struct sr_instance* sr, int* len)
+{
+    struct sr_vns_rx* rx = &sr->vns_rx;
+    uint32_t          clen, type;
+    uint8_t*          cmd;
+
+    if(!rx->chunk || rx->chunk->len - rx->off < 8)
+    { return 0; }
+
+    cmd = rx->chunk->data + rx->off;
+    memcpy(&clen, cmd, 4);
+    memcpy(&type, cmd + 4, 4);
+    clen = ntohl(clen);
+    if(ntohl(type) != VNSPACKET || clen < 8 || clen > SR_VNS_MAX_CMD ||
+       rx->chunk->len - rx->off < clen)
+    { return 0; }
+
+    rx->off += clen;
+    *len     = clen;
+    return cmd;
+} /* -- sr_vns_rx_packet -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_vns_writev(..)
+ * Scope: Local
+ *
+ * Write all of iov to the server, picking up after short writes.  Caller
+ * holds send_lock.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_vns_writev(struct sr_instance* sr, struct iovec* iov, int niov)
+{
+    ssize_t n;
+
+    while(niov > 0)
+    {
+        if((n = writev(sr->sockfd, iov, niov)) == -1)
+        {
+            if(errno == EINTR)
+            { continue; }
+            return -1;
+        }
+        SR_STAT_INC(sr, tx_calls);
+
+        while(niov > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if(niov > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+} /* -- sr_vns_writev -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_txbatch_use(..)
+ * Scope: Global
+ *
+ * Collect the calling thread's sends in tx from now on, or write them
+ * directly again if tx is 0.  Detaching does not flush.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_txbatch_use(struct sr_txbatch* tx)
+{ sr_txbatch_cur = tx; }
+
+/*---------------------------------------------------------------------
+ * Method: sr_txbatch_frame(..)
+ * Scope: Global
+ *
+ * The calling thread is about to handle frame, which outlives its batch:
+ * sending it goes in place.  Nothing if the thread has no batch.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_txbatch_frame(const uint8_t* frame)
+{
+    if(sr_txbatch_cur)
+    { sr_txbatch_cur->frame = frame; }
+} /* -- sr_txbatch_frame -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_txbatch_flush(..)
+ * Scope: Global
+ *
+ * Hand everything collected in tx to the kernel in one writev().
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_txbatch_flush(struct sr_instance* sr, struct sr_txbatch* tx)
+{
+    int ret;
+
+    if(tx->niov == 0)
+    { return 0; }
+
+    pthread_mutex_lock(&(sr->send_lock));
+    ret = sr_vns_writev(sr, tx->iov, tx->niov);
+    pthread_mutex_unlock(&(sr->send_lock));
+
+    tx->niov   = 0;
+    tx->staged = 0;
+
+    if(ret != 0)
+    { fprintf(stderr, "Error writing packet\n"); }
+    return ret;
+} /* -- sr_txbatch_flush -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_vns_send(..)
+ * Scope: Global
+ *
+ * Send a complete command: add it to the calling thread's batch, or
+ * write it out if there is none.  With a batch, write errors are only
+ * reported when it is flushed.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_vns_send(struct sr_instance* sr, uint8_t* cmd, unsigned int len)
+{
+    struct sr_txbatch* tx = sr_txbatch_cur;
+    struct iovec       iov;
+    int                ret;
+
+    if(tx && tx->niov == SR_TXBATCH_IOV)
+    { sr_txbatch_flush(sr, tx); }
+
+    if(tx && cmd + SR_PKT_HEADROOM == tx->frame)
+    {
+        /* -- forwarded in place, the frame outlives the batch -- */
+        tx->iov[tx->niov].iov_base = cmd;
+        tx->iov[tx->niov].iov_len  = len;
+        tx->niov++;
+        return 0;
+    }
+
+    if(tx && len <= SR_TXBATCH_STAGE)
+    {
+        if(tx->staged + len > SR_TXBATCH_STAGE)
+        { sr_txbatch_flush(sr, tx); }
+        memcpy(tx->stage + tx->staged, cmd, len);
+        SR_STAT_INC(sr, copies);
+        tx->iov[tx->niov].iov_base = tx->stage + tx->staged;
+        tx->iov[tx->niov].iov_len  = len;
+        tx->niov++;
+        tx->staged += len;
+        return 0;
+    }
+
+    /* -- no batch, or too big for one: keep order and write it now -- */
+    if(tx)
+    { sr_txbatch_flush(sr, tx); }
+
+    iov.iov_base = cmd;
+    iov.iov_len  = len;
+    pthread_mutex_lock(&(sr->send_lock));
+    ret = sr_vns_writev(sr, &iov, 1);
+    pthread_mutex_unlock(&(sr->send_lock));
+
+    if(ret != 0)
+    { fprintf(stderr, "Error writing packet\n"); }
+    return ret;
+} /* -- sr_vns_send -- */
@@ -0,0 +1,82 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_vns_io.h
+ *
+ * Description:
+ *
+ * Batched I/O on the VNS server socket.
+ *
+ * Receive: the reader recv()s as much as the socket has into a large
+ * chunk and parses commands out of it in place, so a burst of commands
+ * costs one system call.  Chunks come from sr->rx_pool and are reference
+ * counted: the reader holds one reference while it is filling a chunk and
+ * each frame handed to a forwarding worker holds another.
+ *
+ * Send: a thread that has a batch attached (the reader, each worker) does
+ * not write frames as they are sent but collects them and hands the lot to
+ * the kernel with a single writev() when the batch is flushed.  The frame
+ * being forwarded in place is referenced where it lies; anything else is
+ * staged, since its buffer is gone by the time the batch is flushed.
+ * Threads without a batch (the ARP thread) write directly.
+ *
+ * Bursts: sr_vns_rx_packet() hands out the packets already received
+ * behind the current command without another recv(), for the reader to
+ * pass to sr_handlepacket_burst() together.  They all lie in the current
+ * chunk, which stays put until the batch is flushed.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef sr_VNS_IO_H
+#define sr_VNS_IO_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <sys/uio.h>
+
+struct sr_instance;
+
+#define SR_VNS_MAX_CMD   10000       /* largest command we accept */
+#define SR_RXCHUNK_SZ    (64 * 1024) /* receive chunk, many commands */
+#define SR_RXCHUNK_SLAB  8           /* chunks per pool slab */
+#define SR_TXBATCH_IOV   64          /* frames per writev() */
+#define SR_TXBATCH_STAGE (16 * 1024) /* room for frames not sent in place */
+
+struct sr_rxchunk
+{
+    int          refs;  /* reader's, plus one per frame out with a worker */
+    unsigned int len;   /* bytes received into data */
+    uint8_t      data[SR_RXCHUNK_SZ];
+};
+
+struct sr_txbatch
+{
+    const uint8_t* frame;   /* received frame that outlives the batch */
+    int            niov;
+    unsigned int   staged;
+    struct iovec   iov[SR_TXBATCH_IOV];
+    uint8_t        stage[SR_TXBATCH_STAGE];
+};
+
+struct sr_vns_rx
+{
+    struct sr_rxchunk* chunk;
+    unsigned int       off; /* next unparsed command in chunk */
+    struct sr_txbatch  tx;  /* reader's sends, flushed before it blocks */
+};
+
+uint8_t* sr_vns_rx_next(struct sr_instance* sr, int* len);
+uint8_t* sr_vns_rx_packet(struct sr_instance* sr, int* len);
+void     sr_vns_rx_hold(struct sr_rxchunk* chunk);
+void     sr_vns_rx_release(struct sr_instance* sr, struct sr_rxchunk* chunk);
+
+void     sr_txbatch_use(struct sr_txbatch* tx);
+void     sr_txbatch_frame(const uint8_t* frame);
+int      sr_txbatch_flush(struct sr_instance* sr, struct sr_txbatch* tx);
+int      sr_vns_send(struct sr_instance* sr, uint8_t* cmd, unsigned int len);
+
+#endif  /* --  sr_VNS_IO_H -- */
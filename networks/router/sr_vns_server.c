@@ -0,0 +1,1000 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_vns_server.c
+ *
+ * Description:
+ *
+ * Local stand-in for the VNS server, for load testing the whole sr binary.
+ * Built with 'make vns_server'.
+ *
+ *   ./sr_vns_server -f ifaces -H hosts [-p port | -U path] [-r rtable]
+ *                   [-k auth_key] [-g ping|udp|trace|arp] [-R pps]
+ *                   [-N packets] [-P payload] [-W grace ms]
+ *
+ * It speaks the protocol of vnscommand.h to one sr over TCP (localhost
+ * only) or a Unix socket: it asks for authentication (checking the reply
+ * against -k if given, sr itself always wants an auth_key file), answers
+ * VNSOPEN with the interfaces of the ifaces file in a c_hwinfo, and
+ * VNS_OPEN_TEMPLATE with the -r rtable first.  Both files use the format
+ * sr_replay reads, "name ip mac" a line; in the hosts file name is the
+ * interface a host sits behind.  Hosts answer the router's ARP requests.
+ *
+ * Once the router answers a ping from every host, so it has them all in
+ * its ARP cache, the server sends -N frames at -R frames a second (0 for
+ * as fast as it can), from each host in turn:
+ *
+ *   ping   ICMP echo to the router's address on the host's interface
+ *   udp    UDP to the next host, forwarded by the router
+ *   trace  UDP to the next host with TTL 1, answered with time exceeded
+ *   arp    ARP request for the router's address on the host's interface
+ *
+ * and times what comes back to the hosts.  Frames are matched to what
+ * caused them by IP id, which the router's replies and errors keep; ARP
+ * replies are taken in order.  -W ms after the last frame it closes the
+ * session and prints throughput and latency percentiles.
+ *
+ *   ./sr_vns_server -f ifaces -H hosts -U /tmp/vns -g udp -N 1000000 &
+ *   ./sr -s /tmp/vns -r rtable
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_protocol.h"
+#include "inet_cksum.h"
+#include "sha1.h"
+#include "vnscommand.h"
+
+#define SRV_IFACES   32
+#define SRV_HOSTS    256
+#define SRV_TAGS     65536         /* frames in flight told apart, by IP id */
+#define SRV_BATCH    64            /* frames per write */
+#define SRV_FRAME    1514
+#define SRV_RXBUF    (1 << 20)
+#define SRV_IDLE_US  50            /* sender sleep when ahead of the rate */
+#define SRV_PROBE_ID 0xffff        /* echo id of the warm up pings */
+#define SRV_SALT     20
+
+enum srv_gen
+{
+    srv_gen_ping = 0,
+    srv_gen_udp,
+    srv_gen_trace,
+    srv_gen_arp
+};
+
+static const char* srv_gen_names[] = { "ping", "udp", "trace", "arp" };
+
+struct srv_iface
+{
+    char          name[sr_IFACE_NAMELEN];
+    uint32_t      ip;                  /* network order */
+    unsigned char mac[ETHER_ADDR_LEN];
+};
+
+struct srv_host
+{
+    struct srv_iface* iface;
+    uint32_t          ip;              /* network order */
+    unsigned char     mac[ETHER_ADDR_LEN];
+};
+
+struct srv
+{
+    int               fd;
+    pthread_mutex_t   send_lock;
+
+    struct srv_iface  ifaces[SRV_IFACES];
+    unsigned int      nifaces;
+    struct srv_host   hosts[SRV_HOSTS];
+    unsigned int      nhosts;
+
+    enum srv_gen      gen;
+    unsigned long     rate;
+    unsigned long     count;
+    unsigned int      payload;
+
+    /* -- receive buffer, the session then the reader thread's -- */
+    uint8_t*          rx;
+    unsigned int      rx_len;
+    unsigned int      rx_off;
+
+    /* -- send time (ns) of each tag, 0 once answered -- */
+    uint64_t          sent_at[SRV_TAGS];
+    unsigned char     probed[SRV_HOSTS]; /* router answered the host's ping */
+    unsigned int      nprobed;
+    int               started;
+
+    /* -- reader only -- */
+    unsigned long     arp_next;        /* tag of the next ARP reply */
+    uint64_t*         lat;
+    unsigned long     nlat;
+    unsigned long     latcap;
+    unsigned long     frames;          /* VNSPACKETs from the router */
+    unsigned long     arps_answered;   /* router's ARP requests we answered */
+    unsigned long     late;            /* answers with no frame to match */
+
+    unsigned long     sent;
+    uint64_t          t_start;
+    uint64_t          t_end;
+};
+
+/*---------------------------------------------------------------------
+ * Method: srv_now()
+ * Scope: Local
+ *
+ *---------------------------------------------------------------------*/
+
+static uint64_t srv_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_load(..)
+ * Scope: Local
+ *
+ * Read "name ip mac" lines.  With hosts != 0 they are hosts and name is
+ * an interface already loaded, otherwise interfaces.
+ *
+ *---------------------------------------------------------------------*/
+
+static int srv_load(struct srv* s, const char* file, int hosts)
+{
+    FILE*          fp;
+    char           line[256], name[sr_IFACE_NAMELEN], ip[64], mac[64];
+    unsigned int   b[ETHER_ADDR_LEN], i;
+    struct in_addr in;
+    unsigned char* dst;
+    int            lineno = 0;
+
+    if((fp = fopen(file, "r")) == 0)
+    {
+        perror(file);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp))
+    {
+        lineno++;
+        if(strchr(line, '#'))
+        { *strchr(line, '#') = 0; }
+        if(sscanf(line, "%31s %63s %63s", name, ip, mac) != 3)
+        { continue; }
+        if(inet_aton(ip, &in) == 0 ||
+           sscanf(mac, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3],
+                  &b[4], &b[5]) != ETHER_ADDR_LEN)
+        {
+            fprintf(stderr, "%s:%d: expected \"name ip mac\"\n", file, lineno);
+            fclose(fp);
+            return -1;
+        }
+
+        if(hosts)
+        {
+            for(i = 0; i < s->nifaces; i++)
+            {
+                if(strcmp(s->ifaces[i].name, name) == 0)
+                { break; }
+            }
+            if(i == s->nifaces || s->nhosts == SRV_HOSTS)
+            {
+                fprintf(stderr, "%s:%d: no interface %s or too many hosts\n",
+                        file, lineno, name);
+                fclose(fp);
+                return -1;
+            }
+            s->hosts[s->nhosts].iface = &s->ifaces[i];
+            s->hosts[s->nhosts].ip    = in.s_addr;
+            dst = s->hosts[s->nhosts++].mac;
+        }
+        else
+        {
+            if(s->nifaces == SRV_IFACES)
+            {
+                fprintf(stderr, "%s:%d: too many interfaces\n", file, lineno);
+                fclose(fp);
+                return -1;
+            }
+            strcpy(s->ifaces[s->nifaces].name, name);
+            s->ifaces[s->nifaces].ip = in.s_addr;
+            dst = s->ifaces[s->nifaces++].mac;
+        }
+        for(i = 0; i < ETHER_ADDR_LEN; i++)
+        { dst[i] = b[i]; }
+    }
+    fclose(fp);
+
+    if(hosts ? s->nhosts == 0 : s->nifaces == 0)
+    {
+        fprintf(stderr, "%s: nothing in it\n", file);
+        return -1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_send(..)
+ * Scope: Local
+ *
+ * Write all of buf to the router.  The reader answers ARP while the
+ * sender sends traffic, so writes are serialised.
+ *
+ *---------------------------------------------------------------------*/
+
+static int srv_send(struct srv* s, const uint8_t* buf, size_t len)
+{
+    ssize_t n;
+    int     ret = 0;
+
+    pthread_mutex_lock(&s->send_lock);
+    while(len > 0)
+    {
+        if((n = send(s->fd, buf, len, MSG_NOSIGNAL)) == -1)
+        {
+            if(errno == EINTR)
+            { continue; }
+            ret = -1;
+            break;
+        }
+        buf += n;
+        len -= n;
+    }
+    pthread_mutex_unlock(&s->send_lock);
+    return ret;
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_next(..)
+ * Scope: Local
+ *
+ * Next complete command from the router and its length, 0 when the
+ * router goes away.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint8_t* srv_next(struct srv* s, uint32_t* len)
+{
+    uint32_t clen;
+    uint8_t* cmd;
+    ssize_t  n;
+
+    while(1)
+    {
+        if(s->rx_len - s->rx_off >= 4)
+        {
+            memcpy(&clen, s->rx + s->rx_off, 4);
+            clen = ntohl(clen);
+            if(clen < 8 || clen > SRV_RXBUF)
+            {
+                fprintf(stderr, "bad command length %u\n", clen);
+                return 0;
+            }
+            if(s->rx_len - s->rx_off >= clen)
+            {
+                cmd        = s->rx + s->rx_off;
+                s->rx_off += clen;
+                *len       = clen;
+                return cmd;
+            }
+        }
+
+        if(s->rx_off > 0)
+        {
+            memmove(s->rx, s->rx + s->rx_off, s->rx_len - s->rx_off);
+            s->rx_len -= s->rx_off;
+            s->rx_off  = 0;
+        }
+        do
+        { n = recv(s->fd, s->rx + s->rx_len, SRV_RXBUF - s->rx_len, 0); }
+        while(n == -1 && errno == EINTR);
+        if(n <= 0)
+        { return 0; }
+        s->rx_len += n;
+    }
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_frame(..)
+ * Scope: Local
+ *
+ * Start a VNSPACKET at p on iface with an Ethernet header; returns the
+ * frame's payload.  srv_frame_end() fills in the length.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint8_t* srv_frame(uint8_t* p, const struct srv_iface* iface,
+                          const unsigned char* dst, const unsigned char* src,
+                          uint16_t type)
+{
+    c_packet_header*   hdr = (c_packet_header*)p;
+    sr_ethernet_hdr_t* eth = (sr_ethernet_hdr_t*)(p + sizeof(c_packet_header));
+
+    hdr->mType = htonl(VNSPACKET);
+    memset(hdr->mInterfaceName, 0, sizeof(hdr->mInterfaceName));
+    strncpy(hdr->mInterfaceName, iface->name, sizeof(hdr->mInterfaceName) - 1);
+
+    memcpy(eth->ether_dhost, dst, ETHER_ADDR_LEN);
+    memcpy(eth->ether_shost, src, ETHER_ADDR_LEN);
+    eth->ether_type = htons(type);
+    return (uint8_t*)(eth + 1);
+}
+
+static unsigned int srv_frame_end(uint8_t* p, unsigned int frame_len)
+{
+    unsigned int len = sizeof(c_packet_header) + frame_len;
+    ((c_packet_header*)p)->mLen = htonl(len);
+    return len;
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_make_arp(..)
+ * Scope: Local
+ *
+ * ARP request or reply at p, returns the command length.  Addresses are
+ * network order.
+ *
+ *---------------------------------------------------------------------*/
+
+static unsigned int srv_make_arp(uint8_t* p, const struct srv_iface* iface,
+                                 unsigned short op,
+                                 const unsigned char* sha, uint32_t sip,
+                                 const unsigned char* tha, uint32_t tip)
+{
+    static const unsigned char bcast[ETHER_ADDR_LEN] =
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    sr_arp_hdr_t* arp;
+
+    arp = (sr_arp_hdr_t*)srv_frame(p, iface, op == arp_op_request ? bcast : tha,
+                                   sha, ethertype_arp);
+    arp->ar_hrd = htons(arp_hrd_ethernet);
+    arp->ar_pro = htons(ethertype_ip);
+    arp->ar_hln = ETHER_ADDR_LEN;
+    arp->ar_pln = 4;
+    arp->ar_op  = htons(op);
+    memcpy(arp->ar_sha, sha, ETHER_ADDR_LEN);
+    arp->ar_sip = sip;
+    if(op == arp_op_request)
+    { memset(arp->ar_tha, 0, ETHER_ADDR_LEN); }
+    else
+    { memcpy(arp->ar_tha, tha, ETHER_ADDR_LEN); }
+    arp->ar_tip = tip;
+
+    return srv_frame_end(p, sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t));
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_make_ip(..)
+ * Scope: Local
+ *
+ * ICMP echo or UDP datagram from host at p, returns the command length.
+ *
+ *---------------------------------------------------------------------*/
+
+static unsigned int srv_make_ip(struct srv* s, uint8_t* p,
+                                const struct srv_host* host, uint32_t dst,
+                                uint8_t proto, uint8_t ttl, uint16_t id,
+                                uint16_t echo_id)
+{
+    sr_ip_hdr_t*   ip;
+    sr_icmp_hdr_t* icmp;
+    uint8_t*       l4;
+    unsigned int   l4len = 8 + s->payload;
+
+    ip = (sr_ip_hdr_t*)srv_frame(p, host->iface, host->iface->mac, host->mac,
+                                 ethertype_ip);
+    l4 = (uint8_t*)(ip + 1);
+
+    ip->ip_v   = 4;
+    ip->ip_hl  = 5;
+    ip->ip_tos = 0;
+    ip->ip_len = htons(sizeof(sr_ip_hdr_t) + l4len);
+    ip->ip_id  = htons(id);
+    ip->ip_off = 0;
+    ip->ip_ttl = ttl;
+    ip->ip_p   = proto;
+    ip->ip_src = host->ip;
+    ip->ip_dst = dst;
+    ip->ip_sum = 0;
+    ip->ip_sum = inet_cksum(ip, sizeof(sr_ip_hdr_t));
+
+    memset(l4, 0, l4len);
+    if(proto == ip_protocol_icmp)
+    {
+        icmp = (sr_icmp_hdr_t*)l4;
+        icmp->icmp_type = 8;
+        memcpy(l4 + 4, &echo_id, 2);
+        memcpy(l4 + 6, &ip->ip_id, 2);
+        icmp->icmp_sum = inet_cksum(l4, l4len);
+    }
+    else
+    {
+        l4[0] = 0x80;              /* -- ports 32768 -> 33434 -- */
+        l4[2] = 33434 >> 8;
+        l4[3] = 33434 & 0xff;
+        l4[4] = l4len >> 8;
+        l4[5] = l4len & 0xff;
+    }
+
+    return srv_frame_end(p, sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) +
+                         l4len);
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_make(..)
+ * Scope: Local
+ *
+ * Frame k of the run at p, returns the command length.
+ *
+ *---------------------------------------------------------------------*/
+
+static unsigned int srv_make(struct srv* s, uint8_t* p, unsigned long k)
+{
+    const struct srv_host* host = &s->hosts[k % s->nhosts];
+    const struct srv_host* next = &s->hosts[(k + 1) % s->nhosts];
+    uint16_t               tag  = k % SRV_TAGS;
+
+    switch(s->gen)
+    {
+        case srv_gen_ping:
+            return srv_make_ip(s, p, host, host->iface->ip, ip_protocol_icmp,
+                               64, tag, htons(1));
+        case srv_gen_udp:
+            return srv_make_ip(s, p, host, next->ip, ip_protocol_udp, 64, tag, 0);
+        case srv_gen_trace:
+            return srv_make_ip(s, p, host, next->ip, ip_protocol_udp, 1, tag, 0);
+        default:
+            return srv_make_arp(p, host->iface, arp_op_request, host->mac,
+                                host->ip, 0, host->iface->ip);
+    }
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_answered(..)
+ * Scope: Local
+ *
+ * A frame for tag came back; record its latency if it is still out.
+ *
+ *---------------------------------------------------------------------*/
+
+static void srv_answered(struct srv* s, unsigned int tag, uint64_t now)
+{
+    uint64_t  t = __atomic_exchange_n(&s->sent_at[tag], 0, __ATOMIC_ACQUIRE);
+    uint64_t* grown;
+
+    if(t == 0)
+    {
+        s->late++;
+        return;
+    }
+    if(s->nlat == s->latcap)
+    {
+        s->latcap = s->latcap ? s->latcap * 2 : 65536;
+        if((grown = realloc(s->lat, s->latcap * sizeof(uint64_t))) == 0)
+        { return; }
+        s->lat = grown;
+    }
+    s->lat[s->nlat++] = now - t;
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_handle(..)
+ * Scope: Local
+ *
+ * A frame the router sent out of iface: answer ARP for hosts there,
+ * time anything that answers what we sent.
+ *
+ *---------------------------------------------------------------------*/
+
+static void srv_handle(struct srv* s, const char* ifname, uint8_t* frame,
+                       unsigned int len)
+{
+    sr_ethernet_hdr_t* eth = (sr_ethernet_hdr_t*)frame;
+    sr_arp_hdr_t*      arp;
+    sr_ip_hdr_t*       ip;
+    uint8_t*           l4;
+    uint8_t            reply[sizeof(c_packet_header) + SRV_FRAME];
+    uint16_t           echo_id;
+    unsigned int       i;
+    uint64_t           now = srv_now();
+
+    s->frames++;
+    if(len < sizeof(sr_ethernet_hdr_t))
+    { return; }
+
+    if(ntohs(eth->ether_type) == ethertype_arp &&
+       len >= sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
+    {
+        arp = (sr_arp_hdr_t*)(eth + 1);
+        for(i = 0; i < s->nhosts; i++)
+        {
+            if(s->hosts[i].ip == arp->ar_tip &&
+               strcmp(s->hosts[i].iface->name, ifname) == 0)
+            { break; }
+        }
+        if(i == s->nhosts)
+        { return; }
+
+        if(ntohs(arp->ar_op) == arp_op_request)
+        {
+            s->arps_answered++;
+            srv_send(s, reply, srv_make_arp(reply, s->hosts[i].iface,
+                                            arp_op_reply, s->hosts[i].mac,
+                                            s->hosts[i].ip, arp->ar_sha,
+                                            arp->ar_sip));
+        }
+        else if(s->gen == srv_gen_arp &&
+                __atomic_load_n(&s->started, __ATOMIC_ACQUIRE))
+        { srv_answered(s, s->arp_next++ % SRV_TAGS, now); }
+        return;
+    }
+
+    if(ntohs(eth->ether_type) != ethertype_ip ||
+       len < sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + 8)
+    { return; }
+    ip = (sr_ip_hdr_t*)(eth + 1);
+    l4 = (uint8_t*)(ip + 1);
+
+    if(ip->ip_p == ip_protocol_icmp && l4[0] == 0)
+    {
+        memcpy(&echo_id, l4 + 4, 2);
+        i = ntohs(ip->ip_id);
+        if(ntohs(echo_id) == SRV_PROBE_ID)
+        {
+            if(i < s->nhosts && !s->probed[i])
+            {
+                s->probed[i] = 1;
+                __atomic_add_fetch(&s->nprobed, 1, __ATOMIC_RELEASE);
+            }
+            return;
+        }
+    }
+    if(__atomic_load_n(&s->started, __ATOMIC_ACQUIRE))
+    { srv_answered(s, ntohs(ip->ip_id), now); }
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_reader(..)
+ * Scope: Local
+ *
+ * Reader thread: everything the router sends until it hangs up.
+ *
+ *---------------------------------------------------------------------*/
+
+static void* srv_reader(void* arg)
+{
+    struct srv*      s = (struct srv*)arg;
+    c_packet_header* hdr;
+    char             ifname[sizeof(hdr->mInterfaceName) + 1];
+    uint8_t*         cmd;
+    uint32_t         len;
+
+    while((cmd = srv_next(s, &len)) != 0)
+    {
+        hdr = (c_packet_header*)cmd;
+        if(ntohl(hdr->mType) != VNSPACKET || len < sizeof(c_packet_header))
+        { continue; }
+        memcpy(ifname, hdr->mInterfaceName, sizeof(hdr->mInterfaceName));
+        ifname[sizeof(hdr->mInterfaceName)] = 0;
+        srv_handle(s, ifname, cmd + sizeof(c_packet_header),
+                   len - sizeof(c_packet_header));
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_session(..)
+ * Scope: Local
+ *
+ * Authenticate the router and open its session: VNS_AUTH_REQUEST,
+ * VNS_AUTH_REPLY, VNS_AUTH_STATUS, then VNSOPEN (or VNS_OPEN_TEMPLATE,
+ * answered with the rtable) answered with VNSHWINFO.
+ *
+ *---------------------------------------------------------------------*/
+
+static int srv_session(struct srv* s, const char* keyfile, const char* rtable)
+{
+    uint8_t          msg[sizeof(c_auth_status) + 256];
+    c_auth_request*  req = (c_auth_request*)msg;
+    c_auth_reply*    ar;
+    c_auth_status*   st  = (c_auth_status*)msg;
+    c_hwinfo         hw;
+    c_rtable*        rt;
+    SHA1Context      sha1;
+    char             key[65];
+    uint8_t*         cmd;
+    uint32_t         len, ulen, i, n = 0;
+    FILE*            fp;
+    long             size;
+    int              ok = 1;
+
+    /* -- challenge -- */
+    req->mLen  = htonl(sizeof(c_auth_request) + SRV_SALT);
+    req->mType = htonl(VNS_AUTH_REQUEST);
+    for(i = 0; i < SRV_SALT; i++)
+    { req->salt[i] = rand(); }
+    if(srv_send(s, msg, sizeof(c_auth_request) + SRV_SALT) != 0)
+    { return -1; }
+
+    if((cmd = srv_next(s, &len)) == 0 ||
+       ntohl(((c_base*)cmd)->mType) != VNS_AUTH_REPLY)
+    {
+        fprintf(stderr, "expected an auth reply\n");
+        return -1;
+    }
+    ar   = (c_auth_reply*)cmd;
+    ulen = ntohl(ar->usernameLen);
+    if(sizeof(c_auth_reply) + ulen + 20 > len)
+    {
+        fprintf(stderr, "short auth reply\n");
+        return -1;
+    }
+    if(keyfile)
+    {
+        /* -- same salted SHA1 as sr_handle_auth_request(), with the key
+              padded with zeroes to 64 bytes -- */
+        memset(key, 0, sizeof(key));
+        if((fp = fopen(keyfile, "r")) == 0 || fgets(key, sizeof(key), fp) == 0)
+        {
+            perror(keyfile);
+            return -1;
+        }
+        fclose(fp);
+        SHA1Reset(&sha1);
+        SHA1Input(&sha1, req->salt, SRV_SALT);
+        SHA1Input(&sha1, (unsigned char*)key, 64);
+        SHA1Result(&sha1);
+        for(i = 0; i < 5; i++)
+        { sha1.Message_Digest[i] = htonl(sha1.Message_Digest[i]); }
+        ok = memcmp(ar->username + ulen, sha1.Message_Digest, 20) == 0;
+    }
+
+    st->mType   = htonl(VNS_AUTH_STATUS);
+    st->auth_ok = ok;
+    strcpy(st->msg, ok ? "stand-in server" : "wrong auth_key");
+    st->mLen    = htonl(sizeof(c_auth_status) + strlen(st->msg) + 1);
+    if(srv_send(s, msg, sizeof(c_auth_status) + strlen(st->msg) + 1) != 0 || !ok)
+    { return -1; }
+
+    /* -- open -- */
+    if((cmd = srv_next(s, &len)) == 0)
+    { return -1; }
+    if(ntohl(((c_base*)cmd)->mType) == VNS_OPEN_TEMPLATE)
+    {
+        if(!rtable || (fp = fopen(rtable, "rb")) == 0)
+        {
+            fprintf(stderr, "template open needs an rtable (-r)\n");
+            return -1;
+        }
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if((rt = malloc(sizeof(c_rtable) + size)) == 0 ||
+           fread(rt->rtable, 1, size, fp) != (size_t)size)
+        {
+            fclose(fp);
+            return -1;
+        }
+        fclose(fp);
+        rt->mLen  = htonl(sizeof(c_rtable) + size);
+        rt->mType = htonl(VNS_RTABLE);
+        memcpy(rt->mVirtualHostID,
+               ((c_open_template*)cmd)->mVirtualHostID, IDSIZE);
+        ok = srv_send(s, (uint8_t*)rt, sizeof(c_rtable) + size) == 0;
+        free(rt);
+        if(!ok)
+        { return -1; }
+    }
+    else if(ntohl(((c_base*)cmd)->mType) != VNSOPEN)
+    {
+        fprintf(stderr, "expected an open\n");
+        return -1;
+    }
+
+    memset(&hw, 0, sizeof(hw));
+    for(i = 0; i < s->nifaces; i++)
+    {
+        hw.mHWInfo[n].mKey = htonl(HWINTERFACE);
+        strcpy(hw.mHWInfo[n++].value, s->ifaces[i].name);
+        hw.mHWInfo[n].mKey = htonl(HWETHER);
+        memcpy(hw.mHWInfo[n++].value, s->ifaces[i].mac, ETHER_ADDR_LEN);
+        hw.mHWInfo[n].mKey = htonl(HWETHIP);
+        memcpy(hw.mHWInfo[n++].value, &s->ifaces[i].ip, 4);
+    }
+    len      = 2 * sizeof(uint32_t) + n * sizeof(c_hw_entry);
+    hw.mLen  = htonl(len);
+    hw.mType = htonl(VNSHWINFO);
+    return srv_send(s, (uint8_t*)&hw, len);
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_generate(..)
+ * Scope: Local
+ *
+ * Ping the router from each host until it has answered them all, then
+ * send the run, SRV_BATCH frames a write at most, holding to the rate.
+ * The router resolves hosts with an ARP sweep once a second, so hosts
+ * still unanswered are pinged again each second.
+ *
+ *---------------------------------------------------------------------*/
+
+static int srv_generate(struct srv* s)
+{
+    uint8_t*      buf;
+    uint8_t*      p;
+    unsigned long due, j;
+    uint64_t      now, start;
+    unsigned int  i;
+    int           waited;
+
+    if((buf = malloc(SRV_BATCH * (sizeof(c_packet_header) + SRV_FRAME))) == 0)
+    { return -1; }
+
+    for(waited = 0; __atomic_load_n(&s->nprobed, __ATOMIC_ACQUIRE) < s->nhosts;
+        waited++)
+    {
+        if(waited == 100)
+        {
+            fprintf(stderr, "router did not answer pings in 10s\n");
+            free(buf);
+            return -1;
+        }
+        for(i = 0; waited % 10 == 0 && i < s->nhosts; i++)
+        {
+            if(!s->probed[i] &&
+               srv_send(s, buf, srv_make_ip(s, buf, &s->hosts[i],
+                                            s->hosts[i].iface->ip,
+                                            ip_protocol_icmp, 64, i,
+                                            htons(SRV_PROBE_ID))) != 0)
+            {
+                free(buf);
+                return -1;
+            }
+        }
+        usleep(100000);
+    }
+
+    start = s->t_start = srv_now();
+    __atomic_store_n(&s->started, 1, __ATOMIC_RELEASE);
+    while(s->sent < s->count)
+    {
+        now = srv_now();
+        due = s->rate ? (now - start) * s->rate / 1000000000ull - s->sent
+                      : SRV_BATCH;
+        if(due > SRV_BATCH)
+        { due = SRV_BATCH; }
+        if(due > s->count - s->sent)
+        { due = s->count - s->sent; }
+        if(due == 0)
+        {
+            usleep(SRV_IDLE_US);
+            continue;
+        }
+
+        for(p = buf, j = 0; j < due; j++)
+        {
+            __atomic_store_n(&s->sent_at[(s->sent + j) % SRV_TAGS], now,
+                             __ATOMIC_RELEASE);
+            p += srv_make(s, p, s->sent + j);
+        }
+        if(srv_send(s, buf, p - buf) != 0)
+        {
+            perror("send");
+            break;
+        }
+        s->sent += due;
+    }
+    s->t_end = srv_now();
+
+    free(buf);
+    return 0;
+}
+
+static int srv_cmp(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_report(..)
+ * Scope: Local
+ *
+ *---------------------------------------------------------------------*/
+
+static void srv_report(struct srv* s)
+{
+    double secs = (s->t_end - s->t_start) / 1e9;
+    unsigned long n = s->nlat;
+
+    printf("%s: sent %lu in %.3fs (%.1f kpkts/s), %lu answered (%.1f%%), "
+           "%lu late or unmatched\n", srv_gen_names[s->gen], s->sent, secs,
+           secs > 0 ? s->sent / secs / 1e3 : 0.0, n,
+           s->sent ? 100.0 * n / s->sent : 0.0, s->late);
+    printf("router sent %lu frames, %lu ARP requests for hosts\n",
+           s->frames, s->arps_answered);
+    if(n == 0)
+    { return; }
+
+    qsort(s->lat, n, sizeof(uint64_t), srv_cmp);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           s->lat[n / 2] / 1e3, s->lat[n * 9 / 10] / 1e3,
+           s->lat[n * 99 / 100] / 1e3, s->lat[n * 999 / 1000] / 1e3,
+           s->lat[n - 1] / 1e3);
+}
+
+/*---------------------------------------------------------------------
+ * Method: srv_listen(..)
+ * Scope: Local
+ *
+ * Listening socket on localhost:port, or on the Unix socket path.
+ *
+ *---------------------------------------------------------------------*/
+
+static int srv_listen(unsigned short port, const char* path)
+{
+    struct sockaddr_in sin;
+    struct sockaddr_un sun;
+    struct sockaddr*   sa;
+    socklen_t          salen;
+    int                fd, on = 1;
+
+    if(path)
+    {
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        strncpy(sun.sun_path, path, sizeof(sun.sun_path) - 1);
+        unlink(path);
+        sa    = (struct sockaddr*)&sun;
+        salen = sizeof(sun);
+    }
+    else
+    {
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family      = AF_INET;
+        sin.sin_port        = htons(port);
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sa    = (struct sockaddr*)&sin;
+        salen = sizeof(sin);
+    }
+
+    if((fd = socket(sa->sa_family, SOCK_STREAM, 0)) == -1)
+    {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if(bind(fd, sa, salen) == -1 || listen(fd, 1) == -1)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(char* argv0)
+{
+    printf("Format: %s -f ifaces -H hosts [-p port | -U path] [-r rtable] \n",
+           argv0);
+    printf("           [-k auth_key] [-g ping|udp|trace|arp] [-R pps] \n");
+    printf("           [-N packets] [-P payload] [-W grace ms] \n");
+    printf("   ifaces  router interfaces, lines of \"name ip mac\" \n");
+    printf("   hosts   hosts behind them, lines of \"iface ip mac\" \n");
+    printf("   defaults port=8888 udp, as fast as it can, 100000 packets, \n");
+    printf("   64 byte payload, 1000 ms grace \n");
+}
+
+int main(int argc, char** argv)
+{
+    struct srv*   s;
+    char*         ifaces  = 0;
+    char*         hosts   = 0;
+    char*         path    = 0;
+    char*         rtable  = 0;
+    char*         keyfile = 0;
+    unsigned int  port    = 8888;
+    unsigned int  grace   = 1000;
+    unsigned int  i;
+    pthread_t     reader;
+    c_close       bye;
+    int           lfd, c;
+
+    if((s = calloc(1, sizeof(struct srv))) == 0 ||
+       (s->rx = malloc(SRV_RXBUF)) == 0)
+    { return 1; }
+    s->gen     = srv_gen_udp;
+    s->count   = 100000;
+    s->payload = 64;
+    pthread_mutex_init(&s->send_lock, 0);
+
+    while((c = getopt(argc, argv, "hf:H:p:U:r:k:g:R:N:P:W:")) != EOF)
+    {
+        switch(c)
+        {
+            case 'f': ifaces     = optarg;       break;
+            case 'H': hosts      = optarg;       break;
+            case 'p': port       = atoi(optarg); break;
+            case 'U': path       = optarg;       break;
+            case 'r': rtable     = optarg;       break;
+            case 'k': keyfile    = optarg;       break;
+            case 'R': s->rate    = atol(optarg); break;
+            case 'N': s->count   = atol(optarg); break;
+            case 'P': s->payload = atoi(optarg); break;
+            case 'W': grace      = atoi(optarg); break;
+            case 'g':
+                for(i = 0; i < 4; i++)
+                {
+                    if(strcmp(optarg, srv_gen_names[i]) == 0)
+                    { s->gen = (enum srv_gen)i; }
+                }
+                if(strcmp(optarg, srv_gen_names[s->gen]) != 0)
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(!ifaces || !hosts || s->payload < 8 ||
+       s->payload > SRV_FRAME - sizeof(sr_ethernet_hdr_t) -
+                    sizeof(sr_ip_hdr_t) - 8)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if(srv_load(s, ifaces, 0) != 0 || srv_load(s, hosts, 1) != 0)
+    { return 1; }
+
+    if((lfd = srv_listen(port, path)) == -1)
+    { return 1; }
+    if(path)
+    { fprintf(stderr, "waiting for sr on %s\n", path); }
+    else
+    { fprintf(stderr, "waiting for sr on localhost:%u\n", port); }
+    if((s->fd = accept(lfd, 0, 0)) == -1)
+    {
+        perror("accept");
+        return 1;
+    }
+    close(lfd);
+
+    srand(time(0));
+    if(srv_session(s, keyfile, rtable) != 0)
+    { return 1; }
+    if(pthread_create(&reader, 0, srv_reader, s) != 0)
+    { return 1; }
+
+    if(srv_generate(s) == 0)
+    { usleep(grace * 1000); }
+
+    /* -- the router leaves its read loop and hangs up -- */
+    memset(&bye, 0, sizeof(bye));
+    bye.mLen  = htonl(sizeof(bye));
+    bye.mType = htonl(VNSCLOSE);
+    strcpy(bye.mErrorMessage, "load test done");
+    srv_send(s, (uint8_t*)&bye, sizeof(bye));
+    shutdown(s->fd, SHUT_WR);
+    pthread_join(reader, 0);
+
+    srv_report(s);
+    close(s->fd);
+    if(path)
+    { unlink(path); }
+    return 0;
+}
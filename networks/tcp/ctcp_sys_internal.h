@@ -190,19 +190,22 @@ bool add_network_line_ending(bool webserver, char *buf, size_t len) {
  */
 uint16_t cksum_tcp(iphdr_t *packet, uint16_t len) {
   tcphdr_t *tcp_hdr = (tcphdr_t *) ((uint8_t *) packet + IP_HDR_SIZE);
-
-  /* Construct pseudoheader. */
-  tcp_pseudoheader_t *phdr = calloc(TCP_PSEUDOHDR_SIZE + len, 1);
-  phdr->src_addr = packet->saddr;
-  phdr->dst_addr = packet->daddr;
-  phdr->protocol = IPPROTO_TCP;
-  phdr->tcp_len = htons(TCP_HDR_SIZE + len);
-
-  /* Append TCP segment and compute checksum. */
-  memcpy(&(phdr->tcp_hdr), tcp_hdr, TCP_HDR_SIZE + len);
-  uint16_t result = cksum(phdr, len + TCP_PSEUDOHDR_SIZE);
-  free(phdr);
-  return result;
+  size_t phdr_len = offsetof(tcp_pseudoheader_t, tcp_hdr);
+
+  /* Construct pseudoheader, up to where the TCP header would go. */
+  tcp_pseudoheader_t phdr;
+  memset(&phdr, 0, phdr_len);
+  phdr.src_addr = packet->saddr;
+  phdr.dst_addr = packet->daddr;
+  phdr.protocol = IPPROTO_TCP;
+  phdr.tcp_len = htons(TCP_HDR_SIZE + len);
+
+  /* Add the TCP segment where it lies instead of copying it after the
+     pseudoheader. The pseudoheader is an even length, so the sum is the
+     same. */
+  uint16_t sum = inet_cksum_add(0, &phdr, phdr_len);
+  sum = inet_cksum_add(sum, tcp_hdr, TCP_HDR_SIZE + len);
+  return inet_cksum_finish(sum);
 }
 
 /**
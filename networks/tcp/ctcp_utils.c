@@ -1,19 +1,7 @@
 #include "ctcp_utils.h"
 
 uint16_t cksum(const void *_data, uint16_t len) {
-  const uint8_t *data = _data;
-  uint32_t sum = 0;
-
-  for (sum = 0; len >= 2; data += 2, len -=2) {
-    sum += (data[0] << 8) | data[1];
-  }
-  if (len > 0) sum += data[0] << 8;
-
-  while (sum > 0xffff) {
-    sum = (sum >> 16) + (sum & 0xffff);
-  }
-  sum = htons(~sum);
-  return sum ? sum : 0xffff;
+  return inet_cksum(_data, len);
 }
 
 long current_time() {
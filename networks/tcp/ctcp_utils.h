@@ -10,10 +10,11 @@
 #define CTCP_UTILS_H
 
 #include "ctcp_sys.h"
+#include "inet_cksum.h"
 
 /**
  * Computes a checksum over the given data and returns the result in
- * NETWORK-byte order.
+ * NETWORK-byte order. See inet_cksum.h for how it is computed.
  *
  * _data: Data to compute checksum over.
  * len: Length of data.